@@ -0,0 +1,466 @@
+#include "stdafx.h"
+
+#include "..\..\Library\Library\Unsafe.h"
+#include "..\..\Library_Security\Library_Security\Crc32_Castagnoli.h"
+
+#include <intrin.h>
+#include <malloc.h>
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <sstream>
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// Each kernel gets three buffers of the largest size, plus room for the misaligned offsets.
+const int32_t bufferCount = 3;
+const int32_t bufferSlack = 64;
+
+// Measurements are repeated and the fastest one is kept.
+const int32_t repeatCount = 5;
+
+static volatile int64_t benchmark_sink = 0;
+
+typedef void (*Benchmark_Run)(byte** buffers, int32_t length, int64_t iterations);
+typedef const char* (*Benchmark_Tier)(int32_t length);
+
+struct Benchmark_Kernel
+{
+    const char* name;
+    Benchmark_Run run;
+    Benchmark_Tier tier;
+};
+
+// _ReadWriteBarrier keeps the optimizer from merging the identical calls of a loop.
+
+static void run_copy(byte** b, int32_t length, int64_t iterations)
+{
+    for (int64_t i = 0; i < iterations; i++)
+    {
+        copy(b[0], b[1], length);
+        _ReadWriteBarrier();
+    }
+}
+
+static void run_equals(byte** b, int32_t length, int64_t iterations)
+{
+    int64_t sum = 0;
+
+    for (int64_t i = 0; i < iterations; i++)
+    {
+        sum += equals(b[0], b[1], length) ? 1 : 0;
+        _ReadWriteBarrier();
+    }
+
+    benchmark_sink += sum;
+}
+
+static void run_compare(byte** b, int32_t length, int64_t iterations)
+{
+    int64_t sum = 0;
+
+    for (int64_t i = 0; i < iterations; i++)
+    {
+        sum += compare(b[0], b[1], length);
+        _ReadWriteBarrier();
+    }
+
+    benchmark_sink += sum;
+}
+
+static void run_xor(byte** b, int32_t length, int64_t iterations)
+{
+    for (int64_t i = 0; i < iterations; i++)
+    {
+        xor(b[0], b[1], b[2], length);
+        _ReadWriteBarrier();
+    }
+}
+
+static void run_crc32c(byte** b, int32_t length, int64_t iterations)
+{
+    uint32_t x = 0;
+
+    for (int64_t i = 0; i < iterations; i++)
+    {
+        x = compute_Crc32_Castagnoli(x, b[0], length);
+    }
+
+    benchmark_sink += x;
+}
+
+// The C runtime, as the reference for copy and equals / compare.
+
+static void run_memcpy(byte** b, int32_t length, int64_t iterations)
+{
+    for (int64_t i = 0; i < iterations; i++)
+    {
+        memcpy(b[1], b[0], length);
+        _ReadWriteBarrier();
+    }
+}
+
+static void run_memcmp(byte** b, int32_t length, int64_t iterations)
+{
+    int64_t sum = 0;
+
+    for (int64_t i = 0; i < iterations; i++)
+    {
+        sum += memcmp(b[0], b[1], length);
+        _ReadWriteBarrier();
+    }
+
+    benchmark_sink += sum;
+}
+
+// The path each kernel takes for a length, as in Unsafe.cpp and Crc32_Castagnoli.cpp.
+
+static const char* tier_copy(int32_t length) { return (length <= 256) ? "scalar" : "sse2"; }
+static const char* tier_sse2(int32_t length) { return (length >= 16) ? "sse2" : "scalar"; }
+static const char* tier_scalar(int32_t length) { return "scalar"; }
+static const char* tier_crt(int32_t length) { return "crt"; }
+
+static const Benchmark_Kernel benchmark_kernels[] =
+{
+    { "copy", run_copy, tier_copy },
+    { "equals", run_equals, tier_sse2 },
+    { "compare", run_compare, tier_scalar },
+    { "xor", run_xor, tier_sse2 },
+    { "compute_Crc32_Castagnoli", run_crc32c, tier_scalar },
+    { "memcpy", run_memcpy, tier_crt },
+    { "memcmp", run_memcmp, tier_crt },
+};
+
+struct Benchmark_Thread
+{
+    byte* buffers[bufferCount];
+};
+
+static int64_t benchmark_now()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return counter.QuadPart;
+}
+
+static double benchmark_seconds(int64_t ticks)
+{
+    static int64_t frequency = 0;
+
+    if (frequency == 0)
+    {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        frequency = f.QuadPart;
+    }
+
+    return (double)ticks / frequency;
+}
+
+// Doubles the iterations until one run takes a tenth of the target, then scales up to the target.
+static int64_t benchmark_calibrate(const Benchmark_Kernel& kernel, byte** buffers, int32_t length, double seconds)
+{
+    int64_t iterations = 1;
+
+    for (;;)
+    {
+        int64_t start = benchmark_now();
+        kernel.run(buffers, length, iterations);
+        double elapsed = benchmark_seconds(benchmark_now() - start);
+
+        if (elapsed >= seconds / 10 || iterations >= ((int64_t)1 << 40))
+        {
+            int64_t scaled = (int64_t)(iterations * (seconds / ((elapsed > 0) ? elapsed : 1e-9)));
+
+            return (scaled > 0) ? scaled : 1;
+        }
+
+        iterations *= 2;
+    }
+}
+
+struct Benchmark_Result
+{
+    double seconds;
+    uint64_t cycles;
+};
+
+// All threads start together; the time is from the start until the last one is done.
+static Benchmark_Result benchmark_measure(const Benchmark_Kernel& kernel, vector<Benchmark_Thread>& threads, int32_t count, int32_t offset, int32_t length, int64_t iterations)
+{
+    Benchmark_Result best;
+    best.seconds = 0;
+    best.cycles = 0;
+
+    for (int32_t r = 0; r < repeatCount; r++)
+    {
+        std::atomic<bool> go(false);
+        vector<std::thread> workers;
+
+        for (int32_t t = 1; t < count; t++)
+        {
+            workers.push_back(std::thread([&, t]()
+            {
+                byte* b[bufferCount];
+                for (int32_t i = 0; i < bufferCount; i++) b[i] = threads[t].buffers[i] + offset;
+
+                while (!go) {}
+
+                kernel.run(b, length, iterations);
+            }));
+        }
+
+        byte* b[bufferCount];
+        for (int32_t i = 0; i < bufferCount; i++) b[i] = threads[0].buffers[i] + offset;
+
+        uint64_t cycles = __rdtsc();
+        int64_t start = benchmark_now();
+        go = true;
+
+        kernel.run(b, length, iterations);
+
+        for (size_t i = 0; i < workers.size(); i++)
+        {
+            workers[i].join();
+        }
+
+        double seconds = benchmark_seconds(benchmark_now() - start);
+        cycles = __rdtsc() - cycles;
+
+        if (r == 0 || seconds < best.seconds)
+        {
+            best.seconds = seconds;
+            best.cycles = cycles;
+        }
+    }
+
+    return best;
+}
+
+static vector<int64_t> parseList(const string& value)
+{
+    vector<int64_t> result;
+    std::istringstream stream(value);
+    string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        result.push_back(_atoi64(item.c_str()));
+    }
+
+    return result;
+}
+
+static string benchmark_key(const string& kernel, int64_t size, int64_t offset, int64_t threads)
+{
+    std::ostringstream key;
+    key << kernel << "/" << size << "/" << offset << "/" << threads;
+
+    return key.str();
+}
+
+// Reads "name":value out of one result line written by this program.
+static bool findValue(const string& line, const char* name, string& value)
+{
+    string pattern = string("\"") + name + "\":";
+    size_t position = line.find(pattern);
+    if (position == string::npos) return false;
+
+    position += pattern.length();
+    if (position < line.length() && line[position] == '"') position++;
+
+    size_t end = line.find_first_of("\",}", position);
+    value = line.substr(position, end - position);
+
+    return true;
+}
+
+static std::map<string, double> loadBaseline(const char* path)
+{
+    std::map<string, double> baseline;
+    std::ifstream file(path);
+    string line;
+
+    while (std::getline(file, line))
+    {
+        string kernel, size, offset, threads, nsPerOp;
+
+        if (findValue(line, "kernel", kernel) && findValue(line, "size", size) && findValue(line, "offset", offset)
+            && findValue(line, "threads", threads) && findValue(line, "nsPerOp", nsPerOp))
+        {
+            baseline[benchmark_key(kernel, _atoi64(size.c_str()), _atoi64(offset.c_str()), _atoi64(threads.c_str()))] = atof(nsPerOp.c_str());
+        }
+    }
+
+    return baseline;
+}
+
+static string cpuName()
+{
+    int32_t info[4];
+    char name[49] = { 0 };
+
+    __cpuid(info, 0x80000000);
+    if ((uint32_t)info[0] < 0x80000004) return "";
+
+    for (int32_t i = 0; i < 3; i++)
+    {
+        __cpuid(info, 0x80000002 + i);
+        memcpy(name + (i * 16), info, 16);
+    }
+
+    return name;
+}
+
+// Benchmark.exe [--kernels copy,xor] [--min-size 1] [--max-size 67108864] [--offsets 0,1]
+//               [--threads 1,8] [--time 50] [--baseline previous.json]
+//
+// Sizes are the powers of two between min-size and max-size. One JSON result per line is written to stdout,
+// so the output of an older build can be passed back as --baseline.
+int main(int argc, char* argv[])
+{
+    try
+    {
+        string kernels;
+        int64_t minSize = 1;
+        int64_t maxSize = 64 * 1024 * 1024;
+        vector<int64_t> offsets = parseList("0,1");
+        vector<int64_t> threadCounts;
+        double seconds = 0.05;
+        std::map<string, double> baseline;
+
+        {
+            int32_t cores = (int32_t)std::thread::hardware_concurrency();
+
+            threadCounts.push_back(1);
+            if (cores > 1) threadCounts.push_back(cores);
+        }
+
+        for (int32_t i = 1; i + 1 < argc; i += 2)
+        {
+            string name = argv[i];
+            string value = argv[i + 1];
+
+            if (name == "--kernels") kernels = "," + value + ",";
+            else if (name == "--min-size") minSize = _atoi64(value.c_str());
+            else if (name == "--max-size") maxSize = _atoi64(value.c_str());
+            else if (name == "--offsets") offsets = parseList(value);
+            else if (name == "--threads") threadCounts = parseList(value);
+            else if (name == "--time") seconds = atof(value.c_str()) / 1000;
+            else if (name == "--baseline") baseline = loadBaseline(value.c_str());
+            else return 1;
+        }
+
+        if (minSize < 1 || maxSize > 0x7fffffff - bufferSlack || minSize > maxSize) return 1;
+
+        int32_t maxThreads = 1;
+
+        for (size_t i = 0; i < threadCounts.size(); i++)
+        {
+            if (threadCounts[i] < 1) return 1;
+            if (threadCounts[i] > maxThreads) maxThreads = (int32_t)threadCounts[i];
+        }
+
+        for (size_t i = 0; i < offsets.size(); i++)
+        {
+            if (offsets[i] < 0 || offsets[i] >= bufferSlack) return 1;
+        }
+
+        // The first two buffers hold the same bytes, so equals and compare read the whole length.
+        vector<Benchmark_Thread> threads(maxThreads);
+
+        for (int32_t t = 0; t < maxThreads; t++)
+        {
+            for (int32_t i = 0; i < bufferCount; i++)
+            {
+                byte* buffer = (byte*)_aligned_malloc((size_t)maxSize + bufferSlack, 64);
+                if (buffer == NULL) return 1;
+
+                for (int64_t j = 0; j < maxSize + bufferSlack; j++) buffer[j] = (byte)(j * 31);
+
+                threads[t].buffers[i] = buffer;
+            }
+        }
+
+        cout << "{\"cpu\":\"" << cpuName() << "\",\"results\":[" << endl;
+
+        bool first = true;
+
+        for (size_t k = 0; k < sizeof(benchmark_kernels) / sizeof(benchmark_kernels[0]); k++)
+        {
+            const Benchmark_Kernel& kernel = benchmark_kernels[k];
+            if (!kernels.empty() && kernels.find("," + string(kernel.name) + ",") == string::npos) continue;
+
+            for (int64_t size = minSize; size <= maxSize; size *= 2)
+            {
+                int32_t length = (int32_t)size;
+
+                for (size_t o = 0; o < offsets.size(); o++)
+                {
+                    int32_t offset = (int32_t)offsets[o];
+
+                    byte* b[bufferCount];
+                    for (int32_t i = 0; i < bufferCount; i++) b[i] = threads[0].buffers[i] + offset;
+
+                    int64_t iterations = benchmark_calibrate(kernel, b, length, seconds);
+
+                    for (size_t t = 0; t < threadCounts.size(); t++)
+                    {
+                        int32_t count = (int32_t)threadCounts[t];
+
+                        Benchmark_Result result = benchmark_measure(kernel, threads, count, offset, length, iterations);
+
+                        double nsPerOp = (result.seconds * 1e9) / iterations;
+                        double bytes = (double)length * iterations * count;
+
+                        std::ostringstream json;
+                        json << "{\"kernel\":\"" << kernel.name << "\""
+                            << ",\"size\":" << length
+                            << ",\"offset\":" << offset
+                            << ",\"threads\":" << count
+                            << ",\"tier\":\"" << kernel.tier(length) << "\""
+                            << ",\"nsPerOp\":" << nsPerOp
+                            << ",\"gbPerSecond\":" << (bytes / result.seconds / 1e9)
+                            << ",\"cyclesPerByte\":" << (result.cycles / bytes);
+
+                        std::map<string, double>::const_iterator previous = baseline.find(benchmark_key(kernel.name, length, offset, count));
+
+                        if (previous != baseline.end())
+                        {
+                            json << ",\"baselineNsPerOp\":" << previous->second
+                                << ",\"speedup\":" << (previous->second / nsPerOp);
+                        }
+
+                        json << "}";
+
+                        cout << (first ? "" : ",\n") << json.str() << std::flush;
+                        first = false;
+                    }
+                }
+            }
+        }
+
+        cout << endl << "]}" << endl;
+
+        for (int32_t t = 0; t < maxThreads; t++)
+        {
+            for (int32_t i = 0; i < bufferCount; i++)
+            {
+                _aligned_free(threads[t].buffers[i]);
+            }
+        }
+    }
+    catch (std::exception&)
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+#include "stdafx.h"
+#include "Sha256.h"
+
+#include <intrin.h>
+
+#include "emmintrin.h" //SSE2
+#include "immintrin.h" //AVX2
+
+static const uint32_t K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H[8] =
+{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+// The second block of a 64 byte message is always 0x80, zeros and the bit length 512,
+// so its message schedule plus round constants can be computed once.
+class Sha256_PaddingSchedule
+{
+public:
+    Sha256_PaddingSchedule()
+    {
+        uint32_t w[64];
+
+        w[0] = 0x80000000;
+        for (int32_t t = 1; t < 15; t++) w[t] = 0;
+        w[15] = 512;
+
+        for (int32_t t = 16; t < 64; t++)
+        {
+            uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        for (int32_t t = 0; t < 64; t++) kw[t] = K[t] + w[t];
+    }
+
+    uint32_t kw[64];
+
+private:
+    static uint32_t rotr(uint32_t x, int32_t n) { return (x >> n) | (x << (32 - n)); }
+};
+
+static const Sha256_PaddingSchedule _padding;
+
+struct Lanes1
+{
+    typedef uint32_t type;
+    enum { count = 1 };
+
+    static __forceinline type load(const uint32_t* p) { return *p; }
+    static __forceinline void store(uint32_t* p, type x) { *p = x; }
+    static __forceinline type set1(uint32_t x) { return x; }
+    static __forceinline type add(type a, type b) { return a + b; }
+    static __forceinline type xor3(type a, type b, type c) { return a ^ b ^ c; }
+    static __forceinline type rotr(type x, int32_t n) { return (x >> n) | (x << (32 - n)); }
+    static __forceinline type shr(type x, int32_t n) { return x >> n; }
+    static __forceinline type ch(type e, type f, type g) { return (e & f) ^ (~e & g); }
+    static __forceinline type maj(type a, type b, type c) { return (a & b) | (c & (a | b)); }
+};
+
+struct Lanes4
+{
+    typedef __m128i type;
+    enum { count = 4 };
+
+    static __forceinline type load(const uint32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static __forceinline void store(uint32_t* p, type x) { _mm_storeu_si128((__m128i*)p, x); }
+    static __forceinline type set1(uint32_t x) { return _mm_set1_epi32((int)x); }
+    static __forceinline type add(type a, type b) { return _mm_add_epi32(a, b); }
+    static __forceinline type xor3(type a, type b, type c) { return _mm_xor_si128(_mm_xor_si128(a, b), c); }
+    static __forceinline type rotr(type x, int32_t n) { return _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - n)); }
+    static __forceinline type shr(type x, int32_t n) { return _mm_srli_epi32(x, n); }
+    static __forceinline type ch(type e, type f, type g) { return _mm_xor_si128(_mm_and_si128(e, f), _mm_andnot_si128(e, g)); }
+    static __forceinline type maj(type a, type b, type c) { return _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(c, _mm_or_si128(a, b))); }
+};
+
+struct Lanes8
+{
+    typedef __m256i type;
+    enum { count = 8 };
+
+    static __forceinline type load(const uint32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static __forceinline void store(uint32_t* p, type x) { _mm256_storeu_si256((__m256i*)p, x); }
+    static __forceinline type set1(uint32_t x) { return _mm256_set1_epi32((int)x); }
+    static __forceinline type add(type a, type b) { return _mm256_add_epi32(a, b); }
+    static __forceinline type xor3(type a, type b, type c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+    static __forceinline type rotr(type x, int32_t n) { return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+    static __forceinline type shr(type x, int32_t n) { return _mm256_srli_epi32(x, n); }
+    static __forceinline type ch(type e, type f, type g) { return _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g)); }
+    static __forceinline type maj(type a, type b, type c) { return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))); }
+};
+
+#define SHA256_ROUND(L, a, b, c, d, e, f, g, h, kw) \
+    { \
+        typename L::type t1 = L::add(L::add(L::add(h, L::xor3(L::rotr(e, 6), L::rotr(e, 11), L::rotr(e, 25))), L::ch(e, f, g)), kw); \
+        typename L::type t2 = L::add(L::xor3(L::rotr(a, 2), L::rotr(a, 13), L::rotr(a, 22)), L::maj(a, b, c)); \
+        d = L::add(d, t1); \
+        h = L::add(t1, t2); \
+    }
+
+template<class L>
+__forceinline void sha256_64_compress(const uint32_t* words, uint32_t* states)
+{
+    typedef typename L::type T;
+
+    T w[16];
+    T a, b, c, d, e, f, g, h;
+
+    for (int32_t t = 0; t < 16; t++)
+    {
+        w[t] = L::load(words + (t * L::count));
+    }
+
+    a = L::set1(H[0]); b = L::set1(H[1]); c = L::set1(H[2]); d = L::set1(H[3]);
+    e = L::set1(H[4]); f = L::set1(H[5]); g = L::set1(H[6]); h = L::set1(H[7]);
+
+    // Block 1: message
+    for (int32_t t = 0; t < 64; t += 8)
+    {
+        if (t >= 16)
+        {
+            for (int32_t i = 0; i < 8; i++)
+            {
+                int32_t j = (t + i) & 15;
+
+                T w15 = w[(t + i - 15) & 15];
+                T w2 = w[(t + i - 2) & 15];
+
+                T s0 = L::xor3(L::rotr(w15, 7), L::rotr(w15, 18), L::shr(w15, 3));
+                T s1 = L::xor3(L::rotr(w2, 17), L::rotr(w2, 19), L::shr(w2, 10));
+
+                w[j] = L::add(L::add(w[j], s0), L::add(w[(t + i - 7) & 15], s1));
+            }
+        }
+
+        SHA256_ROUND(L, a, b, c, d, e, f, g, h, L::add(w[(t + 0) & 15], L::set1(K[t + 0])));
+        SHA256_ROUND(L, h, a, b, c, d, e, f, g, L::add(w[(t + 1) & 15], L::set1(K[t + 1])));
+        SHA256_ROUND(L, g, h, a, b, c, d, e, f, L::add(w[(t + 2) & 15], L::set1(K[t + 2])));
+        SHA256_ROUND(L, f, g, h, a, b, c, d, e, L::add(w[(t + 3) & 15], L::set1(K[t + 3])));
+        SHA256_ROUND(L, e, f, g, h, a, b, c, d, L::add(w[(t + 4) & 15], L::set1(K[t + 4])));
+        SHA256_ROUND(L, d, e, f, g, h, a, b, c, L::add(w[(t + 5) & 15], L::set1(K[t + 5])));
+        SHA256_ROUND(L, c, d, e, f, g, h, a, b, L::add(w[(t + 6) & 15], L::set1(K[t + 6])));
+        SHA256_ROUND(L, b, c, d, e, f, g, h, a, L::add(w[(t + 7) & 15], L::set1(K[t + 7])));
+    }
+
+    a = L::add(a, L::set1(H[0])); b = L::add(b, L::set1(H[1])); c = L::add(c, L::set1(H[2])); d = L::add(d, L::set1(H[3]));
+    e = L::add(e, L::set1(H[4])); f = L::add(f, L::set1(H[5])); g = L::add(g, L::set1(H[6])); h = L::add(h, L::set1(H[7]));
+
+    T s[8] = { a, b, c, d, e, f, g, h };
+
+    // Block 2: constant padding
+    for (int32_t t = 0; t < 64; t += 8)
+    {
+        SHA256_ROUND(L, a, b, c, d, e, f, g, h, L::set1(_padding.kw[t + 0]));
+        SHA256_ROUND(L, h, a, b, c, d, e, f, g, L::set1(_padding.kw[t + 1]));
+        SHA256_ROUND(L, g, h, a, b, c, d, e, f, L::set1(_padding.kw[t + 2]));
+        SHA256_ROUND(L, f, g, h, a, b, c, d, e, L::set1(_padding.kw[t + 3]));
+        SHA256_ROUND(L, e, f, g, h, a, b, c, d, L::set1(_padding.kw[t + 4]));
+        SHA256_ROUND(L, d, e, f, g, h, a, b, c, L::set1(_padding.kw[t + 5]));
+        SHA256_ROUND(L, c, d, e, f, g, h, a, b, L::set1(_padding.kw[t + 6]));
+        SHA256_ROUND(L, b, c, d, e, f, g, h, a, L::set1(_padding.kw[t + 7]));
+    }
+
+    L::store(states + (0 * L::count), L::add(s[0], a));
+    L::store(states + (1 * L::count), L::add(s[1], b));
+    L::store(states + (2 * L::count), L::add(s[2], c));
+    L::store(states + (3 * L::count), L::add(s[3], d));
+    L::store(states + (4 * L::count), L::add(s[4], e));
+    L::store(states + (5 * L::count), L::add(s[5], f));
+    L::store(states + (6 * L::count), L::add(s[6], g));
+    L::store(states + (7 * L::count), L::add(s[7], h));
+}
+
+void sha256_64_x1(const uint32_t* words, uint32_t* states)
+{
+    sha256_64_compress<Lanes1>(words, states);
+}
+
+void sha256_64_x4(const uint32_t* words, uint32_t* states)
+{
+    sha256_64_compress<Lanes4>(words, states);
+}
+
+void sha256_64_x8(const uint32_t* words, uint32_t* states)
+{
+    sha256_64_compress<Lanes8>(words, states);
+}
+
+static int32_t sha256_64_detect()
+{
+    int32_t info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7) return 4;
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return 4;
+
+    // The OS must save the YMM registers.
+    if ((_xgetbv(0) & 0x6) != 0x6) return 4;
+
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+
+    return avx2 ? 8 : 4;
+}
+
+int32_t sha256_64_lanes()
+{
+    static const int32_t lanes = sha256_64_detect();
+
+    return lanes;
+}
+
+int32_t sha256_count(const uint32_t* state, int32_t stride)
+{
+    int32_t count = 0;
+
+    for (int32_t i = 0; i < 8; i++)
+    {
+        uint32_t w = state[i * stride];
+
+        if (w == 0)
+        {
+            count += 32;
+            continue;
+        }
+
+        while ((w & 0x80000000) == 0)
+        {
+            count++;
+            w <<= 1;
+        }
+
+        break;
+    }
+
+    return count;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// SHA-256 of exactly 64 bytes (one data block and one constant padding block).
+// words:  16 * lanes big-endian message words, word-major (words[t * lanes + lane])
+// states: 8 * lanes digest words, word-major (states[t * lanes + lane])
+void sha256_64_x1(const uint32_t* words, uint32_t* states);
+void sha256_64_x4(const uint32_t* words, uint32_t* states);
+void sha256_64_x8(const uint32_t* words, uint32_t* states);
+
+// Widest kernel usable on this CPU (1, 4 or 8).
+int32_t sha256_64_lanes();
+
+// Number of leading zero bits of a digest given as 8 words.
+int32_t sha256_count(const uint32_t* state, int32_t stride);
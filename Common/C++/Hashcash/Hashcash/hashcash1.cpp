@@ -2,6 +2,16 @@
 #include "hashcash1.h"
 
 #include "Xorshift.h"
+#include "Sha256.h"
+#include "..\..\Library\Library\TaskRuntime.h"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <math.h>
 
 using std::cout;
 using std::endl;
@@ -14,168 +24,395 @@ using CryptoPP::Exception;
 #include "sha.h"
 using CryptoPP::SHA256;
 
-byte* hashcash1_Create(byte* value, int32_t limit, int32_t timeout)
+const size_t hashSize = 32;
+
+// The cancel flag, the timeout and the statistics are only looked at once per this many hashes.
+const int32_t probeInterval = 4096;
+
+// Milliseconds between two statistics reports.
+const int64_t reportInterval = 1000;
+
+struct hashcash1_counter
 {
-    try
-    {
-        clock_t clockStart, clockEnd;
+    volatile uint64_t hashes;
+    byte padding[64 - sizeof(uint64_t)];
+};
+
+struct hashcash1_state
+{
+    byte value[hashSize];
+    int32_t limit;
+    int32_t target;
+    int32_t timeout;
+    volatile int32_t* cancel;
+    hashcash1_progress progress;
+
+    int64_t frequency;
+    int64_t start;
+
+    std::mutex mutex;
+    std::atomic<bool> done;
 
-        if (timeout != -1)
+    bool found;
+    int32_t count;
+    byte finalState[hashSize * 2];
+    byte finalResult[hashSize];
+
+    std::vector<hashcash1_counter> counters;
+};
+
+int64_t hashcash1_clock(hashcash1_state* state)
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return ((counter.QuadPart - state->start) * 1000) / state->frequency;
+}
+
+// RC̎Zo
+int32_t hashcash1_count(byte* result)
+{
+    int32_t count = 0;
+
+    for (int32_t i = 0; i < hashSize; i++)
+    {
+        for (int32_t j = 0; j < 8; j++)
         {
-            clockStart = clock();
+            if(((result[i] << j) & 0x80) == 0) count++;
+            else goto End;
         }
+    }
+End:
+
+    return count;
+}
+
+void hashcash1_report(hashcash1_state* state, int64_t elapsed)
+{
+    int32_t count;
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        count = state->found ? state->count : 0;
+    }
+
+    double seconds = (elapsed > 0) ? (elapsed / 1000.0) : 0.001;
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(1);
+
+    uint64_t hashes = 0;
+
+    json << "{\"threads\":" << state->counters.size() << ",\"hashrates\":[";
+
+    for (size_t i = 0; i < state->counters.size(); i++)
+    {
+        uint64_t threadHashes = state->counters[i].hashes;
+        hashes += threadHashes;
+
+        if (i != 0) json << ",";
+        json << (threadHashes / seconds);
+    }
+
+    double hashrate = hashes / seconds;
+
+    json << "],\"hashrate\":" << hashrate;
+    json << ",\"hashes\":" << hashes;
+    json << ",\"elapsed\":" << std::setprecision(3) << seconds;
+    json << ",\"best\":" << count;
+
+    // Each hash reaches the target with probability 2^-target, independently of the hashes before it.
+    if (state->target != -1)
+    {
+        double expected = 0;
+        if (count < state->target) expected = (hashrate > 0) ? (pow(2.0, state->target) / hashrate) : -1;
+
+        json << ",\"target\":" << state->target << ",\"expected\":" << expected;
+    }
+
+    json << "}";
+
+    if (state->progress != NULL) state->progress(json.str().c_str());
+}
+
+void hashcash1_submit(hashcash1_state* state, byte* currentState, byte* currentResult)
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    if (state->found && memcmp(currentResult, state->finalResult, hashSize) >= 0) return;
+
+    memcpy(state->finalState, currentState, hashSize * 2);
+    memcpy(state->finalResult, currentResult, hashSize);
+    state->found = true;
+
+    state->count = hashcash1_count(state->finalResult);
+
+    if (state->limit != -1 && state->count >= state->limit) state->done = true;
+}
+
+void hashcash1_worker(void* context, int32_t index)
+{
+    hashcash1_state* state = (hashcash1_state*)context;
+
+    // One of the workers is the thread that called hashcash1_run, so its priority is put back on the way out.
+    HANDLE thread = GetCurrentThread();
+    int priority = GetThreadPriority(thread);
+
+    try
+    {
+        SetThreadPriority(thread, THREAD_PRIORITY_IDLE);
 
         SHA256 hash;
         Xorshift xorshift;
 
-        const size_t hashSize = 32;
-
         byte currentState[hashSize * 2];
         byte currentResult[hashSize];
 
-        byte finalState[hashSize * 2];
-        byte finalResult[hashSize];
+        byte bestResult[hashSize];
+        bool hasBest = false;
 
-        memcpy(currentState + hashSize, value, hashSize);
-        memcpy(finalState + hashSize, value, hashSize);
+        uint64_t hashes = 0;
+        int64_t reported = 0;
 
-        // Initialize
-        {
-            ((uint32_t*)currentState)[0] = xorshift.next();
-            ((uint32_t*)currentState)[1] = xorshift.next();
-            ((uint32_t*)currentState)[2] = xorshift.next();
-            ((uint32_t*)currentState)[3] = xorshift.next();
-            ((uint32_t*)currentState)[4] = xorshift.next();
-            ((uint32_t*)currentState)[5] = xorshift.next();
-            ((uint32_t*)currentState)[6] = xorshift.next();
-            ((uint32_t*)currentState)[7] = xorshift.next();
-
-            hash.CalculateDigest(currentResult, currentState, hashSize * 2);
-        }
+        memcpy(currentState + hashSize, state->value, hashSize);
 
-        memcpy(finalState, currentState, hashSize * 2);
-        memcpy(finalResult, currentResult, hashSize);
-
-        // RC̎Zo
-        if (limit != -1)
+        for (;;)
         {
-            int32_t count = 0;
-
-            for (int32_t i = 0; i < hashSize; i++)
+            for (int32_t n = probeInterval; n > 0; n--)
             {
-                for (int32_t j = 0; j < 8; j++)
+                ((uint32_t*)currentState)[0] = xorshift.next();
+                ((uint32_t*)currentState)[1] = xorshift.next();
+                ((uint32_t*)currentState)[2] = xorshift.next();
+                ((uint32_t*)currentState)[3] = xorshift.next();
+                ((uint32_t*)currentState)[4] = xorshift.next();
+                ((uint32_t*)currentState)[5] = xorshift.next();
+                ((uint32_t*)currentState)[6] = xorshift.next();
+                ((uint32_t*)currentState)[7] = xorshift.next();
+
+                hash.CalculateDigest(currentResult, currentState, hashSize * 2);
+
+                // Xbh̍ŏlXVALԂƔrB
+                if (!hasBest || memcmp(currentResult, bestResult, hashSize) < 0)
                 {
-                    if(((finalResult[i] << j) & 0x80) == 0) count++;
-                    else goto End1;
+                    memcpy(bestResult, currentResult, hashSize);
+                    hasBest = true;
+
+                    hashcash1_submit(state, currentState, currentResult);
                 }
             }
-        End1:
 
-            if (count >= limit) goto HIT;
-        }
+            hashes += probeInterval;
+            state->counters[index].hashes = hashes;
 
-        for (;;)
-        {
-            ((uint32_t*)currentState)[0] = xorshift.next();
-            ((uint32_t*)currentState)[1] = xorshift.next();
-            ((uint32_t*)currentState)[2] = xorshift.next();
-            ((uint32_t*)currentState)[3] = xorshift.next();
-            ((uint32_t*)currentState)[4] = xorshift.next();
-            ((uint32_t*)currentState)[5] = xorshift.next();
-            ((uint32_t*)currentState)[6] = xorshift.next();
-            ((uint32_t*)currentState)[7] = xorshift.next();
-
-            hash.CalculateDigest(currentResult, currentState, hashSize * 2);
-
-            for (int32_t i = 0; i < hashSize; i++)
+            // Gives the core back while decoding or verifying needs it.
+            task_yield(TaskLane_Background);
+
+            if (state->done) break;
+
+            if (state->cancel != NULL && *state->cancel != 0)
             {
-                int32_t c = finalResult[i] - currentResult[i];
+                state->done = true;
+                break;
+            }
 
-                if (c < 0)
-                {
-                    break;
-                }
-                else if (c == 0)
-                {
-                    continue;
-                }
-                else
-                {
-                    memcpy(finalState, currentState, hashSize * 2);
-                    memcpy(finalResult, currentResult, hashSize);
-
-                    // RC̎Zo
-                    if (limit != -1)
-                    {
-                        int32_t count = 0;
-
-                        for (int32_t i = 0; i < hashSize; i++)
-                        {
-                            for (int32_t j = 0; j < 8; j++)
-                            {
-                                if(((finalResult[i] << j) & 0x80) == 0) count++;
-                                else goto End2;
-                            }
-                        }
-                    End2:
-
-                        if (count >= limit) goto HIT;
-                    }
-
-                    break;
-                }
+            int64_t elapsed = hashcash1_clock(state);
+
+            if (state->timeout != -1 && elapsed > state->timeout)
+            {
+                state->done = true;
+                break;
             }
 
-            if (timeout != -1)
+            if (index == 0 && (elapsed - reported) >= reportInterval)
             {
-                clockEnd = clock();
-            
-                if (((clockEnd - clockStart) / CLOCKS_PER_SEC) > timeout)
-                {
-                    break;
-                }
+                hashcash1_report(state, elapsed);
+                reported = elapsed;
             }
         }
+    }
+    catch (exception&)
+    {
+        state->done = true;
+    }
+
+    if (priority != THREAD_PRIORITY_ERROR_RETURN) SetThreadPriority(thread, priority);
+}
+
+byte* hashcash1_run(byte* value, int32_t limit, int32_t target, int32_t timeout, int32_t threads, volatile int32_t* cancel, hashcash1_progress progress)
+{
+    try
+    {
+        if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+
+        LARGE_INTEGER frequency, start;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&start);
+
+        hashcash1_state state;
+        memcpy(state.value, value, hashSize);
+        state.limit = limit;
+        state.target = target;
+        state.timeout = timeout;
+        state.cancel = cancel;
+        state.progress = progress;
+        state.frequency = frequency.QuadPart;
+        state.start = start.QuadPart;
+        state.done = false;
+        state.found = false;
+        state.count = 0;
 
-    HIT:
+        {
+            hashcash1_counter counter;
+            counter.hashes = 0;
+
+            state.counters.resize(threads, counter);
+        }
+
+        // One index per thread; each worker runs until the search is over.
+        task_parallel_for(TaskLane_Background, threads, threads, NULL, hashcash1_worker, &state);
+
+        if (progress != NULL) hashcash1_report(&state, hashcash1_clock(&state));
+
+        // A canceled search fails, as the killed mining process used to. Only a timeout hands back the best key so far.
+        if (cancel != NULL && *cancel != 0) return NULL;
+
+        if (!state.found) return NULL;
 
         byte* key = (byte*)malloc(hashSize);
-        memcpy(key, finalState, hashSize);
+        memcpy(key, state.finalState, hashSize);
 
         return key;
     }
-    catch (exception& e)
+    catch (exception&)
     {
-        throw e;
+        return NULL;
     }
 }
 
-int32_t hashcash1_Verify(byte* key, byte* value)
+byte* hashcash1_create(byte* value, int32_t limit, int32_t timeout, int32_t threads, volatile int32_t* cancel, hashcash1_progress progress)
 {
-    SHA256 hash;
-    Xorshift xorshift;
+    return hashcash1_run(value, limit, limit, timeout, threads, cancel, progress);
+}
 
-    const size_t hashSize = 32;
+void hashcash1_bench(int32_t target, int32_t timeout, int32_t threads, hashcash1_progress progress)
+{
+    byte value[hashSize];
 
-    byte currentState[hashSize * 2];
-    byte currentResult[hashSize];
+    {
+        Xorshift xorshift;
 
-    memcpy(currentState, key, hashSize);
-    memcpy(currentState + hashSize, value, hashSize);
+        for (int32_t i = 0; i < hashSize / 4; i++)
+        {
+            ((uint32_t*)value)[i] = xorshift.next();
+        }
+    }
 
-    hash.CalculateDigest(currentResult, currentState, hashSize * 2);
+    byte* key = hashcash1_run(value, -1, target, timeout, threads, NULL, progress);
+    if (key != NULL) hashcash1_free(key);
+}
 
-    int32_t count = 0;
+inline uint32_t hashcash1_load(byte* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
 
-    for (int32_t i = 0; i < hashSize; i++)
+void hashcash1_words(byte* key, byte* value, uint32_t* words, int32_t lane, int32_t lanes)
+{
+    for (int32_t t = 0; t < 8; t++)
     {
-        for (int32_t j = 0; j < 8; j++)
+        words[(t * lanes) + lane] = hashcash1_load(key + (t * 4));
+        words[((t + 8) * lanes) + lane] = hashcash1_load(value + (t * 4));
+    }
+}
+
+int32_t hashcash1_verify(byte* key, byte* value)
+{
+    uint32_t words[16];
+    uint32_t states[8];
+
+    hashcash1_words(key, value, words, 0, 1);
+    sha256_64_x1(words, states);
+
+    return sha256_count(states, 1);
+}
+
+void hashcash1_verify_range(byte* keys, byte* values, int32_t* counts, int32_t offset, int32_t length)
+{
+    const int32_t lanes = sha256_64_lanes();
+
+    uint32_t words[16 * 8];
+    uint32_t states[8 * 8];
+
+    int32_t i = offset;
+    int32_t end = offset + length;
+
+    for (; (end - i) >= lanes; i += lanes)
+    {
+        for (int32_t lane = 0; lane < lanes; lane++)
         {
-            if(((currentResult[i] << j) & 0x80) == 0) count++;
-            else goto End;
+            hashcash1_words(keys + ((i + lane) * hashSize), values + ((i + lane) * hashSize), words, lane, lanes);
+        }
+
+        if (lanes == 8) sha256_64_x8(words, states);
+        else if (lanes == 4) sha256_64_x4(words, states);
+        else sha256_64_x1(words, states);
+
+        for (int32_t lane = 0; lane < lanes; lane++)
+        {
+            counts[i + lane] = sha256_count(states + lane, lanes);
         }
     }
-End:
 
-    return count;
+    for (; i < end; i++)
+    {
+        counts[i] = hashcash1_verify(keys + (i * hashSize), values + (i * hashSize));
+    }
+}
+
+struct hashcash1_batch
+{
+    byte* keys;
+    byte* values;
+    int32_t* counts;
+    int32_t count;
+    int32_t chunk;
+};
+
+void hashcash1_verify_chunk(void* context, int32_t index)
+{
+    hashcash1_batch* batch = (hashcash1_batch*)context;
+
+    int32_t offset = index * batch->chunk;
+    int32_t length = batch->count - offset;
+    if (length > batch->chunk) length = batch->chunk;
+
+    hashcash1_verify_range(batch->keys, batch->values, batch->counts, offset, length);
+}
+
+void hashcash1_verify_batch(byte* keys, byte* values, int32_t count, int32_t* counts, int32_t threads)
+{
+    // Below this many pairs per thread, starting a thread costs more than it saves.
+    const int32_t minimum = 1024;
+
+    if (count <= 0) return;
+
+    if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+    if (threads > count / minimum) threads = count / minimum;
+    if (threads <= 0) threads = 1;
+
+    hashcash1_batch batch;
+    batch.keys = keys;
+    batch.values = values;
+    batch.counts = counts;
+    batch.count = count;
+    batch.chunk = (((count + threads - 1) / threads) + 7) & ~7;
+
+    task_parallel_for(TaskLane_Bulk, (count + batch.chunk - 1) / batch.chunk, threads, NULL, hashcash1_verify_chunk, &batch);
+}
+
+void hashcash1_free(byte* key)
+{
+    free(key);
 }
@@ -1,4 +1,14 @@
 #pragma once
 
-byte* hashcash1_Create(byte* value, int32_t limit, int32_t timeout);
-int32_t hashcash1_Verify(byte* key, byte* value);
+// Receives a JSON object with the per-thread and total hashrate, the best count so far
+// and the expected seconds to reach the target count.
+typedef void (__stdcall *hashcash1_progress)(const char* statistics);
+
+// Returns the best key found within timeout, or NULL if *cancel was set or nothing was found.
+// The key is released with hashcash1_free.
+byte* hashcash1_create(byte* value, int32_t limit, int32_t timeout, int32_t threads, volatile int32_t* cancel, hashcash1_progress progress);
+int32_t hashcash1_verify(byte* key, byte* value);
+void hashcash1_verify_batch(byte* keys, byte* values, int32_t count, int32_t* counts, int32_t threads);
+void hashcash1_free(byte* key);
+
+void hashcash1_bench(int32_t target, int32_t timeout, int32_t threads, hashcash1_progress progress);
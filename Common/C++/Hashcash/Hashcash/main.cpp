@@ -93,6 +93,11 @@ byte* fromHexString(string value, size_t& size)
     return buffer;
 }
 
+void __stdcall writeStatistics(const char* statistics)
+{
+    std::cerr << statistics << endl;
+}
+
 //#define TEST
 
 #ifdef TEST
@@ -121,11 +126,14 @@ int main(int argc, char* argv[])
                 int32_t limit = atoi(argv[4]);
                 int32_t timeout = atoi(argv[5]);
 
-                byte* key = hashcash1_Create(value, limit, timeout);
+                if (timeout != -1) timeout *= 1000;
+
+                byte* key = hashcash1_create(value, limit, timeout, 1, NULL, NULL);
+                if (key == NULL) return 1;
 
                 cout << toHexString(key, 32) << endl;
 
-                free(key);
+                hashcash1_free(key);
 
                 free(value);
             }
@@ -139,7 +147,7 @@ int main(int argc, char* argv[])
                 byte* value = fromHexString((string)argv[4], valueSize);
                 if (valueSize != 32) return 1;
 
-                int32_t count = hashcash1_Verify(key, value);
+                int32_t count = hashcash1_verify(key, value);
 
                 free(value);
 
@@ -147,6 +155,14 @@ int main(int argc, char* argv[])
 
                 free(key);
             }
+            else if((string)argv[2] == "bench")
+            {
+                int32_t threads = (argc > 3) ? atoi(argv[3]) : 0;
+                int32_t timeout = (argc > 4) ? atoi(argv[4]) : 10;
+                int32_t target = (argc > 5) ? atoi(argv[5]) : -1;
+
+                hashcash1_bench(target, timeout * 1000, threads, writeStatistics);
+            }
         }
     }
     catch (exception&)
@@ -0,0 +1,201 @@
+#include "stdafx.h"
+#include "Base64.h"
+
+#include <intrin.h>
+#include "tmmintrin.h" //SSSE3
+
+// base64url (RFC 4648 section 5) without padding, on UTF-16 text as .NET strings hold it.
+// The vector kernels follow Wojciech Mula's SSSE3 base64 codec, with the '-' and '_' alphabet.
+
+static const char base64url_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static bool base64url_ssse3_detect()
+{
+    int32_t info[4];
+
+    __cpuid(info, 1);
+
+    return (info[2] & (1 << 9)) != 0;
+}
+
+static bool base64url_ssse3()
+{
+    static const bool ssse3 = base64url_ssse3_detect();
+
+    return ssse3;
+}
+
+// Value of each ASCII character, -1 outside the alphabet.
+static const int8_t base64url_values[128] =
+{
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -1, -1, -1,
+    -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, 63,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1
+};
+
+static inline int32_t base64url_value(wchar_t c)
+{
+    return (c < 128) ? base64url_values[c] : -1;
+}
+
+// 12 bytes to 16 characters per step.
+static int32_t base64url_encode_ssse3(const byte* source, int32_t length, wchar_t* result)
+{
+    const __m128i shuffle = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m128i shift = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62,
+        '_' - 63, 'A', 0, 0);
+    const __m128i zero = _mm_setzero_si128();
+
+    int32_t i = 0;
+
+    // The load reads 16 bytes for the 12 it uses.
+    for (; i + 16 <= length; i += 12)
+    {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + i)), shuffle);
+
+        // Splits every 3 bytes into four 6 bit indexes, one per byte.
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i indexes = _mm_or_si128(t0, t1);
+
+        // Index ranges 0-25, 26-51, 52-61, 62, 63 select their offset from the shift table.
+        __m128i ranges = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+        ranges = _mm_or_si128(ranges, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+
+        __m128i characters = _mm_add_epi8(_mm_shuffle_epi8(shift, ranges), indexes);
+
+        wchar_t* target = result + ((i / 3) * 4);
+        _mm_storeu_si128((__m128i*)(target + 0), _mm_unpacklo_epi8(characters, zero));
+        _mm_storeu_si128((__m128i*)(target + 8), _mm_unpackhi_epi8(characters, zero));
+    }
+
+    return i;
+}
+
+// 16 characters to 12 bytes per step. Returns the number of characters done, or -1 on a character outside
+// the alphabet.
+static int32_t base64url_decode_ssse3(const wchar_t* source, int32_t length, byte* result)
+{
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+    int32_t i = 0;
+
+    // The store writes 16 bytes for the 12 it produces, so at least 6 more characters (4 bytes) must follow.
+    for (; i + 22 <= length; i += 16)
+    {
+        // Characters above 0xff saturate to 0xff, and above 0x7fff to 0; both are rejected below.
+        __m128i c = _mm_packus_epi16(_mm_loadu_si128((const __m128i*)(source + i)), _mm_loadu_si128((const __m128i*)(source + i + 8)));
+
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), c));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('z' + 1), c));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+        __m128i minus = _mm_cmpeq_epi8(c, _mm_set1_epi8('-'));
+        __m128i underscore = _mm_cmpeq_epi8(c, _mm_set1_epi8('_'));
+
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, minus), underscore));
+        if (_mm_movemask_epi8(valid) != 0xffff) return -1;
+
+        __m128i shift = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+        shift = _mm_or_si128(shift, _mm_and_si128(lower, _mm_set1_epi8(26 - 'a')));
+        shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(52 - '0')));
+        shift = _mm_or_si128(shift, _mm_and_si128(minus, _mm_set1_epi8(62 - '-')));
+        shift = _mm_or_si128(shift, _mm_and_si128(underscore, _mm_set1_epi8(63 - '_')));
+
+        __m128i values = _mm_add_epi8(c, shift);
+
+        // Four 6 bit values to 3 bytes in every 32 bit lane, then the lanes are packed together.
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+
+        _mm_storeu_si128((__m128i*)(result + ((i / 4) * 3)), _mm_shuffle_epi8(merged, pack));
+    }
+
+    return i;
+}
+
+// Writes ceil(length * 4 / 3) characters to result and returns that count.
+int32_t base64url_encode(byte* source, int32_t length, wchar_t* result)
+{
+    int32_t i = 0;
+
+    if (base64url_ssse3()) i = base64url_encode_ssse3(source, length, result);
+
+    wchar_t* target = result + ((i / 3) * 4);
+
+    for (; i + 3 <= length; i += 3)
+    {
+        uint32_t x = ((uint32_t)source[i] << 16) | ((uint32_t)source[i + 1] << 8) | source[i + 2];
+
+        *target++ = base64url_alphabet[(x >> 18) & 0x3f];
+        *target++ = base64url_alphabet[(x >> 12) & 0x3f];
+        *target++ = base64url_alphabet[(x >> 6) & 0x3f];
+        *target++ = base64url_alphabet[x & 0x3f];
+    }
+
+    if (length - i == 1)
+    {
+        uint32_t x = (uint32_t)source[i] << 16;
+
+        *target++ = base64url_alphabet[(x >> 18) & 0x3f];
+        *target++ = base64url_alphabet[(x >> 12) & 0x3f];
+    }
+    else if (length - i == 2)
+    {
+        uint32_t x = ((uint32_t)source[i] << 16) | ((uint32_t)source[i + 1] << 8);
+
+        *target++ = base64url_alphabet[(x >> 18) & 0x3f];
+        *target++ = base64url_alphabet[(x >> 12) & 0x3f];
+        *target++ = base64url_alphabet[(x >> 6) & 0x3f];
+    }
+
+    return (int32_t)(target - result);
+}
+
+// Decodes length characters without padding and returns the number of bytes written, length * 3 / 4,
+// or -1 when a character is outside the alphabet or length % 4 == 1.
+int32_t base64url_decode(wchar_t* source, int32_t length, byte* result)
+{
+    if (length % 4 == 1) return -1;
+
+    int32_t i = 0;
+
+    if (base64url_ssse3())
+    {
+        i = base64url_decode_ssse3(source, length, result);
+        if (i < 0) return -1;
+    }
+
+    byte* target = result + ((i / 4) * 3);
+
+    for (; i < length; i += 4)
+    {
+        int32_t count = (length - i < 4) ? length - i : 4;
+        uint32_t x = 0;
+
+        for (int32_t j = 0; j < 4; j++)
+        {
+            int32_t value = 0;
+
+            if (j < count)
+            {
+                value = base64url_value(source[i + j]);
+                if (value < 0) return -1;
+            }
+
+            x = (x << 6) | (uint32_t)value;
+        }
+
+        *target++ = (byte)(x >> 16);
+        if (count > 2) *target++ = (byte)(x >> 8);
+        if (count > 3) *target++ = (byte)x;
+    }
+
+    return (int32_t)(target - result);
+}
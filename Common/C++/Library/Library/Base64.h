@@ -0,0 +1,4 @@
+#pragma once
+
+int32_t base64url_encode(byte* source, int32_t length, wchar_t* result);
+int32_t base64url_decode(wchar_t* source, int32_t length, byte* result);
@@ -0,0 +1,178 @@
+#include "stdafx.h"
+#include "BloomFilter.h"
+
+#include <intrin.h>
+#include "immintrin.h" //AVX2
+
+// Split block Bloom filter over 32 byte keys. The filter is an array of 32 byte blocks; a key selects
+// one block and sets one bit in each of its eight 32 bit words, so a query touches a single cache line.
+// Keys are SHA-256 hashes, so the positions are taken from the key itself instead of hashing it again:
+// the first word picks the block, and the top five bits of each word multiplied by an odd constant pick
+// the bit in that word. The layout is part of the serialized format and must not change.
+static const uint32_t bloom_filter_salts[8] =
+{
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+static const int32_t bloom_filter_key_length = 32;
+static const int32_t bloom_filter_block_length = 32;
+
+static inline uint32_t bloom_filter_load32(const byte* p)
+{
+    uint32_t x;
+    memcpy(&x, p, 4);
+
+    return x;
+}
+
+static inline uint32_t* bloom_filter_block(byte* blocks, int32_t blockCount, const byte* key)
+{
+    uint32_t index = (uint32_t)(((uint64_t)bloom_filter_load32(key) * (uint32_t)blockCount) >> 32);
+
+    return (uint32_t*)(blocks + ((size_t)index * bloom_filter_block_length));
+}
+
+static bool bloom_filter_avx2_detect()
+{
+    int32_t info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 5)) == 0) return false;
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+
+    // The OS must save the YMM registers.
+    return (_xgetbv(0) & 0x6) == 0x6;
+}
+
+static bool bloom_filter_avx2()
+{
+    static const bool avx2 = bloom_filter_avx2_detect();
+
+    return avx2;
+}
+
+static inline __m256i bloom_filter_mask_avx2(const byte* key, __m256i salts)
+{
+    __m256i x = _mm256_loadu_si256((const __m256i*)key);
+    x = _mm256_srli_epi32(_mm256_mullo_epi32(x, salts), 27);
+
+    return _mm256_sllv_epi32(_mm256_set1_epi32(1), x);
+}
+
+// The block of the key a few iterations ahead is prefetched; large filters miss the cache on almost
+// every key, and the loads of consecutive keys do not depend on each other.
+static const int32_t bloom_filter_prefetch_distance = 8;
+
+static void bloom_filter_insert_avx2(byte* blocks, int32_t blockCount, const byte* keys, int32_t count)
+{
+    const __m256i salts = _mm256_loadu_si256((const __m256i*)bloom_filter_salts);
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        if (i + bloom_filter_prefetch_distance < count)
+        {
+            _mm_prefetch((const char*)bloom_filter_block(blocks, blockCount, keys + ((size_t)(i + bloom_filter_prefetch_distance) * bloom_filter_key_length)), _MM_HINT_T0);
+        }
+
+        const byte* key = keys + ((size_t)i * bloom_filter_key_length);
+        __m256i* block = (__m256i*)bloom_filter_block(blocks, blockCount, key);
+
+        _mm256_storeu_si256(block, _mm256_or_si256(_mm256_loadu_si256(block), bloom_filter_mask_avx2(key, salts)));
+    }
+}
+
+static int32_t bloom_filter_query_avx2(byte* blocks, int32_t blockCount, const byte* keys, int32_t count, byte* result)
+{
+    const __m256i salts = _mm256_loadu_si256((const __m256i*)bloom_filter_salts);
+
+    int32_t hits = 0;
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        if (i + bloom_filter_prefetch_distance < count)
+        {
+            _mm_prefetch((const char*)bloom_filter_block(blocks, blockCount, keys + ((size_t)(i + bloom_filter_prefetch_distance) * bloom_filter_key_length)), _MM_HINT_T0);
+        }
+
+        const byte* key = keys + ((size_t)i * bloom_filter_key_length);
+        const __m256i* block = (const __m256i*)bloom_filter_block(blocks, blockCount, key);
+
+        // testc is 1 when every bit of the mask is set in the block.
+        int32_t hit = _mm256_testc_si256(_mm256_loadu_si256(block), bloom_filter_mask_avx2(key, salts));
+
+        result[i] = (byte)hit;
+        hits += hit;
+    }
+
+    return hits;
+}
+
+void bloom_filter_insert(byte* blocks, int32_t blockCount, byte* keys, int32_t count)
+{
+    if (blockCount <= 0) return;
+
+    if (bloom_filter_avx2())
+    {
+        bloom_filter_insert_avx2(blocks, blockCount, keys, count);
+
+        return;
+    }
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        const byte* key = keys + ((size_t)i * bloom_filter_key_length);
+        uint32_t* block = bloom_filter_block(blocks, blockCount, key);
+
+        for (int32_t j = 0; j < 8; j++)
+        {
+            block[j] |= 1U << ((bloom_filter_load32(key + (j * 4)) * bloom_filter_salts[j]) >> 27);
+        }
+    }
+}
+
+int32_t bloom_filter_query(byte* blocks, int32_t blockCount, byte* keys, int32_t count, byte* result)
+{
+    if (blockCount <= 0)
+    {
+        memset(result, 0, count);
+
+        return 0;
+    }
+
+    if (bloom_filter_avx2()) return bloom_filter_query_avx2(blocks, blockCount, keys, count, result);
+
+    int32_t hits = 0;
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        const byte* key = keys + ((size_t)i * bloom_filter_key_length);
+        const uint32_t* block = bloom_filter_block(blocks, blockCount, key);
+
+        byte hit = 1;
+
+        for (int32_t j = 0; j < 8; j++)
+        {
+            uint32_t bit = 1U << ((bloom_filter_load32(key + (j * 4)) * bloom_filter_salts[j]) >> 27);
+
+            if ((block[j] & bit) == 0)
+            {
+                hit = 0;
+
+                break;
+            }
+        }
+
+        result[i] = hit;
+        hits += hit;
+    }
+
+    return hits;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+void bloom_filter_insert(byte* blocks, int32_t blockCount, byte* keys, int32_t count);
+int32_t bloom_filter_query(byte* blocks, int32_t blockCount, byte* keys, int32_t count, byte* result);
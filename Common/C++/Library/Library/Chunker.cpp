@@ -0,0 +1,236 @@
+#include "stdafx.h"
+#include "Chunker.h"
+
+#include <vector>
+
+// Content defined chunking with a Gear hash, FastCDC style: no cut before minLength, a strict mask up to
+// averageLength, a loose mask after it and a forced cut at maxLength.
+//
+// The hash is never reset at a cut. Every step shifts it left by one, so after 64 bytes the older bytes
+// are gone and the hash at a position depends only on the 64 bytes ending there. That keeps cut points
+// independent of where the stream was split into feeds, and lets a buffer be hashed as independent lanes
+// that each start 64 bytes early.
+//
+// The gear table and the masks decide where data is cut, and with that the keys of every chunk. Changing
+// either changes every key produced so far.
+
+const int32_t windowLength = 64;
+
+// Below this a feed is hashed in a single lane.
+const int32_t laneMinimumLength = 4 * 1024;
+
+struct Chunker
+{
+    uint64_t gear[256];
+    uint64_t strictMask;
+    uint64_t looseMask;
+
+    int32_t minLength;
+    int32_t averageLength;
+    int32_t maxLength;
+
+    uint64_t hash;
+    int32_t length;
+};
+
+// splitmix64, from a fixed seed.
+static void chunker_gear(uint64_t* gear)
+{
+    uint64_t x = 0x4368756e6b657221ULL;
+
+    for (int32_t i = 0; i < 256; i++)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+
+        uint64_t z = x;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+        gear[i] = z ^ (z >> 31);
+    }
+}
+
+// The top bits of the hash cover the longest part of the window, so the masks test those.
+static inline uint64_t chunker_mask(int32_t bits)
+{
+    return ~0ULL << (64 - bits);
+}
+
+// A hit is a position whose hash passes the loose mask, stored as position * 2, plus 1 when it also passes
+// the strict mask. The strict mask has more bits than the loose one, so every strict hit is a loose hit.
+static inline void chunker_hit(const Chunker* chunker, uint64_t hash, int32_t position, std::vector<int32_t>& hits)
+{
+    if ((hash & chunker->looseMask) != 0) return;
+
+    hits.push_back((position * 2) + (((hash & chunker->strictMask) == 0) ? 1 : 0));
+}
+
+static uint64_t chunker_warm_up(const Chunker* chunker, const byte* data, int32_t position)
+{
+    uint64_t hash = 0;
+
+    for (int32_t i = position - windowLength; i < position; i++)
+    {
+        hash = (hash << 1) + chunker->gear[data[i]];
+    }
+
+    return hash;
+}
+
+static uint64_t chunker_scan(const Chunker* chunker, uint64_t hash, const byte* data, int32_t begin, int32_t end, std::vector<int32_t>& hits)
+{
+    for (int32_t i = begin; i < end; i++)
+    {
+        hash = (hash << 1) + chunker->gear[data[i]];
+        chunker_hit(chunker, hash, i, hits);
+    }
+
+    return hash;
+}
+
+// Four lanes side by side, so the four dependency chains overlap. Each step needs a table lookup per lane,
+// and gathering those into vectors measured slower than this.
+static uint64_t chunker_scan4(const Chunker* chunker, uint64_t hash, const byte* data, int32_t segment, std::vector<int32_t>* hits)
+{
+    const uint64_t* gear = chunker->gear;
+
+    uint64_t h0 = hash;
+    uint64_t h1 = chunker_warm_up(chunker, data, segment * 1);
+    uint64_t h2 = chunker_warm_up(chunker, data, segment * 2);
+    uint64_t h3 = chunker_warm_up(chunker, data, segment * 3);
+
+    const byte* d0 = data;
+    const byte* d1 = data + (segment * 1);
+    const byte* d2 = data + (segment * 2);
+    const byte* d3 = data + (segment * 3);
+
+    for (int32_t i = 0; i < segment; i++)
+    {
+        h0 = (h0 << 1) + gear[d0[i]];
+        h1 = (h1 << 1) + gear[d1[i]];
+        h2 = (h2 << 1) + gear[d2[i]];
+        h3 = (h3 << 1) + gear[d3[i]];
+
+        if ((h0 & chunker->looseMask) != 0 && (h1 & chunker->looseMask) != 0
+            && (h2 & chunker->looseMask) != 0 && (h3 & chunker->looseMask) != 0) continue;
+
+        chunker_hit(chunker, h0, i, hits[0]);
+        chunker_hit(chunker, h1, (segment * 1) + i, hits[1]);
+        chunker_hit(chunker, h2, (segment * 2) + i, hits[2]);
+        chunker_hit(chunker, h3, (segment * 3) + i, hits[3]);
+    }
+
+    return h3;
+}
+
+Chunker* chunker_create(int32_t minLength, int32_t averageLength, int32_t maxLength)
+{
+    if (minLength <= 0 || averageLength < minLength || maxLength < averageLength || maxLength > (1 << 29)) return NULL;
+
+    // The masks have log2(averageLength) bits, two more below the average and two fewer above it.
+    int32_t bits = 0;
+    while ((2 << bits) <= averageLength) bits++;
+
+    if (bits < 4) return NULL;
+
+    Chunker* chunker = new Chunker();
+    chunker_gear(chunker->gear);
+
+    chunker->strictMask = chunker_mask(bits + 2);
+    chunker->looseMask = chunker_mask(bits - 2);
+    chunker->minLength = minLength;
+    chunker->averageLength = averageLength;
+    chunker->maxLength = maxLength;
+
+    chunker_reset(chunker);
+
+    return chunker;
+}
+
+void chunker_delete(Chunker* chunker)
+{
+    delete chunker;
+}
+
+// Starts a new stream.
+void chunker_reset(Chunker* chunker)
+{
+    chunker->hash = 0;
+    chunker->length = 0;
+}
+
+// Feeds the next length bytes of the stream and writes the cut points that fall in them, as offsets into
+// buffer just past the last byte of each chunk. Bytes after the last cut belong to the next chunk; at the
+// end of the stream they are the last chunk. Returns the number of cuts, or -1 when cutsLength is less
+// than length / minLength + 1.
+int32_t chunker_feed(Chunker* chunker, byte* buffer, int32_t length, int32_t* cuts, int32_t cutsLength)
+{
+    if (length < 0 || cutsLength < (length / chunker->minLength) + 1) return -1;
+    if (length == 0) return 0;
+
+    int32_t lanes = (length >= laneMinimumLength) ? 4 : 1;
+    int32_t segment = length / lanes;
+
+    std::vector<int32_t> laneHits[4];
+    uint64_t hash;
+
+    if (lanes == 4) hash = chunker_scan4(chunker, chunker->hash, buffer, segment, laneHits);
+    else hash = chunker_scan(chunker, chunker->hash, buffer, 0, segment, laneHits[0]);
+
+    // The lanes cover whole segments; the rest continues from the last lane.
+    hash = chunker_scan(chunker, hash, buffer, segment * lanes, length, laneHits[lanes - 1]);
+
+    chunker->hash = hash;
+
+    std::vector<int32_t>& hits = laneHits[0];
+
+    for (int32_t lane = 1; lane < lanes; lane++)
+    {
+        hits.insert(hits.end(), laneHits[lane].begin(), laneHits[lane].end());
+    }
+
+    // The first hit that is long enough for its mask, or maxLength when there is none before it.
+    int32_t count = 0;
+    int32_t position = 0;
+    int32_t chunkLength = chunker->length;
+    size_t index = 0;
+
+    for (;;)
+    {
+        int64_t limit = (int64_t)position + (chunker->maxLength - chunkLength);
+        int32_t cut = -1;
+
+        for (; index < hits.size(); index++)
+        {
+            int32_t end = (hits[index] >> 1) + 1;
+
+            if (end <= position) continue;
+            if (end > limit) break;
+
+            int32_t l = chunkLength + (end - position);
+
+            if (l < chunker->minLength) continue;
+            if (l < chunker->averageLength && (hits[index] & 1) == 0) continue;
+
+            cut = end;
+            index++;
+
+            break;
+        }
+
+        if (cut < 0)
+        {
+            if (limit > length) break;
+
+            cut = (int32_t)limit;
+        }
+
+        cuts[count++] = cut;
+        position = cut;
+        chunkLength = 0;
+    }
+
+    chunker->length = chunkLength + (length - position);
+
+    return count;
+}
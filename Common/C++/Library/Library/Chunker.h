@@ -0,0 +1,8 @@
+#pragma once
+
+struct Chunker;
+
+Chunker* chunker_create(int32_t minLength, int32_t averageLength, int32_t maxLength);
+void chunker_delete(Chunker* chunker);
+void chunker_reset(Chunker* chunker);
+int32_t chunker_feed(Chunker* chunker, byte* buffer, int32_t length, int32_t* cuts, int32_t cutsLength);
@@ -0,0 +1,519 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+#include "TaskRuntime.h"
+
+#include <thread>
+
+// The file is mapped in fixed windows, so a range that does not straddle a window boundary is always
+// contiguous in memory. Windows are a multiple of the 256KB cache sector, which never crosses one.
+#if _WIN64 || __amd64__
+const int64_t windowSize = 64 * 1024 * 1024;
+const int32_t maxViews = 32;
+#else
+const int64_t windowSize = 16 * 1024 * 1024;
+const int32_t maxViews = 8;
+#endif
+
+// Sequential hints prefetch at most this far ahead of the requested range.
+const int64_t readAheadSize = 4 * 1024 * 1024;
+
+enum MappedFile_Advice
+{
+    MappedFile_Advice_Normal = 0,
+    MappedFile_Advice_Sequential = 1,
+    MappedFile_Advice_Random = 2,
+    MappedFile_Advice_WillNeed = 3,
+};
+
+struct MappedFile_View
+{
+    int64_t offset;
+    byte* address;
+    // The last window of the file is shorter than windowSize.
+    int64_t size;
+    int32_t pins;
+    uint64_t used;
+};
+
+struct MappedFile
+{
+    HANDLE file;
+    HANDLE mapping;
+    int64_t length;
+    uint64_t clock;
+    // Set while set_length waits for the pins to drain; no new pins are taken meanwhile.
+    int32_t resizing;
+    CRITICAL_SECTION lock;
+    MappedFile_View views[maxViews];
+};
+
+// PrefetchVirtualMemory exists from Windows 8 on; the DLL still has to load on XP.
+struct MappedFile_MemoryRange
+{
+    void* address;
+    size_t size;
+};
+
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFunction)(HANDLE process, size_t count, MappedFile_MemoryRange* ranges, ULONG flags);
+
+static PrefetchVirtualMemoryFunction mapped_file_prefetch_function()
+{
+    static PrefetchVirtualMemoryFunction function = (PrefetchVirtualMemoryFunction)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory");
+    return function;
+}
+
+// A page that can not be read in raises EXCEPTION_IN_PAGE_ERROR instead of failing a ReadFile call.
+static bool mapped_file_copy(byte* destination, const byte* source, size_t length)
+{
+#ifdef _MSC_VER
+    __try
+    {
+        memcpy(destination, source, length);
+    }
+    __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        return false;
+    }
+#else
+    memcpy(destination, source, length);
+#endif
+
+    return true;
+}
+
+static void mapped_file_unmap_all(MappedFile* f)
+{
+    for (int32_t i = 0; i < maxViews; i++)
+    {
+        if (f->views[i].address == NULL) continue;
+
+        UnmapViewOfFile(f->views[i].address);
+        f->views[i].address = NULL;
+        f->views[i].pins = 0;
+    }
+}
+
+static bool mapped_file_create_mapping(MappedFile* f)
+{
+    f->mapping = NULL;
+
+    // An empty file can not be mapped. It gets a mapping on the first set_length.
+    if (f->length == 0) return true;
+
+    f->mapping = CreateFileMappingW(f->file, NULL, PAGE_READWRITE, (DWORD)(f->length >> 32), (DWORD)f->length, NULL);
+    return f->mapping != NULL;
+}
+
+// Returns the view holding the window that starts at offset, mapping it over the least recently used
+// unpinned view when needed. Called with the lock held.
+static MappedFile_View* mapped_file_view(MappedFile* f, int64_t offset)
+{
+    MappedFile_View* victim = NULL;
+
+    for (int32_t i = 0; i < maxViews; i++)
+    {
+        MappedFile_View* view = &f->views[i];
+
+        if (view->address != NULL && view->offset == offset) return view;
+        if (view->pins != 0) continue;
+
+        if (victim == NULL
+            || (victim->address != NULL && (view->address == NULL || view->used < victim->used)))
+        {
+            victim = view;
+        }
+    }
+
+    if (victim == NULL || f->mapping == NULL) return NULL;
+
+    if (victim->address != NULL)
+    {
+        UnmapViewOfFile(victim->address);
+        victim->address = NULL;
+    }
+
+    int64_t size = f->length - offset;
+    if (size > windowSize) size = windowSize;
+
+    victim->address = (byte*)MapViewOfFile(f->mapping, FILE_MAP_READ | FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, (size_t)size);
+    if (victim->address == NULL) return NULL;
+
+    victim->offset = offset;
+    victim->size = size;
+    victim->pins = 0;
+
+    return victim;
+}
+
+static bool mapped_file_pinned(MappedFile* f)
+{
+    for (int32_t i = 0; i < maxViews; i++)
+    {
+        if (f->views[i].pins != 0) return true;
+    }
+
+    return false;
+}
+
+static bool mapped_file_all_pinned(MappedFile* f)
+{
+    for (int32_t i = 0; i < maxViews; i++)
+    {
+        if (f->views[i].pins == 0) return false;
+    }
+
+    return true;
+}
+
+// Pins the window holding [position, position + length) and stores a pointer to position.
+// Returns -1 when the range is outside the file or crosses a window boundary, and -2 when the window
+// could not be mapped (MapViewOfFile failed, e.g. out of address space). While every view is pinned or
+// a resize is pending it waits; pins are only held for one copy, so the wait is short.
+static int32_t mapped_file_pin(MappedFile* f, int64_t position, int32_t length, byte** pointer)
+{
+    int64_t offset = position - (position % windowSize);
+
+    if (position < 0 || length < 0 || position + length > offset + windowSize) return -1;
+
+    int32_t result;
+
+    EnterCriticalSection(&f->lock);
+
+    for (;;)
+    {
+        if (f->resizing == 0)
+        {
+            if (position + length > f->length)
+            {
+                result = -1;
+                break;
+            }
+
+            MappedFile_View* view = mapped_file_view(f, offset);
+
+            if (view != NULL)
+            {
+                view->pins++;
+                view->used = ++f->clock;
+
+                *pointer = view->address + (position - offset);
+                result = 0;
+                break;
+            }
+
+            if (!mapped_file_all_pinned(f))
+            {
+                result = -2;
+                break;
+            }
+        }
+
+        LeaveCriticalSection(&f->lock);
+        Sleep(1);
+        EnterCriticalSection(&f->lock);
+    }
+
+    LeaveCriticalSection(&f->lock);
+
+    return result;
+}
+
+void* mapped_file_open(wchar_t* path)
+{
+    HANDLE file = CreateFileW(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    MappedFile* f = (MappedFile*)calloc(1, sizeof(MappedFile));
+
+    if (f == NULL)
+    {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    f->file = file;
+    f->length = size.QuadPart;
+
+    if (!mapped_file_create_mapping(f))
+    {
+        CloseHandle(file);
+        free(f);
+        return NULL;
+    }
+
+    InitializeCriticalSection(&f->lock);
+
+    return f;
+}
+
+void mapped_file_close(void* file)
+{
+    MappedFile* f = (MappedFile*)file;
+
+    mapped_file_unmap_all(f);
+
+    if (f->mapping != NULL) CloseHandle(f->mapping);
+    CloseHandle(f->file);
+
+    DeleteCriticalSection(&f->lock);
+    free(f);
+}
+
+int64_t mapped_file_get_length(void* file)
+{
+    MappedFile* f = (MappedFile*)file;
+
+    EnterCriticalSection(&f->lock);
+    int64_t length = f->length;
+    LeaveCriticalSection(&f->lock);
+
+    return length;
+}
+
+// Every view is unmapped, so this waits until every acquired range is released.
+int32_t mapped_file_set_length(void* file, int64_t length)
+{
+    MappedFile* f = (MappedFile*)file;
+    int32_t result = -1;
+
+    EnterCriticalSection(&f->lock);
+
+    f->resizing++;
+
+    while (mapped_file_pinned(f))
+    {
+        LeaveCriticalSection(&f->lock);
+        Sleep(1);
+        EnterCriticalSection(&f->lock);
+    }
+
+    mapped_file_unmap_all(f);
+
+    if (f->mapping != NULL)
+    {
+        CloseHandle(f->mapping);
+        f->mapping = NULL;
+    }
+
+    {
+        LARGE_INTEGER position;
+        position.QuadPart = length;
+
+        if (SetFilePointerEx(f->file, position, NULL, FILE_BEGIN) && SetEndOfFile(f->file))
+        {
+            f->length = length;
+            result = 0;
+        }
+    }
+
+    // On failure the old length is mapped again so the file stays usable.
+    if (!mapped_file_create_mapping(f)) result = -1;
+
+    f->resizing--;
+
+    LeaveCriticalSection(&f->lock);
+
+    return result;
+}
+
+// Pins the window holding [position, position + length) and returns a pointer to position, or NULL when
+// the range is empty, outside the file, crosses a window boundary or could not be mapped.
+// Every pointer must be released.
+byte* mapped_file_acquire(void* file, int64_t position, int32_t length)
+{
+    if (length <= 0) return NULL;
+
+    byte* pointer = NULL;
+    if (mapped_file_pin((MappedFile*)file, position, length, &pointer) != 0) return NULL;
+
+    return pointer;
+}
+
+void mapped_file_release(void* file, byte* pointer)
+{
+    MappedFile* f = (MappedFile*)file;
+
+    EnterCriticalSection(&f->lock);
+
+    for (int32_t i = 0; i < maxViews; i++)
+    {
+        MappedFile_View* view = &f->views[i];
+
+        if (view->address != NULL && view->address <= pointer && pointer < view->address + view->size)
+        {
+            view->pins--;
+            break;
+        }
+    }
+
+    LeaveCriticalSection(&f->lock);
+}
+
+static int32_t mapped_file_transfer(MappedFile* f, int64_t position, byte* buffer, int32_t length, bool write)
+{
+    while (length > 0)
+    {
+        int64_t remain = windowSize - (position % windowSize);
+        int32_t size = (remain < length) ? (int32_t)remain : length;
+
+        byte* pointer = NULL;
+
+        int32_t result = mapped_file_pin(f, position, size, &pointer);
+        if (result != 0) return result;
+
+        bool succeeded = write ? mapped_file_copy(pointer, buffer, size) : mapped_file_copy(buffer, pointer, size);
+
+        mapped_file_release(f, pointer);
+
+        if (!succeeded) return -1;
+
+        position += size;
+        buffer += size;
+        length -= size;
+    }
+
+    return 0;
+}
+
+// The range has to lie inside the file; growing is left to set_length.
+// Returns 0, -1 when the range can not be read or written, or -2 when no view could be mapped for it.
+int32_t mapped_file_read(void* file, int64_t position, byte* buffer, int32_t length)
+{
+    return mapped_file_transfer((MappedFile*)file, position, buffer, length, false);
+}
+
+int32_t mapped_file_write(void* file, int64_t position, byte* buffer, int32_t length)
+{
+    return mapped_file_transfer((MappedFile*)file, position, buffer, length, true);
+}
+
+struct MappedFile_Batch
+{
+    MappedFile* file;
+    int64_t* positions;
+    byte** buffers;
+    int32_t* lengths;
+    int32_t* results;
+};
+
+static void mapped_file_read_batch_one(void* context, int32_t index)
+{
+    MappedFile_Batch* batch = (MappedFile_Batch*)context;
+
+    batch->results[index] = mapped_file_transfer(batch->file, batch->positions[index], batch->buffers[index], batch->lengths[index], false);
+}
+
+// Reads scattered ranges with several threads, each taking the next pending request, so as many page-ins
+// as threads are outstanding at once instead of one. results[i] receives the result of mapped_file_read.
+// The threads come from the bulk lane of the task runtime, so a batch never goes over the shared budget.
+void mapped_file_read_batch(void* file, int32_t count, int64_t* positions, byte** buffers, int32_t* lengths, int32_t* results, int32_t threads)
+{
+    if (count <= 0) return;
+
+    MappedFile_Batch batch;
+    batch.file = (MappedFile*)file;
+    batch.positions = positions;
+    batch.buffers = buffers;
+    batch.lengths = lengths;
+    batch.results = results;
+
+    if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+    if (threads > count) threads = count;
+
+    // Each worker pins one window at a time; half of the views stay free for everyone else.
+    if (threads > maxViews / 2) threads = maxViews / 2;
+
+    if (threads <= 1)
+    {
+        for (int32_t i = 0; i < count; i++)
+        {
+            mapped_file_read_batch_one(&batch, i);
+        }
+
+        return;
+    }
+
+    task_parallel_for(TaskLane_Bulk, count, threads, NULL, mapped_file_read_batch_one, &batch);
+}
+
+// Windows has no per-range madvise. WillNeed prefetches the range and Sequential prefetches the range plus
+// a read-ahead tail, both through PrefetchVirtualMemory when it exists. Random and Normal leave the
+// default demand paging alone. Hints never fail.
+void mapped_file_advise(void* file, int64_t position, int64_t length, int32_t advice)
+{
+    MappedFile* f = (MappedFile*)file;
+
+    if (advice != MappedFile_Advice_Sequential && advice != MappedFile_Advice_WillNeed) return;
+
+    PrefetchVirtualMemoryFunction prefetch = mapped_file_prefetch_function();
+    if (prefetch == NULL || position < 0 || length <= 0) return;
+
+    if (advice == MappedFile_Advice_Sequential) length += readAheadSize;
+
+    EnterCriticalSection(&f->lock);
+
+    if (position + length > f->length) length = f->length - position;
+
+    MappedFile_MemoryRange ranges[maxViews];
+    MappedFile_View* views[maxViews];
+    size_t count = 0;
+
+    // The windows stay pinned until the prefetch is issued, so mapping a later one can not evict them.
+    while (length > 0 && count < maxViews)
+    {
+        int64_t offset = position - (position % windowSize);
+        int64_t remain = offset + windowSize - position;
+        int64_t size = (remain < length) ? remain : length;
+
+        MappedFile_View* view = mapped_file_view(f, offset);
+        if (view == NULL) break;
+
+        view->pins++;
+        view->used = ++f->clock;
+
+        views[count] = view;
+        ranges[count].address = view->address + (position - offset);
+        ranges[count].size = (size_t)size;
+        count++;
+
+        position += size;
+        length -= size;
+    }
+
+    if (count > 0) prefetch(GetCurrentProcess(), count, ranges, 0);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        views[i]->pins--;
+    }
+
+    LeaveCriticalSection(&f->lock);
+}
+
+// msync: writes the dirty pages of every mapped window back to the file.
+int32_t mapped_file_flush(void* file)
+{
+    MappedFile* f = (MappedFile*)file;
+    int32_t result = 0;
+
+    EnterCriticalSection(&f->lock);
+
+    for (int32_t i = 0; i < maxViews; i++)
+    {
+        if (f->views[i].address == NULL) continue;
+
+        if (!FlushViewOfFile(f->views[i].address, 0)) result = -1;
+    }
+
+    LeaveCriticalSection(&f->lock);
+
+    return result;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+void* mapped_file_open(wchar_t* path);
+void mapped_file_close(void* file);
+int64_t mapped_file_get_length(void* file);
+int32_t mapped_file_set_length(void* file, int64_t length);
+byte* mapped_file_acquire(void* file, int64_t position, int32_t length);
+void mapped_file_release(void* file, byte* pointer);
+int32_t mapped_file_read(void* file, int64_t position, byte* buffer, int32_t length);
+void mapped_file_read_batch(void* file, int32_t count, int64_t* positions, byte** buffers, int32_t* lengths, int32_t* results, int32_t threads);
+int32_t mapped_file_write(void* file, int64_t position, byte* buffer, int32_t length);
+void mapped_file_advise(void* file, int64_t position, int64_t length, int32_t advice);
+int32_t mapped_file_flush(void* file);
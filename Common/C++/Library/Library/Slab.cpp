@@ -0,0 +1,394 @@
+#include "stdafx.h"
+#include "Slab.h"
+
+#include <atomic>
+
+// The size classes are the powers of two from 256 bytes to 4MB, the same classes BufferManager pools.
+const int32_t minClassBits = 8;
+const int32_t maxClassBits = 22;
+const int32_t classCount = maxClassBits - minClassBits + 1;
+
+// Classes below chunkSize are carved out of shared 64KB chunks. A block is aligned to its own size, so
+// every block is at least 64 byte aligned. Chunks are kept for the life of the process.
+const int32_t chunkSize = 64 * 1024;
+
+// Larger classes are one VirtualAlloc per block, page aligned, and go back to the OS once more than this
+// many bytes of the class sit unused. Seven classes are this large, and an x86 process cannot spare 7 x 64MB.
+#ifdef _WIN64
+const int64_t cacheLimit = 64 * 1024 * 1024;
+#else
+const int64_t cacheLimit = 16 * 1024 * 1024;
+#endif
+
+// Only the chunked classes have per-thread caches. For larger blocks the lock is noise next to the work
+// done on the block.
+const int32_t threadCacheBlocks = 32;
+
+// Number of values per class returned by slab_get_statistics.
+const int32_t statisticsWidth = 5;
+
+struct Slab_Block
+{
+    Slab_Block* next;
+};
+
+struct Slab_Class
+{
+    CRITICAL_SECTION lock;
+    Slab_Block* free;
+    int32_t freeCount;
+
+    std::atomic<int64_t> inUse;
+    std::atomic<int64_t> reserved;
+    std::atomic<int64_t> takes;
+    std::atomic<int64_t> misses;
+
+    // takes as of the previous slab_trim.
+    int64_t trimTakes;
+};
+
+struct Slab_ThreadCache
+{
+    Slab_Block* free[classCount];
+    int32_t freeCount[classCount];
+};
+
+static Slab_Class slab_classes[classCount];
+static DWORD slab_tls = TLS_OUT_OF_INDEXES;
+
+static volatile bool slab_large_pages = false;
+static size_t slab_large_page_size = 0;
+
+// GetLargePageMinimum exists from Vista on; the DLL still has to load on XP.
+typedef SIZE_T (WINAPI *GetLargePageMinimumFunction)();
+
+static inline int32_t slab_class_index(int32_t size)
+{
+    int32_t index = 0;
+
+    while (index < classCount && (1 << (minClassBits + index)) < size) index++;
+
+    return (index < classCount) ? index : -1;
+}
+
+static inline int32_t slab_block_size(int32_t index)
+{
+    return 1 << (minClassBits + index);
+}
+
+// Large pages are only used when the block is a whole number of them. With the usual 2MB large page that is
+// the 2MB and 4MB classes; a 1MB block can not give back half a large page.
+static byte* slab_os_allocate(size_t size)
+{
+    if (slab_large_pages && size % slab_large_page_size == 0)
+    {
+        byte* block = (byte*)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (block != NULL) return block;
+    }
+
+    return (byte*)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static Slab_ThreadCache* slab_thread_cache()
+{
+    if (slab_tls == TLS_OUT_OF_INDEXES) return NULL;
+
+    Slab_ThreadCache* cache = (Slab_ThreadCache*)TlsGetValue(slab_tls);
+
+    if (cache == NULL)
+    {
+        cache = (Slab_ThreadCache*)calloc(1, sizeof(Slab_ThreadCache));
+        if (cache != NULL) TlsSetValue(slab_tls, cache);
+    }
+
+    return cache;
+}
+
+// Carves a new chunk into the free list of a chunked class. Called with the class lock held.
+static void slab_refill(Slab_Class* c, int32_t blockSize)
+{
+    byte* chunk = slab_os_allocate(chunkSize);
+    if (chunk == NULL) return;
+
+    c->reserved += chunkSize;
+    c->misses++;
+
+    for (int32_t offset = chunkSize - blockSize; offset >= 0; offset -= blockSize)
+    {
+        Slab_Block* block = (Slab_Block*)(chunk + offset);
+        block->next = c->free;
+        c->free = block;
+        c->freeCount++;
+    }
+}
+
+void slab_initialize()
+{
+    slab_tls = TlsAlloc();
+
+    for (int32_t i = 0; i < classCount; i++)
+    {
+        InitializeCriticalSection(&slab_classes[i].lock);
+    }
+}
+
+// Hands the blocks cached by the exiting thread back to the shared free lists.
+void slab_thread_detach()
+{
+    if (slab_tls == TLS_OUT_OF_INDEXES) return;
+
+    Slab_ThreadCache* cache = (Slab_ThreadCache*)TlsGetValue(slab_tls);
+    if (cache == NULL) return;
+
+    for (int32_t i = 0; i < classCount; i++)
+    {
+        if (cache->free[i] == NULL) continue;
+
+        Slab_Class* c = &slab_classes[i];
+
+        EnterCriticalSection(&c->lock);
+
+        while (cache->free[i] != NULL)
+        {
+            Slab_Block* block = cache->free[i];
+            cache->free[i] = block->next;
+
+            block->next = c->free;
+            c->free = block;
+            c->freeCount++;
+        }
+
+        LeaveCriticalSection(&c->lock);
+    }
+
+    free(cache);
+    TlsSetValue(slab_tls, NULL);
+}
+
+// Returns a block of at least size bytes, 64 byte aligned, or NULL when out of memory.
+// Sizes above the largest class get their own page aligned allocation.
+byte* slab_take(int32_t size)
+{
+    int32_t index = slab_class_index(size);
+    if (index < 0) return slab_os_allocate(size);
+
+    Slab_Class* c = &slab_classes[index];
+    int32_t blockSize = slab_block_size(index);
+
+    Slab_Block* block = NULL;
+
+    c->takes++;
+
+    if (blockSize < chunkSize)
+    {
+        Slab_ThreadCache* cache = slab_thread_cache();
+
+        if (cache != NULL)
+        {
+            // An empty cache takes half its capacity from the shared list under a single lock.
+            if (cache->free[index] == NULL)
+            {
+                EnterCriticalSection(&c->lock);
+
+                if (c->free == NULL) slab_refill(c, blockSize);
+
+                while (c->free != NULL && cache->freeCount[index] < threadCacheBlocks / 2)
+                {
+                    Slab_Block* t = c->free;
+                    c->free = t->next;
+                    c->freeCount--;
+
+                    t->next = cache->free[index];
+                    cache->free[index] = t;
+                    cache->freeCount[index]++;
+                }
+
+                LeaveCriticalSection(&c->lock);
+            }
+
+            block = cache->free[index];
+            if (block == NULL) return NULL;
+
+            cache->free[index] = block->next;
+            cache->freeCount[index]--;
+
+            c->inUse++;
+            return (byte*)block;
+        }
+    }
+
+    EnterCriticalSection(&c->lock);
+
+    if (c->free == NULL && blockSize < chunkSize) slab_refill(c, blockSize);
+
+    if (c->free != NULL)
+    {
+        block = c->free;
+        c->free = block->next;
+        c->freeCount--;
+    }
+
+    LeaveCriticalSection(&c->lock);
+
+    if (block == NULL && blockSize >= chunkSize)
+    {
+        block = (Slab_Block*)slab_os_allocate(blockSize);
+
+        if (block != NULL)
+        {
+            c->reserved += blockSize;
+            c->misses++;
+        }
+    }
+
+    if (block != NULL) c->inUse++;
+    return (byte*)block;
+}
+
+// size has to be the size the block was taken with.
+void slab_return(byte* block, int32_t size)
+{
+    if (block == NULL) return;
+
+    int32_t index = slab_class_index(size);
+
+    if (index < 0)
+    {
+        VirtualFree(block, 0, MEM_RELEASE);
+        return;
+    }
+
+    Slab_Class* c = &slab_classes[index];
+    int32_t blockSize = slab_block_size(index);
+
+    Slab_Block* b = (Slab_Block*)block;
+
+    c->inUse--;
+
+    if (blockSize < chunkSize)
+    {
+        Slab_ThreadCache* cache = slab_thread_cache();
+
+        if (cache != NULL && cache->freeCount[index] < threadCacheBlocks)
+        {
+            b->next = cache->free[index];
+            cache->free[index] = b;
+            cache->freeCount[index]++;
+
+            return;
+        }
+
+        EnterCriticalSection(&c->lock);
+
+        b->next = c->free;
+        c->free = b;
+        c->freeCount++;
+
+        LeaveCriticalSection(&c->lock);
+
+        return;
+    }
+
+    bool release = false;
+
+    EnterCriticalSection(&c->lock);
+
+    if ((int64_t)(c->freeCount + 1) * blockSize <= cacheLimit)
+    {
+        b->next = c->free;
+        c->free = b;
+        c->freeCount++;
+    }
+    else
+    {
+        release = true;
+    }
+
+    LeaveCriticalSection(&c->lock);
+
+    if (release)
+    {
+        VirtualFree(block, 0, MEM_RELEASE);
+        c->reserved -= blockSize;
+    }
+}
+
+// Large pages need SeLockMemoryPrivilege. Returns 1 when they are in use after the call.
+int32_t slab_set_large_pages(int32_t enabled)
+{
+    if (!enabled)
+    {
+        slab_large_pages = false;
+        return 0;
+    }
+
+    GetLargePageMinimumFunction getLargePageMinimum = (GetLargePageMinimumFunction)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "GetLargePageMinimum");
+    if (getLargePageMinimum == NULL) return 0;
+
+    size_t size = getLargePageMinimum();
+    if (size == 0) return 0;
+
+    void* probe = VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+    if (probe == NULL) return 0;
+
+    VirtualFree(probe, 0, MEM_RELEASE);
+
+    slab_large_page_size = size;
+    slab_large_pages = true;
+
+    return 1;
+}
+
+// Gives the unused blocks of the page allocated classes back to the OS, but only for classes nothing took
+// from since the previous call, so a class in steady use keeps its cache. Chunks of the small classes stay.
+void slab_trim()
+{
+    for (int32_t i = 0; i < classCount; i++)
+    {
+        int32_t blockSize = slab_block_size(i);
+        if (blockSize < chunkSize) continue;
+
+        Slab_Class* c = &slab_classes[i];
+
+        int64_t takes = c->takes;
+
+        if (takes != c->trimTakes)
+        {
+            c->trimTakes = takes;
+            continue;
+        }
+
+        EnterCriticalSection(&c->lock);
+
+        while (c->free != NULL)
+        {
+            Slab_Block* block = c->free;
+            c->free = block->next;
+            c->freeCount--;
+
+            VirtualFree(block, 0, MEM_RELEASE);
+            c->reserved -= blockSize;
+        }
+
+        LeaveCriticalSection(&c->lock);
+    }
+}
+
+// Writes block size, blocks in use, bytes reserved from the OS, takes and OS allocations for each class,
+// up to count values, and returns the number of classes.
+int32_t slab_get_statistics(int64_t* values, int32_t count)
+{
+    for (int32_t i = 0; i < classCount && (i + 1) * statisticsWidth <= count; i++)
+    {
+        Slab_Class* c = &slab_classes[i];
+        int64_t* v = values + (i * statisticsWidth);
+
+        v[0] = slab_block_size(i);
+        v[1] = c->inUse;
+        v[2] = c->reserved;
+        v[3] = c->takes;
+        v[4] = c->misses;
+    }
+
+    return classCount;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+void slab_initialize();
+void slab_thread_detach();
+
+byte* slab_take(int32_t size);
+void slab_return(byte* block, int32_t size);
+int32_t slab_set_large_pages(int32_t enabled);
+void slab_trim();
+int32_t slab_get_statistics(int64_t* values, int32_t count);
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include "Stats.h"
+
+#include <sstream>
+#include <string>
+
+const int32_t statsKernels = 16;
+
+static const char* const statsTierNames[StatsTier_Count] = { "scalar", "sse2", "avx2", "sha" };
+
+// The counters of one thread, written only by that thread and summed up by native_get_stats.
+// A thread that exits leaves its block, counts included, to the next new thread, so there are never
+// more blocks than threads alive at the same time.
+struct Stats_Thread
+{
+    Stats_Thread* next;
+    volatile LONG owned;
+    Stats_Counters kernels[statsKernels];
+};
+
+volatile bool stats_enabled = false;
+
+// stats_register claims a slot from stats_reserved, writes its name and only then counts it in stats_count,
+// so native_get_stats never reads a name that is not written yet.
+static const char* stats_names[statsKernels];
+static volatile LONG stats_reserved = 0;
+static volatile LONG stats_count = 0;
+
+static Stats_Thread* volatile stats_threads = NULL;
+static DWORD stats_tls = TLS_OUT_OF_INDEXES;
+
+void stats_initialize()
+{
+    stats_tls = TlsAlloc();
+}
+
+void stats_thread_detach()
+{
+    if (stats_tls == TLS_OUT_OF_INDEXES) return;
+
+    Stats_Thread* thread = (Stats_Thread*)TlsGetValue(stats_tls);
+    if (thread == NULL) return;
+
+    TlsSetValue(stats_tls, NULL);
+    InterlockedExchange(&thread->owned, 0);
+}
+
+int32_t stats_register(const char* name)
+{
+    LONG index = InterlockedIncrement(&stats_reserved) - 1;
+    if (index >= statsKernels) return -1;
+
+    stats_names[index] = name;
+
+    // Slots are published in order. Kernels register from static initializers, so the wait is at most
+    // for another registration that has already claimed the slot before this one.
+    while (InterlockedCompareExchange(&stats_count, index + 1, index) != index)
+    {
+        YieldProcessor();
+    }
+
+    return index;
+}
+
+static Stats_Thread* stats_thread()
+{
+    if (stats_tls == TLS_OUT_OF_INDEXES) return NULL;
+
+    Stats_Thread* thread = (Stats_Thread*)TlsGetValue(stats_tls);
+    if (thread != NULL) return thread;
+
+    for (thread = stats_threads; thread != NULL; thread = thread->next)
+    {
+        if (thread->owned == 0 && InterlockedCompareExchange(&thread->owned, 1, 0) == 0) break;
+    }
+
+    if (thread == NULL)
+    {
+        thread = (Stats_Thread*)calloc(1, sizeof(Stats_Thread));
+        if (thread == NULL) return NULL;
+
+        thread->owned = 1;
+
+        // Blocks are only ever added, so readers can walk the list without a lock.
+        Stats_Thread* head;
+
+        do
+        {
+            head = stats_threads;
+            thread->next = head;
+        }
+        while (InterlockedCompareExchangePointer((PVOID volatile*)&stats_threads, thread, head) != head);
+    }
+
+    TlsSetValue(stats_tls, thread);
+
+    return thread;
+}
+
+Stats_Counters* stats_counters(int32_t kernel)
+{
+    if (kernel < 0) return NULL;
+
+    Stats_Thread* thread = stats_thread();
+    if (thread == NULL) return NULL;
+
+    return &thread->kernels[kernel];
+}
+
+int32_t native_get_stats(char* buffer, int32_t length)
+{
+    int32_t count = (stats_count < statsKernels) ? stats_count : statsKernels;
+
+    std::ostringstream json;
+    json << "{\"enabled\":" << (stats_enabled ? "true" : "false") << ",\"kernels\":[";
+
+    for (int32_t k = 0; k < count; k++)
+    {
+        Stats_Counters total;
+        memset(&total, 0, sizeof(total));
+
+        for (Stats_Thread* thread = stats_threads; thread != NULL; thread = thread->next)
+        {
+            const Stats_Counters& c = thread->kernels[k];
+
+            total.calls += c.calls;
+            total.bytes += c.bytes;
+            total.sampledBytes += c.sampledBytes;
+            total.sampledCycles += c.sampledCycles;
+
+            for (int32_t i = 0; i < StatsTier_Count; i++) total.tiers[i] += c.tiers[i];
+            for (int32_t i = 0; i < statsBuckets; i++) total.sizes[i] += c.sizes[i];
+        }
+
+        if (k != 0) json << ",";
+
+        json << "{\"name\":\"" << stats_names[k] << "\""
+            << ",\"calls\":" << total.calls
+            << ",\"bytes\":" << total.bytes
+            << ",\"sampledBytes\":" << total.sampledBytes
+            << ",\"sampledCycles\":" << total.sampledCycles
+            << ",\"cyclesPerByte\":" << ((total.sampledBytes != 0) ? ((double)total.sampledCycles / total.sampledBytes) : 0.0)
+            << ",\"tiers\":{";
+
+        for (int32_t i = 0; i < StatsTier_Count; i++)
+        {
+            if (i != 0) json << ",";
+            json << "\"" << statsTierNames[i] << "\":" << total.tiers[i];
+        }
+
+        json << "},\"sizes\":[";
+
+        for (int32_t i = 0; i < statsBuckets; i++)
+        {
+            if (i != 0) json << ",";
+            json << total.sizes[i];
+        }
+
+        json << "]}";
+    }
+
+    json << "]}";
+
+    std::string result = json.str();
+
+    if (buffer != NULL && (int64_t)result.size() < length)
+    {
+        memcpy(buffer, result.c_str(), result.size() + 1);
+    }
+
+    return (int32_t)result.size();
+}
+
+void native_set_stats(int32_t enabled)
+{
+    stats_enabled = (enabled != 0);
+}
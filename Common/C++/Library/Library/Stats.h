@@ -0,0 +1,87 @@
+#pragma once
+
+#include <intrin.h>
+
+// Which code path a kernel call took.
+enum StatsTier
+{
+    StatsTier_Scalar = 0,
+    StatsTier_Sse2 = 1,
+    StatsTier_Avx2 = 2,
+    StatsTier_Sha = 3,
+    StatsTier_Count = 4,
+};
+
+// Sizes are counted by bit length: bucket 0 is length 0, bucket n is [2^(n-1), 2^n).
+const int32_t statsBuckets = 32;
+
+// The cycles of one call in this many are measured.
+const uint32_t statsSampleMask = 63;
+
+struct Stats_Counters
+{
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t sampledBytes;
+    uint64_t sampledCycles;
+    uint64_t tiers[StatsTier_Count];
+    uint64_t sizes[statsBuckets];
+};
+
+extern volatile bool stats_enabled;
+
+void stats_initialize();
+void stats_thread_detach();
+
+// Gives a kernel its slot. Meant for a file scope constant, e.g. static const int32_t statsCopy = stats_register("copy");
+int32_t stats_register(const char* name);
+
+// The calling thread's counters of the kernel, or NULL.
+Stats_Counters* stats_counters(int32_t kernel);
+
+// Counts one call for as long as it is in scope. Costs a single branch while the statistics are off.
+// A kernel that calls another counted kernel is counted including it.
+class StatsScope
+{
+public:
+    StatsScope(int32_t kernel, StatsTier tier, int64_t bytes)
+    {
+        _counters = NULL;
+        _start = 0;
+
+        if (!stats_enabled) return;
+
+        _counters = stats_counters(kernel);
+        if (_counters == NULL) return;
+
+        _bytes = bytes;
+
+        uint32_t bucket = 0;
+        for (uint64_t n = (uint64_t)bytes; n != 0 && bucket < statsBuckets - 1; n >>= 1) bucket++;
+
+        _counters->calls++;
+        _counters->bytes += bytes;
+        _counters->tiers[tier]++;
+        _counters->sizes[bucket]++;
+
+        if ((_counters->calls & statsSampleMask) == 0) _start = __rdtsc();
+    }
+
+    ~StatsScope()
+    {
+        if (_start == 0) return;
+
+        _counters->sampledCycles += __rdtsc() - _start;
+        _counters->sampledBytes += _bytes;
+    }
+
+private:
+    Stats_Counters* _counters;
+    uint64_t _start;
+    int64_t _bytes;
+};
+
+// Writes the counters of every thread, merged, as a JSON object and returns its length.
+// Nothing is written when buffer has less than length + 1 bytes; call again with a larger one.
+int32_t native_get_stats(char* buffer, int32_t length);
+void native_set_stats(int32_t enabled);
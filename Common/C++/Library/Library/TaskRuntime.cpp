@@ -0,0 +1,201 @@
+#include "stdafx.h"
+#include "TaskRuntime.h"
+
+#include <thread>
+#include <vector>
+
+const int32_t laneCount = 3;
+
+// A parked thread runs again after this long even if the budget is still used up.
+const DWORD parkLimit = 200;
+
+// Every library of the process is its own DLL that compiles this file in,
+// so the counters live in a named mapping that all of them open.
+struct TaskShared
+{
+    volatile LONG budget;
+    volatile LONG active[laneCount];
+};
+
+static TaskShared* task_open()
+{
+    TaskShared* shared = NULL;
+
+    wchar_t name[64];
+    swprintf_s(name, L"Local\\Library_TaskRuntime_%u", GetCurrentProcessId());
+
+    // The mapping lives as long as the process, so the handle is never closed.
+    HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(TaskShared), name);
+
+    if (mapping != NULL)
+    {
+        shared = (TaskShared*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(TaskShared));
+    }
+
+    if (shared == NULL)
+    {
+        static TaskShared local;
+        shared = &local;
+    }
+
+    // A new mapping is zero filled. Whichever library comes first sets the budget.
+    if (shared->budget == 0)
+    {
+        LONG budget = (LONG)std::thread::hardware_concurrency();
+        if (budget <= 0) budget = 1;
+
+        InterlockedCompareExchange(&shared->budget, budget, 0);
+    }
+
+    return shared;
+}
+
+static TaskShared* task_shared()
+{
+    static TaskShared* const shared = task_open();
+
+    return shared;
+}
+
+static int32_t task_lane(int32_t lane)
+{
+    if (lane < TaskLane_Interactive) return TaskLane_Interactive;
+    if (lane > TaskLane_Background) return TaskLane_Background;
+
+    return lane;
+}
+
+// Threads running in the lanes before this one.
+static LONG task_ahead(TaskShared* shared, int32_t lane)
+{
+    LONG count = 0;
+
+    for (int32_t i = 0; i < lane; i++)
+    {
+        count += shared->active[i];
+    }
+
+    return count;
+}
+
+// Counts the calling thread in the lane once there is room for it under the budget.
+static void task_acquire(TaskShared* shared, int32_t lane)
+{
+    // GetTickCount64 does not exist on XP; the unsigned difference survives the 49 day wrap.
+    DWORD start = GetTickCount();
+
+    for (;;)
+    {
+        LONG current = shared->active[lane];
+
+        if (lane == TaskLane_Interactive
+            || (task_ahead(shared, lane) + current) < shared->budget
+            || (GetTickCount() - start) >= parkLimit)
+        {
+            if (InterlockedCompareExchange(&shared->active[lane], current + 1, current) == current) return;
+
+            continue;
+        }
+
+        Sleep(1);
+    }
+}
+
+static void task_release(TaskShared* shared, int32_t lane)
+{
+    InterlockedDecrement(&shared->active[lane]);
+}
+
+void task_yield(int32_t lane)
+{
+    lane = task_lane(lane);
+    if (lane == TaskLane_Interactive) return;
+
+    TaskShared* shared = task_shared();
+
+    // This thread is one of active[lane].
+    if ((task_ahead(shared, lane) + shared->active[lane]) <= shared->budget) return;
+
+    task_release(shared, lane);
+    task_acquire(shared, lane);
+}
+
+void task_enter(int32_t lane, int32_t threads)
+{
+    InterlockedExchangeAdd(&task_shared()->active[task_lane(lane)], threads);
+}
+
+void task_leave(int32_t lane, int32_t threads)
+{
+    InterlockedExchangeAdd(&task_shared()->active[task_lane(lane)], -threads);
+}
+
+struct TaskLoop
+{
+    int32_t lane;
+    int32_t count;
+    volatile LONG next;
+    volatile int32_t* cancel;
+    volatile bool canceled;
+    task_body body;
+    void* context;
+};
+
+static void task_loop_run(TaskLoop* loop)
+{
+    TaskShared* shared = task_shared();
+
+    task_acquire(shared, loop->lane);
+
+    for (;;)
+    {
+        if (loop->cancel != NULL && *loop->cancel != 0)
+        {
+            loop->canceled = true;
+            break;
+        }
+
+        LONG index = InterlockedIncrement(&loop->next) - 1;
+        if (index >= loop->count) break;
+
+        loop->body(loop->context, index);
+
+        task_yield(loop->lane);
+    }
+
+    task_release(shared, loop->lane);
+}
+
+bool task_parallel_for(int32_t lane, int32_t count, int32_t threads, volatile int32_t* cancel, task_body body, void* context)
+{
+    if (count <= 0) return true;
+
+    if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+    if (threads > count) threads = count;
+    if (threads <= 0) threads = 1;
+
+    TaskLoop loop;
+    loop.lane = task_lane(lane);
+    loop.count = count;
+    loop.next = 0;
+    loop.cancel = cancel;
+    loop.canceled = false;
+    loop.body = body;
+    loop.context = context;
+
+    std::vector<std::thread> workers;
+
+    for (int32_t i = 1; i < threads; i++)
+    {
+        workers.push_back(std::thread(task_loop_run, &loop));
+    }
+
+    task_loop_run(&loop);
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+
+    return !loop.canceled;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// Work of every native library in the process shares one budget of threads (the number of cores).
+// A lane only gets the part of the budget that the lanes before it leave unused.
+enum TaskLane
+{
+    // Someone is waiting for the result (decoding a download). Never waits for a slot.
+    TaskLane_Interactive = 0,
+    // Throughput work (encoding an upload, verifying a batch of keys).
+    TaskLane_Bulk = 1,
+    // Runs on whatever is left (mining).
+    TaskLane_Background = 2,
+};
+
+typedef void (*task_body)(void* context, int32_t index);
+
+// Runs body(context, index) for every index in [0, count) on up to threads threads, the calling thread included.
+// Each thread takes the next unclaimed index when it is done with one, so no thread sits idle while work is left.
+// body must not throw. Returns false if *cancel became non-zero before every index was started.
+bool task_parallel_for(int32_t lane, int32_t count, int32_t threads, volatile int32_t* cancel, task_body body, void* context);
+
+// Long running work calls this between steps. While the lanes before this one need the cores,
+// the thread waits here, but it comes back at least every few hundred milliseconds so that the caller
+// can look at its own cancel flag.
+void task_yield(int32_t lane);
+
+// For work on threads that the runtime did not start (the managed thread pool).
+// Nothing waits here; the threads are only counted, so that the later lanes give them room.
+void task_enter(int32_t lane, int32_t threads);
+void task_leave(int32_t lane, int32_t threads);
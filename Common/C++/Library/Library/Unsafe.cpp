@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "Unsafe.h"
+#include "Stats.h"
 
 // 32bit Test
 //#define PORTABLE_32_BIT_TEST
@@ -23,8 +24,15 @@
 //#include "wmmintrin.h" //AES
 //#include "immintrin.h" //AVX
 
+static const int32_t statsCopy = stats_register("copy");
+static const int32_t statsEquals = stats_register("equals");
+static const int32_t statsCompare = stats_register("compare");
+static const int32_t statsXor = stats_register("xor");
+
 void copy(byte* src, byte* dst, int32_t len)
 {
+    StatsScope stats(statsCopy, (len <= 256) ? StatsTier_Scalar : StatsTier_Sse2, len);
+
     if (len <= 256)
     {
         memcpy(dst, src, len);
@@ -85,6 +93,8 @@ void copy(byte* src, byte* dst, int32_t len)
 // https://gist.github.com/karthick18/1361842
 bool equals(byte* x, byte* y, int32_t len)
 {
+    StatsScope stats(statsEquals, (len >= 16) ? StatsTier_Sse2 : StatsTier_Scalar, len);
+
 #if defined (PORTABLE_64_BIT)
     if (len >= 16)
     {
@@ -164,6 +174,8 @@ bool equals(byte* x, byte* y, int32_t len)
 
 int32_t compare(byte* x, byte* y, int32_t len)
 {
+    StatsScope stats(statsCompare, StatsTier_Scalar, len);
+
     int32_t c = 0;
 
     for (; len > 0; len--)
@@ -177,6 +189,8 @@ int32_t compare(byte* x, byte* y, int32_t len)
 
 void xor(byte* x, byte* y, byte* result, int32_t len)
 {
+    StatsScope stats(statsXor, (len >= 16) ? StatsTier_Sse2 : StatsTier_Scalar, len);
+
 #if defined (PORTABLE_64_BIT)
     if (len >= 16)
     {
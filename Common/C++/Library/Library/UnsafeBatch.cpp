@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "UnsafeBatch.h"
+#include "Unsafe.h"
+
+#include <intrin.h>
+#include "emmintrin.h" //SSE2
+
+// Keys and hashes are 32 or 64 bytes almost everywhere, so those lengths get bodies with the loop fully unrolled.
+// The length is the same for the whole batch and is dispatched once, outside the loop over the operations.
+
+template<int32_t N>
+static __forceinline bool batch_equals(const byte* x, const byte* y)
+{
+    __m128i diff = _mm_setzero_si128();
+
+    for (int32_t i = 0; i < N; i += 16)
+    {
+        diff = _mm_or_si128(diff, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(x + i)), _mm_loadu_si128((const __m128i*)(y + i))));
+    }
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) == 0xffff;
+}
+
+// The difference of the first bytes that differ, as compare does.
+template<int32_t N>
+static __forceinline int32_t batch_compare(const byte* x, const byte* y)
+{
+    for (int32_t i = 0; i < N; i += 16)
+    {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(x + i)), _mm_loadu_si128((const __m128i*)(y + i)));
+        uint32_t mask = ~(uint32_t)_mm_movemask_epi8(equal) & 0xffff;
+
+        if (mask != 0)
+        {
+            unsigned long bit;
+            _BitScanForward(&bit, mask);
+
+            return (int32_t)x[i + bit] - (int32_t)y[i + bit];
+        }
+    }
+
+    return 0;
+}
+
+template<int32_t N>
+static int32_t batch_run(UnsafeBatch_Operation* operations, int32_t count, byte* operands, int32_t* results)
+{
+    for (int32_t i = 0; i < count; i++)
+    {
+        const UnsafeBatch_Operation& o = operations[i];
+        byte* x = operands + (size_t)o.x * N;
+        byte* y = operands + (size_t)o.y * N;
+
+        switch (o.type)
+        {
+        case UnsafeBatch_Equals:
+            results[i] = batch_equals<N>(x, y) ? 1 : 0;
+            break;
+        case UnsafeBatch_Compare:
+            results[i] = batch_compare<N>(x, y);
+            break;
+        default:
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Every other length goes to the kernels of Unsafe.cpp.
+static int32_t batch_run(UnsafeBatch_Operation* operations, int32_t count, byte* operands, int32_t length, int32_t* results)
+{
+    for (int32_t i = 0; i < count; i++)
+    {
+        const UnsafeBatch_Operation& o = operations[i];
+        byte* x = operands + (size_t)o.x * length;
+        byte* y = operands + (size_t)o.y * length;
+
+        switch (o.type)
+        {
+        case UnsafeBatch_Equals:
+            results[i] = equals(x, y, length) ? 1 : 0;
+            break;
+        case UnsafeBatch_Compare:
+            results[i] = compare(x, y, length);
+            break;
+        default:
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int32_t unsafe_batch(UnsafeBatch_Operation* operations, int32_t count, byte* operands, int32_t length, int32_t* results)
+{
+    if (length == 32) return batch_run<32>(operations, count, operands, results);
+    if (length == 64) return batch_run<64>(operations, count, operands, results);
+
+    return batch_run(operations, count, operands, length, results);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+enum UnsafeBatch_Type
+{
+    UnsafeBatch_Equals = 0,
+    UnsafeBatch_Compare = 1,
+};
+
+// One operation of a batch. x and y are indexes of length-byte operands packed back to back in operands.
+struct UnsafeBatch_Operation
+{
+    int32_t type;
+    int32_t x;
+    int32_t y;
+};
+
+// Runs count operations over the packed operands. results[i] gets 1 / 0 for equals and what compare returns for compare.
+// Returns the index of the first operation with an unknown type, or -1.
+int32_t unsafe_batch(UnsafeBatch_Operation* operations, int32_t count, byte* operands, int32_t length, int32_t* results);
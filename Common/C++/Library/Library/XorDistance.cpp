@@ -0,0 +1,195 @@
+#include "stdafx.h"
+#include "XorDistance.h"
+
+#include <intrin.h>
+#include "immintrin.h" //AVX2
+
+#include <vector>
+
+// Distances are compared as big endian byte strings. The first 8 bytes, loaded as a big endian integer,
+// order almost every pair, so a candidate is usually accepted or rejected with one integer compare and
+// the remaining bytes are only looked at when the prefixes are equal.
+struct XorDistance_Entry
+{
+    uint64_t prefix;
+    int32_t index;
+};
+
+static inline uint64_t xor_distance_load64(const byte* p)
+{
+    uint64_t x;
+    memcpy(&x, p, 8);
+
+    return x;
+}
+
+static uint64_t xor_distance_prefix(const byte* target, const byte* id, int32_t length)
+{
+    if (length >= 8) return _byteswap_uint64(xor_distance_load64(target) ^ xor_distance_load64(id));
+
+    uint64_t x = 0;
+
+    for (int32_t i = 0; i < 8; i++)
+    {
+        x = (x << 8) | ((i < length) ? (byte)(target[i] ^ id[i]) : 0);
+    }
+
+    return x;
+}
+
+static bool xor_distance_avx2_detect()
+{
+    int32_t info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+
+    __cpuidex(info, 7, 0);
+    if ((info[1] & (1 << 5)) == 0) return false;
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return false;
+
+    // The OS must save the YMM registers.
+    return (_xgetbv(0) & 0x6) == 0x6;
+}
+
+static bool xor_distance_avx2()
+{
+    static const bool avx2 = xor_distance_avx2_detect();
+
+    return avx2;
+}
+
+// Four prefixes per iteration: gather the first 8 bytes of four ids, xor them with the target and
+// byte swap each 64 bit lane.
+static void xor_distance_prefixes_avx2(const byte* target, const byte* ids, int32_t count, int32_t idLength, uint64_t* prefixes)
+{
+    const __m256i t = _mm256_broadcastq_epi64(_mm_loadl_epi64((const __m128i*)target));
+    const __m256i swap = _mm256_setr_epi8(
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+        7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m128i step = _mm_set1_epi32(idLength * 4);
+
+    __m128i offsets = _mm_setr_epi32(0, idLength, idLength * 2, idLength * 3);
+
+    int32_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256i v = _mm256_i32gather_epi64((const long long*)ids, offsets, 1);
+        v = _mm256_shuffle_epi8(_mm256_xor_si256(v, t), swap);
+
+        _mm256_storeu_si256((__m256i*)(prefixes + i), v);
+        offsets = _mm_add_epi32(offsets, step);
+    }
+
+    for (; i < count; i++)
+    {
+        prefixes[i] = xor_distance_prefix(target, ids + ((int64_t)i * idLength), idLength);
+    }
+}
+
+// a < b in distance, equal distances ordered by index so the result is stable.
+static inline bool xor_distance_less(const byte* target, const byte* ids, int32_t idLength, const XorDistance_Entry& a, const XorDistance_Entry& b)
+{
+    if (a.prefix != b.prefix) return a.prefix < b.prefix;
+
+    const byte* x = ids + ((int64_t)a.index * idLength);
+    const byte* y = ids + ((int64_t)b.index * idLength);
+
+    for (int32_t i = 8; i < idLength; i++)
+    {
+        byte dx = target[i] ^ x[i];
+        byte dy = target[i] ^ y[i];
+
+        if (dx != dy) return dx < dy;
+    }
+
+    return a.index < b.index;
+}
+
+// Writes the indexes of the k ids nearest to target, nearest first, and returns how many were written.
+// ids holds count ids of idLength bytes each, packed.
+int32_t xor_distance_topk(byte* target, byte* ids, int32_t count, int32_t idLength, int32_t k, int32_t* result)
+{
+    if (count <= 0 || k <= 0) return 0;
+    if (k > count) k = count;
+
+    std::vector<uint64_t> prefixes(count);
+
+    if (xor_distance_avx2() && idLength >= 8 && (int64_t)count * idLength < 0x7fffffff)
+    {
+        xor_distance_prefixes_avx2(target, ids, count, idLength, &prefixes[0]);
+    }
+    else
+    {
+        for (int32_t i = 0; i < count; i++)
+        {
+            prefixes[i] = xor_distance_prefix(target, ids + ((int64_t)i * idLength), idLength);
+        }
+    }
+
+    // The best k so far, sorted. Once it is full, most candidates lose against the last entry's prefix.
+    std::vector<XorDistance_Entry> best(k);
+    int32_t size = 0;
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        XorDistance_Entry entry;
+        entry.prefix = prefixes[i];
+        entry.index = i;
+
+        if (size == k)
+        {
+            if (entry.prefix > best[k - 1].prefix) continue;
+            if (!xor_distance_less(target, ids, idLength, entry, best[k - 1])) continue;
+
+            size--;
+        }
+
+        int32_t position = size;
+
+        while (position > 0 && xor_distance_less(target, ids, idLength, entry, best[position - 1]))
+        {
+            best[position] = best[position - 1];
+            position--;
+        }
+
+        best[position] = entry;
+        size++;
+    }
+
+    for (int32_t i = 0; i < size; i++)
+    {
+        result[i] = best[i].index;
+    }
+
+    return size;
+}
+
+// Kademlia's distance: the bit length of target ^ id, 0 for equal ids.
+void xor_distance_buckets(byte* target, byte* ids, int32_t count, int32_t idLength, int32_t* result)
+{
+    for (int32_t i = 0; i < count; i++)
+    {
+        const byte* id = ids + ((int64_t)i * idLength);
+        int32_t distance = 0;
+
+        for (int32_t j = 0; j < idLength; j++)
+        {
+            unsigned long value = target[j] ^ id[j];
+            if (value == 0) continue;
+
+            unsigned long bit;
+            _BitScanReverse(&bit, value);
+
+            distance = (int32_t)(bit + 1) + ((idLength - (j + 1)) * 8);
+            break;
+        }
+
+        result[i] = distance;
+    }
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+int32_t xor_distance_topk(byte* target, byte* ids, int32_t count, int32_t idLength, int32_t k, int32_t* result);
+void xor_distance_buckets(byte* target, byte* ids, int32_t count, int32_t idLength, int32_t* result);
@@ -1,5 +1,7 @@
 // dllmain.cpp : Defines the entry point for the DLL application.
 #include "stdafx.h"
+#include "Slab.h"
+#include "Stats.h"
 
 BOOL APIENTRY DllMain( HMODULE hModule,
                        DWORD  ul_reason_for_call,
@@ -9,8 +11,14 @@ BOOL APIENTRY DllMain( HMODULE hModule,
 	switch (ul_reason_for_call)
 	{
 	case DLL_PROCESS_ATTACH:
-	case DLL_THREAD_ATTACH:
+		slab_initialize();
+		stats_initialize();
+		break;
 	case DLL_THREAD_DETACH:
+		slab_thread_detach();
+		stats_thread_detach();
+		break;
+	case DLL_THREAD_ATTACH:
 	case DLL_PROCESS_DETACH:
 		break;
 	}
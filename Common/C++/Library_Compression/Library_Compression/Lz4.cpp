@@ -0,0 +1,289 @@
+#include "stdafx.h"
+#include "Lz4.h"
+
+const int32_t MINMATCH = 4;
+const int32_t LASTLITERALS = 5;
+const int32_t MFLIMIT = 12;
+const int32_t MAX_DISTANCE = 65535;
+
+const int32_t HASH_LOG = 12;
+
+// Every (1 << SKIP_STRENGTH) misses the search step grows by one, so data without matches is skipped quickly.
+const int32_t SKIP_STRENGTH = 6;
+
+inline uint32_t read32(const byte* p)
+{
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+
+    return x;
+}
+
+inline uint32_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> ((MINMATCH * 8) - HASH_LOG);
+}
+
+inline byte* writeLength(byte* op, int32_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        *op++ = 255;
+    }
+
+    *op++ = (byte)length;
+
+    return op;
+}
+
+int32_t lz4_compress(byte* src, int32_t srcLength, byte* dst, int32_t dstLength)
+{
+    // Anything that does not beat the raw size is reported as incompressible.
+    if (dstLength > srcLength - 1) dstLength = srcLength - 1;
+    if (dstLength <= 0) return 0;
+
+    uint32_t table[1 << HASH_LOG];
+    memset(table, 0, sizeof(table));
+
+    const byte* ip = src;
+    const byte* anchor = src;
+    const byte* const iend = src + srcLength;
+    const byte* const mflimit = iend - MFLIMIT;
+    const byte* const matchlimit = iend - LASTLITERALS;
+
+    byte* op = dst;
+    byte* const oend = dst + dstLength;
+
+    if (srcLength >= MFLIMIT + 1)
+    {
+        table[hash(read32(ip))] = 0;
+        ip++;
+
+        for (;;)
+        {
+            const byte* match;
+            byte* token;
+
+            // Find a match
+            {
+                const byte* forwardIp = ip;
+                int32_t searchMatchCount = 1 << SKIP_STRENGTH;
+
+                do
+                {
+                    uint32_t h = hash(read32(forwardIp));
+
+                    ip = forwardIp;
+                    forwardIp += searchMatchCount++ >> SKIP_STRENGTH;
+
+                    if (forwardIp > mflimit) goto Last;
+
+                    match = src + table[h];
+                    table[h] = (uint32_t)(ip - src);
+                }
+                while ((ip - match) > MAX_DISTANCE || read32(match) != read32(ip));
+            }
+
+            // Extend backwards
+            while (ip > anchor && match > src && ip[-1] == match[-1])
+            {
+                ip--;
+                match--;
+            }
+
+            // Literals
+            {
+                int32_t literalLength = (int32_t)(ip - anchor);
+
+                token = op++;
+
+                if ((oend - op) < literalLength + (literalLength / 255) + 2 + 1 + LASTLITERALS) return 0;
+
+                if (literalLength >= 15)
+                {
+                    *token = (byte)(15 << 4);
+                    op = writeLength(op, literalLength - 15);
+                }
+                else
+                {
+                    *token = (byte)(literalLength << 4);
+                }
+
+                memcpy(op, anchor, literalLength);
+                op += literalLength;
+            }
+
+            for (;;)
+            {
+                // Offset
+                {
+                    uint16_t offset = (uint16_t)(ip - match);
+
+                    *op++ = (byte)offset;
+                    *op++ = (byte)(offset >> 8);
+                }
+
+                // Match length
+                {
+                    const byte* start = ip;
+
+                    ip += MINMATCH;
+                    match += MINMATCH;
+
+                    while (ip < matchlimit && *ip == *match)
+                    {
+                        ip++;
+                        match++;
+                    }
+
+                    int32_t matchLength = (int32_t)(ip - start) - MINMATCH;
+
+                    if ((oend - op) < (matchLength / 255) + 1 + LASTLITERALS) return 0;
+
+                    if (matchLength >= 15)
+                    {
+                        *token += 15;
+                        op = writeLength(op, matchLength - 15);
+                    }
+                    else
+                    {
+                        *token += (byte)matchLength;
+                    }
+                }
+
+                anchor = ip;
+
+                if (ip > mflimit) goto Last;
+
+                table[hash(read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+
+                // Test the next position for an immediate match
+                uint32_t h = hash(read32(ip));
+                match = src + table[h];
+                table[h] = (uint32_t)(ip - src);
+
+                if ((ip - match) > MAX_DISTANCE || read32(match) != read32(ip)) break;
+
+                token = op++;
+                *token = 0;
+            }
+
+            ip++;
+        }
+    }
+
+Last:
+    {
+        int32_t lastLength = (int32_t)(iend - anchor);
+
+        if ((oend - op) < 1 + lastLength + ((lastLength + 255 - 15) / 255)) return 0;
+
+        if (lastLength >= 15)
+        {
+            *op++ = (byte)(15 << 4);
+            op = writeLength(op, lastLength - 15);
+        }
+        else
+        {
+            *op++ = (byte)(lastLength << 4);
+        }
+
+        memcpy(op, anchor, lastLength);
+        op += lastLength;
+    }
+
+    return (int32_t)(op - dst);
+}
+
+int32_t lz4_decompress(byte* src, int32_t srcLength, byte* dst, int32_t dstLength)
+{
+    const byte* ip = src;
+    const byte* const iend = src + srcLength;
+
+    byte* op = dst;
+    byte* const oend = dst + dstLength;
+
+    while (ip < iend)
+    {
+        int32_t token = *ip++;
+
+        // Literals
+        {
+            int32_t length = token >> 4;
+
+            if (length == 15)
+            {
+                int32_t s;
+
+                do
+                {
+                    if (ip >= iend) return -1;
+
+                    s = *ip++;
+                    length += s;
+
+                    if (length > dstLength) return -1;
+                }
+                while (s == 255);
+            }
+
+            if ((iend - ip) < length || (oend - op) < length) return -1;
+
+            memcpy(op, ip, length);
+            op += length;
+            ip += length;
+        }
+
+        // The last sequence has no match part.
+        if (ip == iend) break;
+
+        // Match
+        {
+            if ((iend - ip) < 2) return -1;
+
+            int32_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+
+            if (offset == 0 || offset > (op - dst)) return -1;
+
+            int32_t length = token & 15;
+
+            if (length == 15)
+            {
+                int32_t s;
+
+                do
+                {
+                    if (ip >= iend) return -1;
+
+                    s = *ip++;
+                    length += s;
+
+                    if (length > dstLength) return -1;
+                }
+                while (s == 255);
+            }
+
+            length += MINMATCH;
+
+            if ((oend - op) < length) return -1;
+
+            const byte* match = op - offset;
+
+            if (offset >= 8)
+            {
+                for (; length >= 8; length -= 8, op += 8, match += 8)
+                {
+                    memcpy(op, match, 8);
+                }
+            }
+
+            for (; length > 0; length--)
+            {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return (int32_t)(op - dst);
+}
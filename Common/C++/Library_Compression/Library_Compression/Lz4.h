@@ -0,0 +1,7 @@
+#pragma once
+
+// LZ4 block format.
+// lz4_compress returns the compressed length, or 0 when the result would not be smaller than the source.
+// lz4_decompress returns the decompressed length, or -1 when the source is malformed or does not fit.
+int32_t lz4_compress(byte* src, int32_t srcLength, byte* dst, int32_t dstLength);
+int32_t lz4_decompress(byte* src, int32_t srcLength, byte* dst, int32_t dstLength);
@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "Xz.h"
+
+#include <thread>
+
+#include "lzma.h"
+
+struct Xz
+{
+    lzma_stream stream;
+};
+
+// Each encoder thread holds a block of input, its output and a match finder, about 165 MB at preset 6.
+// The x86 build shares 2 GB of address space with the managed heap, so there it stays on one thread
+// at the default presets.
+#ifdef _WIN64
+const uint64_t xzThreadingBudget = 1024ULL * 1024 * 1024;
+#else
+const uint64_t xzThreadingBudget = 256ULL * 1024 * 1024;
+#endif
+
+const int32_t xzMaxThreads = 8;
+
+uint32_t xz_threads(int32_t threads)
+{
+    if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+    if (threads > xzMaxThreads) threads = xzMaxThreads;
+    if (threads <= 0) threads = 1;
+
+    return (uint32_t)threads;
+}
+
+// Each block is compressed independently on its own thread, so the output is
+// a regular .xz stream with several blocks and decodes with any xz implementation.
+void* xz_compress_create(int32_t preset, int32_t threads, int64_t blockSize)
+{
+    Xz* xz = new Xz();
+    lzma_stream init = LZMA_STREAM_INIT;
+    xz->stream = init;
+
+    // One thread runs the single-threaded encoder on the calling thread, so no worker thread
+    // is started and the caller's priority applies, like the old xz --threads=1 process.
+    if (threads == 1)
+    {
+        if (lzma_easy_encoder(&xz->stream, (uint32_t)preset, LZMA_CHECK_CRC64) != LZMA_OK)
+        {
+            delete xz;
+            return NULL;
+        }
+
+        return xz;
+    }
+
+    lzma_mt mt;
+    memset(&mt, 0, sizeof(mt));
+    mt.flags = 0;
+    mt.block_size = (blockSize > 0) ? (uint64_t)blockSize : 0;
+    mt.timeout = 0;
+    mt.preset = (uint32_t)preset;
+    mt.filters = NULL;
+    mt.check = LZMA_CHECK_CRC64;
+    mt.threads = xz_threads(threads);
+
+    // The encoder has no memory limit of its own, so threads are dropped until the estimate fits.
+    while (mt.threads > 1 && lzma_stream_encoder_mt_memusage(&mt) > xzThreadingBudget)
+    {
+        mt.threads--;
+    }
+
+    if (lzma_stream_encoder_mt(&xz->stream, &mt) != LZMA_OK)
+    {
+        delete xz;
+        return NULL;
+    }
+
+    return xz;
+}
+
+void* xz_decompress_create(int64_t memoryLimit, int32_t threads)
+{
+    Xz* xz = new Xz();
+    lzma_stream init = LZMA_STREAM_INIT;
+    xz->stream = init;
+
+    uint64_t memlimit = (memoryLimit > 0) ? (uint64_t)memoryLimit : UINT64_MAX;
+
+#if LZMA_VERSION >= 50040002
+    if (threads == 1)
+    {
+        if (lzma_stream_decoder(&xz->stream, memlimit, LZMA_CONCATENATED) != LZMA_OK)
+        {
+            delete xz;
+            return NULL;
+        }
+
+        return xz;
+    }
+
+    // Blocks written by the multithreaded encoder carry their sizes and are decoded in parallel.
+    lzma_mt mt;
+    memset(&mt, 0, sizeof(mt));
+    mt.flags = LZMA_CONCATENATED;
+    mt.timeout = 0;
+    mt.threads = xz_threads(threads);
+    // Past this the decoder runs on one thread instead of failing.
+    mt.memlimit_threading = (memlimit < xzThreadingBudget) ? memlimit : xzThreadingBudget;
+    mt.memlimit_stop = memlimit;
+
+    lzma_ret ret = lzma_stream_decoder_mt(&xz->stream, &mt);
+#else
+    lzma_ret ret = lzma_stream_decoder(&xz->stream, memlimit, LZMA_CONCATENATED);
+#endif
+
+    if (ret != LZMA_OK)
+    {
+        delete xz;
+        return NULL;
+    }
+
+    return xz;
+}
+
+int32_t xz_code(void* context, byte* in, int32_t inLength, int32_t* inUsed, byte* out, int32_t outLength, int32_t* outUsed, bool finish)
+{
+    Xz* xz = (Xz*)context;
+
+    xz->stream.next_in = in;
+    xz->stream.avail_in = (size_t)inLength;
+    xz->stream.next_out = out;
+    xz->stream.avail_out = (size_t)outLength;
+
+    lzma_ret ret = lzma_code(&xz->stream, finish ? LZMA_FINISH : LZMA_RUN);
+
+    *inUsed = inLength - (int32_t)xz->stream.avail_in;
+    *outUsed = outLength - (int32_t)xz->stream.avail_out;
+
+    if (ret == LZMA_OK) return XZ_OK;
+    if (ret == LZMA_STREAM_END) return XZ_STREAM_END;
+
+    return XZ_ERROR;
+}
+
+void xz_free(void* context)
+{
+    Xz* xz = (Xz*)context;
+    if (xz == NULL) return;
+
+    lzma_end(&xz->stream);
+    delete xz;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// xz_code results
+const int32_t XZ_OK = 0;
+const int32_t XZ_STREAM_END = 1;
+const int32_t XZ_ERROR = -1;
+
+// threads <= 0 uses one thread per core, up to 8. 1 codes on the calling thread without starting any thread.
+void* xz_compress_create(int32_t preset, int32_t threads, int64_t blockSize);
+void* xz_decompress_create(int64_t memoryLimit, int32_t threads);
+int32_t xz_code(void* context, byte* in, int32_t inLength, int32_t* inUsed, byte* out, int32_t outLength, int32_t* outUsed, bool finish);
+void xz_free(void* context);
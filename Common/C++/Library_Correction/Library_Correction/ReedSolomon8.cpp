@@ -1,5 +1,7 @@
 #include "stdafx.h"
 #include "ReedSolomon8.h"
+#include "Sha256.h"
+#include "..\..\Library\Library\Stats.h"
 
 // 32bit Test
 //#define PORTABLE_32_BIT_TEST
@@ -23,8 +25,13 @@
 //#include "wmmintrin.h" //AES
 //#include "immintrin.h" //AVX
 
+static const int32_t statsMul = stats_register("mul");
+static const int32_t statsEncodeSha256 = stats_register("encode_sha256");
+
 void mul(byte* src, byte* dst, byte* mulc, int32_t len)
 {
+    StatsScope stats(statsMul, StatsTier_Sse2, len);
+
 #if defined (PORTABLE_64_BIT)
     __m128i xmm0;
     __m128i xmm1;
@@ -425,3 +432,33 @@ void mul(byte* src, byte* dst, byte* mulc, int32_t len)
     }
 #endif
 }
+
+void encode_sha256(byte** sources, int32_t k, byte* coefficients, byte* table, byte* parity, int32_t length, byte* hash)
+{
+    // Counted by the length of the parity row; the mul calls below are counted on their own as well.
+    StatsScope stats(statsEncodeSha256, StatsTier_Sse2, length);
+
+    // Each tile is hashed right after its last mul, while it is still in the cache.
+    const int32_t tileSize = 1024 * 32;
+
+    Sha256_Context context;
+    sha256_initialize(&context);
+
+    for (int32_t offset = 0; offset < length; offset += tileSize)
+    {
+        int32_t size = (length - offset < tileSize) ? (length - offset) : tileSize;
+
+        memset(parity + offset, 0, size);
+
+        for (int32_t i = 0; i < k; i++)
+        {
+            if (coefficients[i] == 0) continue;
+
+            mul(sources[i] + offset, parity + offset, table + (coefficients[i] * 256), size);
+        }
+
+        sha256_update(&context, parity + offset, size & ~63);
+    }
+
+    sha256_finalize(&context, parity + (length & ~63), length & 63, hash);
+}
@@ -1,3 +1,7 @@
 #pragma once
 
 void mul(byte* src, byte* dst, byte* mulc, int32_t len);
+
+// One parity row: parity = sum(coefficients[i] * sources[i]) over GF(2^8), with the SHA-256 of the row.
+// table: the 256 * 256 multiplication table, row c being the products with c
+void encode_sha256(byte** sources, int32_t k, byte* coefficients, byte* table, byte* parity, int32_t length, byte* hash);
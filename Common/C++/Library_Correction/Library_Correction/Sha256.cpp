@@ -0,0 +1,216 @@
+#include "stdafx.h"
+#include "Sha256.h"
+
+#include <intrin.h>
+
+#include "emmintrin.h" //SSE2
+#include "immintrin.h" //SHA
+
+// The SHA extension intrinsics are only declared by newer compilers.
+#if (defined(_MSC_VER) && _MSC_VER >= 1900) || defined(__SHA__)
+#define SHA256_SHANI
+#endif
+
+static const uint32_t K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H[8] =
+{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const int32_t blockSize = 64;
+
+inline uint32_t load_be(const byte* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+inline void store_be(byte* p, uint32_t x)
+{
+    p[0] = (byte)(x >> 24);
+    p[1] = (byte)(x >> 16);
+    p[2] = (byte)(x >> 8);
+    p[3] = (byte)x;
+}
+
+inline uint32_t rotr(uint32_t x, int32_t n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+void sha256_blocks_scalar(uint32_t* state, const byte* source, int32_t blocks)
+{
+    uint32_t w[64];
+
+    for (int32_t i = 0; i < blocks; i++, source += blockSize)
+    {
+        for (int32_t t = 0; t < 16; t++)
+        {
+            w[t] = load_be(source + (t * 4));
+        }
+
+        for (int32_t t = 16; t < 64; t++)
+        {
+            uint32_t s0 = rotr(w[t - 15], 7) ^ rotr(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr(w[t - 2], 17) ^ rotr(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int32_t t = 0; t < 64; t++)
+        {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + w[t];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) | (c & (a | b)));
+
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef SHA256_SHANI
+
+// Next four schedule words from the previous sixteen (w0 is the oldest group).
+static __forceinline __m128i sha256_shani_schedule(__m128i w0, __m128i w1, __m128i w2, __m128i w3)
+{
+    return _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4)), w3);
+}
+
+static __forceinline void sha256_shani_rounds(__m128i& state0, __m128i& state1, __m128i w, int32_t r)
+{
+    __m128i kw = _mm_add_epi32(w, _mm_loadu_si128((const __m128i*)&K[r * 4]));
+
+    state1 = _mm_sha256rnds2_epu32(state1, state0, kw);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(kw, 0x0E));
+}
+
+void sha256_blocks_shani(uint32_t* state, const byte* source, int32_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The instructions keep the state as ABEF and CDGH.
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (int32_t i = 0; i < blocks; i++, source += blockSize)
+    {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+
+        __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 0)), mask);
+        __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 16)), mask);
+        __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 32)), mask);
+        __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 48)), mask);
+
+        sha256_shani_rounds(state0, state1, w0, 0);
+        sha256_shani_rounds(state0, state1, w1, 1);
+        sha256_shani_rounds(state0, state1, w2, 2);
+        sha256_shani_rounds(state0, state1, w3, 3);
+
+        for (int32_t r = 4; r < 16; r += 4)
+        {
+            w0 = sha256_shani_schedule(w0, w1, w2, w3);
+            sha256_shani_rounds(state0, state1, w0, r + 0);
+            w1 = sha256_shani_schedule(w1, w2, w3, w0);
+            sha256_shani_rounds(state0, state1, w1, r + 1);
+            w2 = sha256_shani_schedule(w2, w3, w0, w1);
+            sha256_shani_rounds(state0, state1, w2, r + 2);
+            w3 = sha256_shani_schedule(w3, w0, w1, w2);
+            sha256_shani_rounds(state0, state1, w3, r + 3);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#endif
+
+typedef void (*Sha256_Blocks)(uint32_t* state, const byte* source, int32_t blocks);
+
+static Sha256_Blocks sha256_detect()
+{
+#ifdef SHA256_SHANI
+    int32_t info[4];
+
+    __cpuid(info, 0);
+
+    if (info[0] >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        if ((info[1] & (1 << 29)) != 0) return sha256_blocks_shani;
+    }
+#endif
+
+    return sha256_blocks_scalar;
+}
+
+static Sha256_Blocks sha256_blocks()
+{
+    static const Sha256_Blocks blocks = sha256_detect();
+
+    return blocks;
+}
+
+void sha256_initialize(Sha256_Context* context)
+{
+    memcpy(context->state, H, sizeof(context->state));
+    context->length = 0;
+}
+
+void sha256_update(Sha256_Context* context, const byte* source, int32_t length)
+{
+    sha256_blocks()(context->state, source, length / blockSize);
+    context->length += length;
+}
+
+void sha256_finalize(Sha256_Context* context, const byte* source, int32_t length, byte* digest)
+{
+    int32_t blocks = length / blockSize;
+    sha256_update(context, source, blocks * blockSize);
+
+    source += blocks * blockSize;
+    length -= blocks * blockSize;
+
+    // The last partial block, 0x80, zeros and the bit length. One or two blocks.
+    byte tail[blockSize * 2];
+    int32_t tailBlocks = (length + 9 > blockSize) ? 2 : 1;
+
+    memcpy(tail, source, length);
+    tail[length] = 0x80;
+    memset(tail + length + 1, 0, (tailBlocks * blockSize) - length - 1);
+
+    uint64_t bits = (context->length + length) * 8;
+    store_be(tail + (tailBlocks * blockSize) - 8, (uint32_t)(bits >> 32));
+    store_be(tail + (tailBlocks * blockSize) - 4, (uint32_t)bits);
+
+    sha256_blocks()(context->state, tail, tailBlocks);
+
+    for (int32_t t = 0; t < 8; t++)
+    {
+        store_be(digest + (t * 4), context->state[t]);
+    }
+}
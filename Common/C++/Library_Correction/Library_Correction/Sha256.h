@@ -0,0 +1,15 @@
+#pragma once
+
+struct Sha256_Context
+{
+    uint32_t state[8];
+    uint64_t length;
+};
+
+void sha256_initialize(Sha256_Context* context);
+
+// length must be a multiple of 64.
+void sha256_update(Sha256_Context* context, const byte* source, int32_t length);
+
+// Hashes the remaining bytes (any length) and writes the 32 byte digest.
+void sha256_finalize(Sha256_Context* context, const byte* source, int32_t length, byte* digest);
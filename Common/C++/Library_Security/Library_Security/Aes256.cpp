@@ -0,0 +1,558 @@
+#include "stdafx.h"
+#include "Aes256.h"
+#include "HmacSha256.h"
+#include "..\..\Library\Library\TaskRuntime.h"
+
+#include <intrin.h>
+
+#include "emmintrin.h" //SSE2
+#include "wmmintrin.h" //AES
+
+#include <thread>
+#include <vector>
+
+const int32_t blockSize = 16;
+const int32_t rounds = 14;
+
+// Below this many bytes per thread, starting a thread costs more than it saves.
+const int32_t threadMinimum = 1024 * 64;
+
+// Records are encrypted and hashed tile by tile, so the hash reads the ciphertext while it is still in L1.
+const int32_t tileSize = 1024 * 8;
+const int32_t macSize = 32;
+
+struct Aes256_Context
+{
+    byte encrypt[(rounds + 1) * blockSize];
+    byte decrypt[(rounds + 1) * blockSize];
+};
+
+struct Aes256_Keys
+{
+    __m128i k[rounds + 1];
+
+    Aes256_Keys(const byte* schedule)
+    {
+        for (int32_t i = 0; i <= rounds; i++)
+        {
+            k[i] = _mm_loadu_si128((const __m128i*)(schedule + (i * blockSize)));
+        }
+    }
+
+    // The copy on the stack is as secret as the schedule itself.
+    ~Aes256_Keys()
+    {
+        SecureZeroMemory(k, sizeof(k));
+    }
+};
+
+static __forceinline __m128i aes256_expand_1(__m128i t1, __m128i t2)
+{
+    t2 = _mm_shuffle_epi32(t2, 0xff);
+
+    __m128i t4 = _mm_slli_si128(t1, 4);
+    t1 = _mm_xor_si128(t1, t4);
+    t4 = _mm_slli_si128(t4, 4);
+    t1 = _mm_xor_si128(t1, t4);
+    t4 = _mm_slli_si128(t4, 4);
+    t1 = _mm_xor_si128(t1, t4);
+
+    return _mm_xor_si128(t1, t2);
+}
+
+static __forceinline __m128i aes256_expand_2(__m128i t1, __m128i t3)
+{
+    __m128i t2 = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(t1, 0x00), 0xaa);
+
+    __m128i t4 = _mm_slli_si128(t3, 4);
+    t3 = _mm_xor_si128(t3, t4);
+    t4 = _mm_slli_si128(t4, 4);
+    t3 = _mm_xor_si128(t3, t4);
+    t4 = _mm_slli_si128(t4, 4);
+    t3 = _mm_xor_si128(t3, t4);
+
+    return _mm_xor_si128(t3, t2);
+}
+
+// _mm_aeskeygenassist_si128 needs the round constant as an immediate.
+#define AES256_EXPAND(i, rcon) \
+    t1 = aes256_expand_1(t1, _mm_aeskeygenassist_si128(t3, rcon)); \
+    k[i] = t1; \
+    if (i + 1 <= rounds) { t3 = aes256_expand_2(t1, t3); k[i + 1] = t3; }
+
+static bool aes256_supported()
+{
+    int32_t info[4];
+    __cpuid(info, 1);
+
+    return (info[2] & (1 << 25)) != 0;
+}
+
+void* aes256_create(byte* key)
+{
+    static const bool supported = aes256_supported();
+    if (!supported) return NULL;
+
+    __m128i k[rounds + 2];
+
+    __m128i t1 = _mm_loadu_si128((const __m128i*)(key + 0));
+    __m128i t3 = _mm_loadu_si128((const __m128i*)(key + 16));
+
+    k[0] = t1;
+    k[1] = t3;
+
+    AES256_EXPAND(2, 0x01);
+    AES256_EXPAND(4, 0x02);
+    AES256_EXPAND(6, 0x04);
+    AES256_EXPAND(8, 0x08);
+    AES256_EXPAND(10, 0x10);
+    AES256_EXPAND(12, 0x20);
+    AES256_EXPAND(14, 0x40);
+
+    Aes256_Context* context = (Aes256_Context*)malloc(sizeof(Aes256_Context));
+
+    if (context == NULL)
+    {
+        SecureZeroMemory(k, sizeof(k));
+
+        return NULL;
+    }
+
+    for (int32_t i = 0; i <= rounds; i++)
+    {
+        _mm_storeu_si128((__m128i*)(context->encrypt + (i * blockSize)), k[i]);
+    }
+
+    // The equivalent inverse cipher uses the reversed schedule with InvMixColumns applied to the inner keys.
+    _mm_storeu_si128((__m128i*)(context->decrypt + (0 * blockSize)), k[rounds]);
+
+    for (int32_t i = 1; i < rounds; i++)
+    {
+        _mm_storeu_si128((__m128i*)(context->decrypt + (i * blockSize)), _mm_aesimc_si128(k[rounds - i]));
+    }
+
+    _mm_storeu_si128((__m128i*)(context->decrypt + (rounds * blockSize)), k[0]);
+
+    // k[0] and k[1] are the raw key. SecureZeroMemory is not optimized away like memset on a dead buffer.
+    SecureZeroMemory(k, sizeof(k));
+
+    return context;
+}
+
+void aes256_free(void* context)
+{
+    if (context == NULL) return;
+
+    SecureZeroMemory(context, sizeof(Aes256_Context));
+    free(context);
+}
+
+static __forceinline __m128i aes256_encrypt_block(const Aes256_Keys& keys, __m128i x)
+{
+    x = _mm_xor_si128(x, keys.k[0]);
+
+    for (int32_t r = 1; r < rounds; r++)
+    {
+        x = _mm_aesenc_si128(x, keys.k[r]);
+    }
+
+    return _mm_aesenclast_si128(x, keys.k[rounds]);
+}
+
+static __forceinline __m128i aes256_decrypt_block(const Aes256_Keys& keys, __m128i x)
+{
+    x = _mm_xor_si128(x, keys.k[0]);
+
+    for (int32_t r = 1; r < rounds; r++)
+    {
+        x = _mm_aesdec_si128(x, keys.k[r]);
+    }
+
+    return _mm_aesdeclast_si128(x, keys.k[rounds]);
+}
+
+// Eight independent blocks keep the AES unit busy, since each aesenc/aesdec has several cycles of latency.
+#define AES256_ROUND8(op, key) \
+    x0 = op(x0, key); x1 = op(x1, key); x2 = op(x2, key); x3 = op(x3, key); \
+    x4 = op(x4, key); x5 = op(x5, key); x6 = op(x6, key); x7 = op(x7, key);
+
+#define AES256_XOR8(key) \
+    x0 = _mm_xor_si128(x0, key); x1 = _mm_xor_si128(x1, key); x2 = _mm_xor_si128(x2, key); x3 = _mm_xor_si128(x3, key); \
+    x4 = _mm_xor_si128(x4, key); x5 = _mm_xor_si128(x5, key); x6 = _mm_xor_si128(x6, key); x7 = _mm_xor_si128(x7, key);
+
+void aes256_cbc_encrypt(void* context, byte* iv, byte* buffer, int32_t length)
+{
+    const Aes256_Keys keys(((Aes256_Context*)context)->encrypt);
+
+    __m128i x = _mm_loadu_si128((const __m128i*)iv);
+
+    for (int32_t i = 0; i + blockSize <= length; i += blockSize)
+    {
+        x = aes256_encrypt_block(keys, _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)(buffer + i))));
+        _mm_storeu_si128((__m128i*)(buffer + i), x);
+    }
+
+    _mm_storeu_si128((__m128i*)iv, x);
+}
+
+static void aes256_cbc_decrypt_range(const byte* schedule, const byte* iv, byte* buffer, int32_t blocks)
+{
+    const Aes256_Keys keys(schedule);
+
+    __m128i previous = _mm_loadu_si128((const __m128i*)iv);
+
+    __m128i* p = (__m128i*)buffer;
+
+    for (; blocks >= 8; blocks -= 8, p += 8)
+    {
+        __m128i c0 = _mm_loadu_si128(p + 0);
+        __m128i c1 = _mm_loadu_si128(p + 1);
+        __m128i c2 = _mm_loadu_si128(p + 2);
+        __m128i c3 = _mm_loadu_si128(p + 3);
+        __m128i c4 = _mm_loadu_si128(p + 4);
+        __m128i c5 = _mm_loadu_si128(p + 5);
+        __m128i c6 = _mm_loadu_si128(p + 6);
+        __m128i c7 = _mm_loadu_si128(p + 7);
+
+        __m128i x0 = c0, x1 = c1, x2 = c2, x3 = c3, x4 = c4, x5 = c5, x6 = c6, x7 = c7;
+
+        AES256_XOR8(keys.k[0]);
+
+        for (int32_t r = 1; r < rounds; r++)
+        {
+            AES256_ROUND8(_mm_aesdec_si128, keys.k[r]);
+        }
+
+        AES256_ROUND8(_mm_aesdeclast_si128, keys.k[rounds]);
+
+        _mm_storeu_si128(p + 0, _mm_xor_si128(x0, previous));
+        _mm_storeu_si128(p + 1, _mm_xor_si128(x1, c0));
+        _mm_storeu_si128(p + 2, _mm_xor_si128(x2, c1));
+        _mm_storeu_si128(p + 3, _mm_xor_si128(x3, c2));
+        _mm_storeu_si128(p + 4, _mm_xor_si128(x4, c3));
+        _mm_storeu_si128(p + 5, _mm_xor_si128(x5, c4));
+        _mm_storeu_si128(p + 6, _mm_xor_si128(x6, c5));
+        _mm_storeu_si128(p + 7, _mm_xor_si128(x7, c6));
+
+        previous = c7;
+    }
+
+    for (; blocks > 0; blocks--, p++)
+    {
+        __m128i c = _mm_loadu_si128(p);
+        _mm_storeu_si128(p, _mm_xor_si128(aes256_decrypt_block(keys, c), previous));
+
+        previous = c;
+    }
+}
+
+// Splits blocks into ranges of whole 8 block groups, one per thread. The ranges run through
+// task_parallel_for, so they only get the threads the budget leaves to the bulk lane.
+static int32_t aes256_split(int32_t blocks, int32_t threads)
+{
+    if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+    if (threads > (blocks * blockSize) / threadMinimum) threads = (blocks * blockSize) / threadMinimum;
+    if (threads <= 1) return blocks;
+
+    return (((blocks + threads - 1) / threads) + 7) & ~7;
+}
+
+struct Aes256_CbcBatch
+{
+    const byte* schedule;
+    byte* buffer;
+    int32_t blocks;
+    int32_t chunk;
+    const byte* previous;
+};
+
+static void aes256_cbc_decrypt_chunk(void* context, int32_t index)
+{
+    Aes256_CbcBatch* batch = (Aes256_CbcBatch*)context;
+
+    int32_t offset = index * batch->chunk;
+    int32_t count = (batch->blocks - offset < batch->chunk) ? (batch->blocks - offset) : batch->chunk;
+
+    aes256_cbc_decrypt_range(batch->schedule, batch->previous + (index * blockSize), batch->buffer + (offset * blockSize), count);
+}
+
+void aes256_cbc_decrypt(void* context, byte* iv, byte* buffer, int32_t length, int32_t threads)
+{
+    const byte* schedule = ((Aes256_Context*)context)->decrypt;
+
+    int32_t blocks = length / blockSize;
+    if (blocks == 0) return;
+
+    int32_t chunk = aes256_split(blocks, threads);
+
+    // Every range needs the ciphertext block before it, which another range overwrites in place,
+    // so all of them are read before any thread starts.
+    // Kept as bytes, since the allocator does not align __m128i on x86.
+    std::vector<byte> previous(iv, iv + blockSize);
+
+    for (int32_t offset = chunk; offset < blocks; offset += chunk)
+    {
+        const byte* p = buffer + ((offset - 1) * blockSize);
+        previous.insert(previous.end(), p, p + blockSize);
+    }
+
+    int32_t ranges = (int32_t)previous.size() / blockSize;
+
+    _mm_storeu_si128((__m128i*)iv, _mm_loadu_si128((const __m128i*)(buffer + ((blocks - 1) * blockSize))));
+
+    Aes256_CbcBatch batch;
+    batch.schedule = schedule;
+    batch.buffer = buffer;
+    batch.blocks = blocks;
+    batch.chunk = chunk;
+    batch.previous = &previous[0];
+
+    // A single range stays on the calling thread without asking the runtime for a slot.
+    if (ranges == 1) aes256_cbc_decrypt_chunk(&batch, 0);
+    else task_parallel_for(TaskLane_Bulk, ranges, ranges, NULL, aes256_cbc_decrypt_chunk, &batch);
+}
+
+static inline uint64_t aes256_load64(const byte* p)
+{
+    uint64_t x = 0;
+
+    for (int32_t i = 0; i < 8; i++)
+    {
+        x = (x << 8) | p[i];
+    }
+
+    return x;
+}
+
+static inline void aes256_store64(byte* p, uint64_t x)
+{
+    for (int32_t i = 7; i >= 0; i--)
+    {
+        p[i] = (byte)x;
+        x >>= 8;
+    }
+}
+
+struct Aes256_Counter
+{
+    uint64_t high;
+    uint64_t low;
+
+    void add(uint64_t n)
+    {
+        uint64_t t = low + n;
+        if (t < low) high++;
+        low = t;
+    }
+
+    __m128i block() const
+    {
+        byte b[blockSize];
+        aes256_store64(b, high);
+        aes256_store64(b + 8, low);
+
+        return _mm_loadu_si128((const __m128i*)b);
+    }
+};
+
+static void aes256_ctr_range(const byte* schedule, Aes256_Counter counter, byte* buffer, int32_t length)
+{
+    const Aes256_Keys keys(schedule);
+
+    __m128i* p = (__m128i*)buffer;
+
+    for (; length >= 8 * blockSize; length -= 8 * blockSize, p += 8)
+    {
+        __m128i x0 = counter.block(); counter.add(1);
+        __m128i x1 = counter.block(); counter.add(1);
+        __m128i x2 = counter.block(); counter.add(1);
+        __m128i x3 = counter.block(); counter.add(1);
+        __m128i x4 = counter.block(); counter.add(1);
+        __m128i x5 = counter.block(); counter.add(1);
+        __m128i x6 = counter.block(); counter.add(1);
+        __m128i x7 = counter.block(); counter.add(1);
+
+        AES256_XOR8(keys.k[0]);
+
+        for (int32_t r = 1; r < rounds; r++)
+        {
+            AES256_ROUND8(_mm_aesenc_si128, keys.k[r]);
+        }
+
+        AES256_ROUND8(_mm_aesenclast_si128, keys.k[rounds]);
+
+        _mm_storeu_si128(p + 0, _mm_xor_si128(x0, _mm_loadu_si128(p + 0)));
+        _mm_storeu_si128(p + 1, _mm_xor_si128(x1, _mm_loadu_si128(p + 1)));
+        _mm_storeu_si128(p + 2, _mm_xor_si128(x2, _mm_loadu_si128(p + 2)));
+        _mm_storeu_si128(p + 3, _mm_xor_si128(x3, _mm_loadu_si128(p + 3)));
+        _mm_storeu_si128(p + 4, _mm_xor_si128(x4, _mm_loadu_si128(p + 4)));
+        _mm_storeu_si128(p + 5, _mm_xor_si128(x5, _mm_loadu_si128(p + 5)));
+        _mm_storeu_si128(p + 6, _mm_xor_si128(x6, _mm_loadu_si128(p + 6)));
+        _mm_storeu_si128(p + 7, _mm_xor_si128(x7, _mm_loadu_si128(p + 7)));
+    }
+
+    for (; length >= blockSize; length -= blockSize, p++)
+    {
+        __m128i x = aes256_encrypt_block(keys, counter.block());
+        counter.add(1);
+
+        _mm_storeu_si128(p, _mm_xor_si128(x, _mm_loadu_si128(p)));
+    }
+
+    if (length > 0)
+    {
+        byte key[blockSize];
+        _mm_storeu_si128((__m128i*)key, aes256_encrypt_block(keys, counter.block()));
+
+        byte* q = (byte*)p;
+
+        for (int32_t i = 0; i < length; i++)
+        {
+            q[i] ^= key[i];
+        }
+    }
+}
+
+struct Aes256_CtrBatch
+{
+    const byte* schedule;
+    Aes256_Counter start;
+    byte* buffer;
+    int32_t length;
+    int32_t chunk;
+};
+
+static void aes256_ctr_chunk(void* context, int32_t index)
+{
+    Aes256_CtrBatch* batch = (Aes256_CtrBatch*)context;
+
+    int32_t offset = index * batch->chunk;
+
+    Aes256_Counter c = batch->start;
+    c.add((uint64_t)offset);
+
+    int32_t size = batch->length - (offset * blockSize);
+    if (size > batch->chunk * blockSize) size = batch->chunk * blockSize;
+
+    aes256_ctr_range(batch->schedule, c, batch->buffer + (offset * blockSize), size);
+}
+
+void aes256_ctr(void* context, byte* counter, byte* buffer, int32_t length, int32_t threads)
+{
+    const byte* schedule = ((Aes256_Context*)context)->encrypt;
+
+    Aes256_Counter start;
+    start.high = aes256_load64(counter);
+    start.low = aes256_load64(counter + 8);
+
+    int32_t blocks = (length + blockSize - 1) / blockSize;
+    int32_t chunk = aes256_split(blocks, threads);
+
+    if (blocks > 0)
+    {
+        Aes256_CtrBatch batch;
+        batch.schedule = schedule;
+        batch.start = start;
+        batch.buffer = buffer;
+        batch.length = length;
+        batch.chunk = chunk;
+
+        int32_t ranges = (blocks + chunk - 1) / chunk;
+
+        if (ranges == 1) aes256_ctr_chunk(&batch, 0);
+        else task_parallel_for(TaskLane_Bulk, ranges, ranges, NULL, aes256_ctr_chunk, &batch);
+    }
+
+    start.add((uint64_t)blocks);
+    aes256_store64(counter, start.high);
+    aes256_store64(counter + 8, start.low);
+}
+
+int32_t aes256_cbc_hmac_sha256_encrypt(void* context, byte* iv, byte* hmacKey, int32_t hmacKeyLength, byte* buffer, int32_t headerLength, int32_t length)
+{
+    const Aes256_Keys keys(((Aes256_Context*)context)->encrypt);
+
+    byte* data = buffer + headerLength;
+
+    int32_t padding = blockSize - (length % blockSize);
+    memset(data + length, padding, padding);
+    length += padding;
+
+    HmacSha256_Context hmac;
+    hmac_sha256_initialize(&hmac, hmacKey, hmacKeyLength);
+    hmac_sha256_update(&hmac, buffer, headerLength);
+
+    __m128i x = _mm_loadu_si128((const __m128i*)iv);
+
+    for (int32_t offset = 0; offset < length; offset += tileSize)
+    {
+        int32_t count = (length - offset < tileSize) ? length - offset : tileSize;
+
+        for (int32_t i = offset; i < offset + count; i += blockSize)
+        {
+            x = aes256_encrypt_block(keys, _mm_xor_si128(x, _mm_loadu_si128((const __m128i*)(data + i))));
+            _mm_storeu_si128((__m128i*)(data + i), x);
+        }
+
+        hmac_sha256_update(&hmac, data + offset, count);
+    }
+
+    hmac_sha256_finalize(&hmac, data + length);
+
+    return length;
+}
+
+int32_t aes256_cbc_hmac_sha256_decrypt(void* context, byte* iv, byte* hmacKey, int32_t hmacKeyLength, byte* buffer, int32_t headerLength, int32_t length)
+{
+    const byte* schedule = ((Aes256_Context*)context)->decrypt;
+
+    if (length <= 0 || (length % blockSize) != 0) return -1;
+
+    byte* data = buffer + headerLength;
+
+    HmacSha256_Context hmac;
+    hmac_sha256_initialize(&hmac, hmacKey, hmacKeyLength);
+    hmac_sha256_update(&hmac, buffer, headerLength);
+
+    byte previous[blockSize];
+    memcpy(previous, iv, blockSize);
+
+    // The ciphertext of a tile is hashed before it is decrypted over. Nothing is returned to the caller
+    // until the MAC has been compared, so the early decryption is never observable.
+    for (int32_t offset = 0; offset < length; offset += tileSize)
+    {
+        int32_t count = (length - offset < tileSize) ? length - offset : tileSize;
+
+        hmac_sha256_update(&hmac, data + offset, count);
+
+        byte last[blockSize];
+        memcpy(last, data + offset + count - blockSize, blockSize);
+
+        aes256_cbc_decrypt_range(schedule, previous, data + offset, count / blockSize);
+
+        memcpy(previous, last, blockSize);
+    }
+
+    byte mac[macSize];
+    hmac_sha256_finalize(&hmac, mac);
+
+    // Constant time, so the comparison does not tell how many bytes of the MAC were right.
+    byte difference = 0;
+
+    for (int32_t i = 0; i < macSize; i++)
+    {
+        difference |= mac[i] ^ data[length + i];
+    }
+
+    if (difference != 0) return -1;
+
+    int32_t padding = data[length - 1];
+    if (padding < 1 || padding > blockSize) return -1;
+
+    for (int32_t i = length - padding; i < length; i++)
+    {
+        if (data[i] != padding) return -1;
+    }
+
+    return length - padding;
+}
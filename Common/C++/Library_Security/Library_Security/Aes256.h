@@ -0,0 +1,23 @@
+#pragma once
+
+// AES-256 with AES-NI. All functions work in place on the caller's buffer.
+// aes256_create returns NULL when the CPU has no AES-NI.
+void* aes256_create(byte* key);
+void aes256_free(void* context);
+
+// length must be a multiple of 16. iv is updated so that consecutive calls continue one stream.
+void aes256_cbc_encrypt(void* context, byte* iv, byte* buffer, int32_t length);
+void aes256_cbc_decrypt(void* context, byte* iv, byte* buffer, int32_t length, int32_t threads);
+
+// counter is a 128 bit big-endian block counter and is advanced by the number of blocks used.
+// Only the last call of a stream may have a length that is not a multiple of 16.
+void aes256_ctr(void* context, byte* counter, byte* buffer, int32_t length, int32_t threads);
+
+// Encrypt-then-MAC record. buffer holds headerLength bytes that are only authenticated, followed by length bytes of plaintext.
+// The plaintext is padded (PKCS7) and encrypted with CBC in place, and HMAC-SHA256 over header and ciphertext is written after it.
+// buffer needs room for headerLength + length + 16 + 32 bytes. Returns the ciphertext length.
+int32_t aes256_cbc_hmac_sha256_encrypt(void* context, byte* iv, byte* hmacKey, int32_t hmacKeyLength, byte* buffer, int32_t headerLength, int32_t length);
+
+// Verifies and decrypts a record made by aes256_cbc_hmac_sha256_encrypt. length is the ciphertext length, the MAC follows it.
+// Returns the plaintext length, or -1 when the MAC or the padding is wrong. The buffer content is undefined in that case.
+int32_t aes256_cbc_hmac_sha256_decrypt(void* context, byte* iv, byte* hmacKey, int32_t hmacKeyLength, byte* buffer, int32_t headerLength, int32_t length);
@@ -1,5 +1,8 @@
 #include "stdafx.h"
 #include "Crc32_Castagnoli.h"
+#include "..\..\Library\Library\Stats.h"
+
+static const int32_t statsCrc32 = stats_register("compute_Crc32_Castagnoli");
 
 Crc32_Castagnoli::Crc32_Castagnoli()
 {
@@ -42,5 +45,7 @@ uint32_t Crc32_Castagnoli::compute(uint32_t x, byte* source, int32_t length) con
 
 uint32_t compute_Crc32_Castagnoli(uint32_t x, byte* source, int32_t length)
 {
+    StatsScope stats(statsCrc32, StatsTier_Scalar, length);
+
     return _crc32_castagnoli.compute(x, source, length);
 }
@@ -0,0 +1,46 @@
+#include "stdafx.h"
+#include "HmacSha256.h"
+
+const int32_t blockSize = 64;
+const int32_t hashSize = 32;
+
+void hmac_sha256_initialize(HmacSha256_Context* context, const byte* key, int32_t keyLength)
+{
+    byte block[blockSize] = { 0 };
+
+    if (keyLength > blockSize)
+    {
+        Sha256_Context t;
+        sha256_initialize(&t);
+        sha256_update(&t, key, keyLength);
+        sha256_finalize(&t, block);
+    }
+    else
+    {
+        memcpy(block, key, keyLength);
+    }
+
+    byte pad[blockSize];
+
+    for (int32_t i = 0; i < blockSize; i++) pad[i] = block[i] ^ 0x36;
+    sha256_initialize(&context->inner);
+    sha256_update(&context->inner, pad, blockSize);
+
+    for (int32_t i = 0; i < blockSize; i++) pad[i] = block[i] ^ 0x5C;
+    sha256_initialize(&context->outer);
+    sha256_update(&context->outer, pad, blockSize);
+}
+
+void hmac_sha256_update(HmacSha256_Context* context, const byte* source, int32_t length)
+{
+    sha256_update(&context->inner, source, length);
+}
+
+void hmac_sha256_finalize(HmacSha256_Context* context, byte* digest)
+{
+    byte hash[hashSize];
+    sha256_finalize(&context->inner, hash);
+
+    sha256_update(&context->outer, hash, hashSize);
+    sha256_finalize(&context->outer, digest);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Sha256.h"
+
+// HMAC-SHA256 for the other units of this library. Not exported.
+// The key is absorbed once by initialize, so a context can be copied to MAC many messages with the same key.
+struct HmacSha256_Context
+{
+    Sha256_Context inner;
+    Sha256_Context outer;
+};
+
+void hmac_sha256_initialize(HmacSha256_Context* context, const byte* key, int32_t keyLength);
+void hmac_sha256_update(HmacSha256_Context* context, const byte* source, int32_t length);
+void hmac_sha256_finalize(HmacSha256_Context* context, byte* digest);
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+#include "Pbkdf2.h"
+#include "HmacSha256.h"
+
+const int32_t blockSize = 64;
+const int32_t hashSize = 32;
+
+// After the key block, every iteration hashes a single 32 byte digest, so both the inner and the outer hash
+// are one compression of the same fixed block: digest, 0x80, zeros and the bit length (64 + 32) * 8.
+const uint32_t digestBits = (blockSize + hashSize) * 8;
+
+static inline uint32_t pbkdf2_load_be(const byte* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void pbkdf2_store_be(byte* p, uint32_t x)
+{
+    p[0] = (byte)(x >> 24);
+    p[1] = (byte)(x >> 16);
+    p[2] = (byte)(x >> 8);
+    p[3] = (byte)x;
+}
+
+// U1 = HMAC(password, salt || INT(index))
+static void pbkdf2_first(const HmacSha256_Context* key, const byte* salt, int32_t saltLength, uint32_t index, byte* u)
+{
+    HmacSha256_Context context = *key;
+
+    byte count[4];
+    pbkdf2_store_be(count, index);
+
+    hmac_sha256_update(&context, salt, saltLength);
+    hmac_sha256_update(&context, count, 4);
+    hmac_sha256_finalize(&context, u);
+}
+
+static void pbkdf2_block(const HmacSha256_Context* key, const byte* salt, int32_t saltLength, int32_t iterations, uint32_t index, byte* result)
+{
+    byte block[blockSize] = { 0 };
+    block[hashSize] = 0x80;
+    pbkdf2_store_be(block + blockSize - 4, digestBits);
+
+    pbkdf2_first(key, salt, saltLength, index, block);
+    memcpy(result, block, hashSize);
+
+    for (int32_t i = 1; i < iterations; i++)
+    {
+        uint32_t state[8];
+
+        memcpy(state, key->inner.state, sizeof(state));
+        sha256_blocks(state, block, 1);
+
+        for (int32_t t = 0; t < 8; t++) pbkdf2_store_be(block + (t * 4), state[t]);
+
+        memcpy(state, key->outer.state, sizeof(state));
+        sha256_blocks(state, block, 1);
+
+        for (int32_t t = 0; t < 8; t++)
+        {
+            pbkdf2_store_be(block + (t * 4), state[t]);
+
+            result[(t * 4) + 0] ^= block[(t * 4) + 0];
+            result[(t * 4) + 1] ^= block[(t * 4) + 1];
+            result[(t * 4) + 2] ^= block[(t * 4) + 2];
+            result[(t * 4) + 3] ^= block[(t * 4) + 3];
+        }
+    }
+}
+
+// Up to 8 output blocks, each chain in its own lane. The chains stay in words for the whole run.
+static void pbkdf2_block8(const HmacSha256_Context* key, const byte* salt, int32_t saltLength, int32_t iterations, uint32_t index, int32_t blocks, byte* result)
+{
+    uint32_t words[16 * 8] = { 0 };
+    uint32_t states[8 * 8];
+    uint32_t sums[8 * 8] = { 0 };
+
+    for (int32_t lane = 0; lane < 8; lane++)
+    {
+        byte u[hashSize] = { 0 };
+        if (lane < blocks) pbkdf2_first(key, salt, saltLength, index + lane, u);
+
+        for (int32_t t = 0; t < 8; t++)
+        {
+            words[(t * 8) + lane] = pbkdf2_load_be(u + (t * 4));
+            sums[(t * 8) + lane] = words[(t * 8) + lane];
+        }
+
+        words[(8 * 8) + lane] = 0x80000000;
+        words[(15 * 8) + lane] = digestBits;
+    }
+
+    for (int32_t i = 1; i < iterations; i++)
+    {
+        for (int32_t t = 0; t < 8; t++)
+        {
+            for (int32_t lane = 0; lane < 8; lane++) states[(t * 8) + lane] = key->inner.state[t];
+        }
+
+        sha256_compress8(words, states);
+        memcpy(words, states, sizeof(states));
+
+        for (int32_t t = 0; t < 8; t++)
+        {
+            for (int32_t lane = 0; lane < 8; lane++) states[(t * 8) + lane] = key->outer.state[t];
+        }
+
+        sha256_compress8(words, states);
+        memcpy(words, states, sizeof(states));
+
+        for (int32_t j = 0; j < 8 * 8; j++)
+        {
+            sums[j] ^= states[j];
+        }
+    }
+
+    for (int32_t lane = 0; lane < blocks; lane++)
+    {
+        for (int32_t t = 0; t < 8; t++)
+        {
+            pbkdf2_store_be(result + (lane * hashSize) + (t * 4), sums[(t * 8) + lane]);
+        }
+    }
+}
+
+void pbkdf2_hmac_sha256(byte* password, int32_t passwordLength, byte* salt, int32_t saltLength, int32_t iterations, uint32_t index, int32_t blocks, byte* result)
+{
+    // The pad states are computed once and shared by every block and iteration.
+    HmacSha256_Context key;
+    hmac_sha256_initialize(&key, password, passwordLength);
+
+    if (sha256_lanes() == 8 && blocks > 1)
+    {
+        for (int32_t i = 0; i < blocks; i += 8)
+        {
+            int32_t count = (blocks - i < 8) ? blocks - i : 8;
+
+            pbkdf2_block8(&key, salt, saltLength, iterations, index + i, count, result + (i * hashSize));
+        }
+    }
+    else
+    {
+        for (int32_t i = 0; i < blocks; i++)
+        {
+            pbkdf2_block(&key, salt, saltLength, iterations, index + i, result + (i * hashSize));
+        }
+    }
+}
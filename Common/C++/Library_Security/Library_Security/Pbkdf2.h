@@ -0,0 +1,4 @@
+#pragma once
+
+// PBKDF2-HMAC-SHA256. Computes output blocks index .. index + blocks - 1 (32 bytes each, index starts at 1) into result.
+void pbkdf2_hmac_sha256(byte* password, int32_t passwordLength, byte* salt, int32_t saltLength, int32_t iterations, uint32_t index, int32_t blocks, byte* result);
@@ -0,0 +1,627 @@
+#include "stdafx.h"
+#include "Sha256.h"
+#include "..\..\Library\Library\Stats.h"
+#include "..\..\Library\Library\TaskRuntime.h"
+
+#include <intrin.h>
+
+#include "emmintrin.h" //SSE2
+#include "immintrin.h" //AVX2, SHA
+
+#include <thread>
+#include <vector>
+
+// The SHA extension intrinsics are only declared by newer compilers.
+#if (defined(_MSC_VER) && _MSC_VER >= 1900) || defined(__SHA__)
+#define SHA256_SHANI
+#endif
+
+static const uint32_t K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H[8] =
+{
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const int32_t blockSize = 64;
+const int32_t hashSize = 32;
+
+enum Sha256_Kernel
+{
+    Sha256_Scalar,
+    Sha256_Avx2,
+    Sha256_ShaNi,
+};
+
+inline uint32_t load_be(const byte* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+inline void store_be(byte* p, uint32_t x)
+{
+    p[0] = (byte)(x >> 24);
+    p[1] = (byte)(x >> 16);
+    p[2] = (byte)(x >> 8);
+    p[3] = (byte)x;
+}
+
+// The message tail: the last partial block, 0x80, zeros and the bit length. One or two blocks.
+int32_t sha256_tail(const byte* source, int32_t length, byte* tail)
+{
+    int32_t remain = length % blockSize;
+    int32_t blocks = (remain + 9 > blockSize) ? 2 : 1;
+
+    memcpy(tail, source + (length - remain), remain);
+    tail[remain] = 0x80;
+    memset(tail + remain + 1, 0, (blocks * blockSize) - remain - 1);
+
+    uint64_t bits = (uint64_t)length * 8;
+    store_be(tail + (blocks * blockSize) - 8, (uint32_t)(bits >> 32));
+    store_be(tail + (blocks * blockSize) - 4, (uint32_t)bits);
+
+    return blocks;
+}
+
+struct Lanes1
+{
+    typedef uint32_t type;
+    enum { count = 1 };
+
+    static __forceinline type load(const uint32_t* p) { return *p; }
+    static __forceinline void store(uint32_t* p, type x) { *p = x; }
+    static __forceinline type set1(uint32_t x) { return x; }
+    static __forceinline type add(type a, type b) { return a + b; }
+    static __forceinline type xor3(type a, type b, type c) { return a ^ b ^ c; }
+    static __forceinline type rotr(type x, int32_t n) { return (x >> n) | (x << (32 - n)); }
+    static __forceinline type shr(type x, int32_t n) { return x >> n; }
+    static __forceinline type ch(type e, type f, type g) { return (e & f) ^ (~e & g); }
+    static __forceinline type maj(type a, type b, type c) { return (a & b) | (c & (a | b)); }
+};
+
+struct Lanes8
+{
+    typedef __m256i type;
+    enum { count = 8 };
+
+    static __forceinline type load(const uint32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    static __forceinline void store(uint32_t* p, type x) { _mm256_storeu_si256((__m256i*)p, x); }
+    static __forceinline type set1(uint32_t x) { return _mm256_set1_epi32((int)x); }
+    static __forceinline type add(type a, type b) { return _mm256_add_epi32(a, b); }
+    static __forceinline type xor3(type a, type b, type c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+    static __forceinline type rotr(type x, int32_t n) { return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n)); }
+    static __forceinline type shr(type x, int32_t n) { return _mm256_srli_epi32(x, n); }
+    static __forceinline type ch(type e, type f, type g) { return _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g)); }
+    static __forceinline type maj(type a, type b, type c) { return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b))); }
+};
+
+#define SHA256_ROUND(L, a, b, c, d, e, f, g, h, kw) \
+    { \
+        typename L::type t1 = L::add(L::add(L::add(h, L::xor3(L::rotr(e, 6), L::rotr(e, 11), L::rotr(e, 25))), L::ch(e, f, g)), kw); \
+        typename L::type t2 = L::add(L::xor3(L::rotr(a, 2), L::rotr(a, 13), L::rotr(a, 22)), L::maj(a, b, c)); \
+        d = L::add(d, t1); \
+        h = L::add(t1, t2); \
+    }
+
+// One block per lane.
+// words:  16 * lanes message words, word-major (words[t * lanes + lane])
+// states: 8 * lanes state words, word-major, updated in place
+template<class L>
+__forceinline void sha256_compress(const uint32_t* words, uint32_t* states)
+{
+    typedef typename L::type T;
+
+    T w[16];
+
+    for (int32_t t = 0; t < 16; t++)
+    {
+        w[t] = L::load(words + (t * L::count));
+    }
+
+    T a = L::load(states + (0 * L::count));
+    T b = L::load(states + (1 * L::count));
+    T c = L::load(states + (2 * L::count));
+    T d = L::load(states + (3 * L::count));
+    T e = L::load(states + (4 * L::count));
+    T f = L::load(states + (5 * L::count));
+    T g = L::load(states + (6 * L::count));
+    T h = L::load(states + (7 * L::count));
+
+    for (int32_t t = 0; t < 64; t += 8)
+    {
+        if (t >= 16)
+        {
+            for (int32_t i = 0; i < 8; i++)
+            {
+                int32_t j = (t + i) & 15;
+
+                T w15 = w[(t + i - 15) & 15];
+                T w2 = w[(t + i - 2) & 15];
+
+                T s0 = L::xor3(L::rotr(w15, 7), L::rotr(w15, 18), L::shr(w15, 3));
+                T s1 = L::xor3(L::rotr(w2, 17), L::rotr(w2, 19), L::shr(w2, 10));
+
+                w[j] = L::add(L::add(w[j], s0), L::add(w[(t + i - 7) & 15], s1));
+            }
+        }
+
+        SHA256_ROUND(L, a, b, c, d, e, f, g, h, L::add(w[(t + 0) & 15], L::set1(K[t + 0])));
+        SHA256_ROUND(L, h, a, b, c, d, e, f, g, L::add(w[(t + 1) & 15], L::set1(K[t + 1])));
+        SHA256_ROUND(L, g, h, a, b, c, d, e, f, L::add(w[(t + 2) & 15], L::set1(K[t + 2])));
+        SHA256_ROUND(L, f, g, h, a, b, c, d, e, L::add(w[(t + 3) & 15], L::set1(K[t + 3])));
+        SHA256_ROUND(L, e, f, g, h, a, b, c, d, L::add(w[(t + 4) & 15], L::set1(K[t + 4])));
+        SHA256_ROUND(L, d, e, f, g, h, a, b, c, L::add(w[(t + 5) & 15], L::set1(K[t + 5])));
+        SHA256_ROUND(L, c, d, e, f, g, h, a, b, L::add(w[(t + 6) & 15], L::set1(K[t + 6])));
+        SHA256_ROUND(L, b, c, d, e, f, g, h, a, L::add(w[(t + 7) & 15], L::set1(K[t + 7])));
+    }
+
+    L::store(states + (0 * L::count), L::add(L::load(states + (0 * L::count)), a));
+    L::store(states + (1 * L::count), L::add(L::load(states + (1 * L::count)), b));
+    L::store(states + (2 * L::count), L::add(L::load(states + (2 * L::count)), c));
+    L::store(states + (3 * L::count), L::add(L::load(states + (3 * L::count)), d));
+    L::store(states + (4 * L::count), L::add(L::load(states + (4 * L::count)), e));
+    L::store(states + (5 * L::count), L::add(L::load(states + (5 * L::count)), f));
+    L::store(states + (6 * L::count), L::add(L::load(states + (6 * L::count)), g));
+    L::store(states + (7 * L::count), L::add(L::load(states + (7 * L::count)), h));
+}
+
+void sha256_blocks_scalar(uint32_t* state, const byte* source, int32_t blocks)
+{
+    uint32_t words[16];
+
+    for (int32_t i = 0; i < blocks; i++, source += blockSize)
+    {
+        for (int32_t t = 0; t < 16; t++)
+        {
+            words[t] = load_be(source + (t * 4));
+        }
+
+        sha256_compress<Lanes1>(words, state);
+    }
+}
+
+#ifdef SHA256_SHANI
+
+// Next four schedule words from the previous sixteen (w0 is the oldest group).
+static __forceinline __m128i sha256_shani_schedule(__m128i w0, __m128i w1, __m128i w2, __m128i w3)
+{
+    return _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4)), w3);
+}
+
+static __forceinline void sha256_shani_rounds(__m128i& state0, __m128i& state1, __m128i w, int32_t r)
+{
+    __m128i kw = _mm_add_epi32(w, _mm_loadu_si128((const __m128i*)&K[r * 4]));
+
+    state1 = _mm_sha256rnds2_epu32(state1, state0, kw);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(kw, 0x0E));
+}
+
+void sha256_blocks_shani(uint32_t* state, const byte* source, int32_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The instructions keep the state as ABEF and CDGH.
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (int32_t i = 0; i < blocks; i++, source += blockSize)
+    {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+
+        __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 0)), mask);
+        __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 16)), mask);
+        __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 32)), mask);
+        __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(source + 48)), mask);
+
+        sha256_shani_rounds(state0, state1, w0, 0);
+        sha256_shani_rounds(state0, state1, w1, 1);
+        sha256_shani_rounds(state0, state1, w2, 2);
+        sha256_shani_rounds(state0, state1, w3, 3);
+
+        for (int32_t r = 4; r < 16; r += 4)
+        {
+            w0 = sha256_shani_schedule(w0, w1, w2, w3);
+            sha256_shani_rounds(state0, state1, w0, r + 0);
+            w1 = sha256_shani_schedule(w1, w2, w3, w0);
+            sha256_shani_rounds(state0, state1, w1, r + 1);
+            w2 = sha256_shani_schedule(w2, w3, w0, w1);
+            sha256_shani_rounds(state0, state1, w2, r + 2);
+            w3 = sha256_shani_schedule(w3, w0, w1, w2);
+            sha256_shani_rounds(state0, state1, w3, r + 3);
+        }
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#endif
+
+template<void (*Blocks)(uint32_t*, const byte*, int32_t)>
+void sha256_one(const byte* source, int32_t length, byte* digest)
+{
+    uint32_t state[8];
+    memcpy(state, H, sizeof(state));
+
+    byte tail[blockSize * 2];
+    int32_t tailBlocks = sha256_tail(source, length, tail);
+
+    Blocks(state, source, length / blockSize);
+    Blocks(state, tail, tailBlocks);
+
+    for (int32_t t = 0; t < 8; t++)
+    {
+        store_be(digest + (t * 4), state[t]);
+    }
+}
+
+struct Sha256_Lane
+{
+    int32_t index;
+    const byte* source;
+    int32_t blocks;
+    int32_t tailBlocks;
+    const byte* tailSource;
+    byte tail[blockSize * 2];
+};
+
+// Eight messages are hashed side by side, one block each per step.
+// A lane that finishes its message picks up the next one, so messages of any length mix well.
+void sha256_many_avx2(byte** sources, int32_t* lengths, int32_t count, byte* digests)
+{
+    static const byte zero[blockSize] = { 0 };
+
+    Sha256_Lane lanes[8];
+
+    uint32_t words[16 * 8];
+    uint32_t states[8 * 8];
+
+    int32_t next = 0;
+    int32_t active = 0;
+
+    for (int32_t lane = 0; lane < 8; lane++)
+    {
+        lanes[lane].index = -1;
+    }
+
+    for (;;)
+    {
+        for (int32_t lane = 0; lane < 8; lane++)
+        {
+            Sha256_Lane& l = lanes[lane];
+
+            if (l.index == -1 && next < count)
+            {
+                l.index = next++;
+                l.source = sources[l.index];
+                l.blocks = lengths[l.index] / blockSize;
+                l.tailBlocks = sha256_tail(l.source, lengths[l.index], l.tail);
+                l.tailSource = l.tail;
+
+                for (int32_t t = 0; t < 8; t++)
+                {
+                    states[(t * 8) + lane] = H[t];
+                }
+
+                active++;
+            }
+        }
+
+        if (active == 0) break;
+
+        for (int32_t lane = 0; lane < 8; lane++)
+        {
+            Sha256_Lane& l = lanes[lane];
+
+            const byte* p;
+
+            if (l.index == -1) p = zero;
+            else if (l.blocks > 0) p = l.source;
+            else p = l.tailSource;
+
+            for (int32_t t = 0; t < 16; t++)
+            {
+                words[(t * 8) + lane] = load_be(p + (t * 4));
+            }
+        }
+
+        sha256_compress<Lanes8>(words, states);
+
+        for (int32_t lane = 0; lane < 8; lane++)
+        {
+            Sha256_Lane& l = lanes[lane];
+
+            if (l.index == -1) continue;
+
+            if (l.blocks > 0)
+            {
+                l.source += blockSize;
+                l.blocks--;
+
+                continue;
+            }
+
+            l.tailSource += blockSize;
+            if (--l.tailBlocks > 0) continue;
+
+            for (int32_t t = 0; t < 8; t++)
+            {
+                store_be(digests + (l.index * hashSize) + (t * 4), states[(t * 8) + lane]);
+            }
+
+            l.index = -1;
+            active--;
+        }
+    }
+}
+
+static Sha256_Kernel sha256_detect()
+{
+    int32_t info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7) return Sha256_Scalar;
+
+    __cpuidex(info, 7, 0);
+    bool avx2 = (info[1] & (1 << 5)) != 0;
+
+#ifdef SHA256_SHANI
+    bool sha = (info[1] & (1 << 29)) != 0;
+    if (sha) return Sha256_ShaNi;
+#endif
+
+    if (!avx2) return Sha256_Scalar;
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx) return Sha256_Scalar;
+
+    // The OS must save the YMM registers.
+    if ((_xgetbv(0) & 0x6) != 0x6) return Sha256_Scalar;
+
+    return Sha256_Avx2;
+}
+
+static Sha256_Kernel sha256_kernel()
+{
+    static const Sha256_Kernel kernel = sha256_detect();
+
+    return kernel;
+}
+
+static const int32_t statsSha256 = stats_register("sha256");
+
+static StatsTier sha256_tier()
+{
+    switch (sha256_kernel())
+    {
+    case Sha256_ShaNi: return StatsTier_Sha;
+    case Sha256_Avx2: return StatsTier_Avx2;
+    default: return StatsTier_Scalar;
+    }
+}
+
+// Runs on each range of sha256_many and sha256_verify_many.
+void sha256_range(byte** sources, int32_t* lengths, int32_t count, byte* digests)
+{
+    int64_t bytes = 0;
+
+    if (stats_enabled)
+    {
+        for (int32_t i = 0; i < count; i++) bytes += lengths[i];
+    }
+
+    StatsScope stats(statsSha256, sha256_tier(), bytes);
+
+    switch (sha256_kernel())
+    {
+#ifdef SHA256_SHANI
+    case Sha256_ShaNi:
+        for (int32_t i = 0; i < count; i++)
+        {
+            sha256_one<sha256_blocks_shani>(sources[i], lengths[i], digests + (i * hashSize));
+        }
+        break;
+#endif
+    case Sha256_Avx2:
+        sha256_many_avx2(sources, lengths, count, digests);
+        break;
+    default:
+        for (int32_t i = 0; i < count; i++)
+        {
+            sha256_one<sha256_blocks_scalar>(sources[i], lengths[i], digests + (i * hashSize));
+        }
+        break;
+    }
+}
+
+struct Sha256_Batch
+{
+    byte** sources;
+    int32_t* lengths;
+    byte* digests;
+    // Range i covers [offsets[i], offsets[i + 1]).
+    std::vector<int32_t> offsets;
+};
+
+static void sha256_batch_range(void* context, int32_t index)
+{
+    Sha256_Batch* batch = (Sha256_Batch*)context;
+
+    int32_t offset = batch->offsets[index];
+    int32_t count = batch->offsets[index + 1] - offset;
+
+    sha256_range(batch->sources + offset, batch->lengths + offset, count, batch->digests + (offset * hashSize));
+}
+
+void sha256_many(byte** sources, int32_t* lengths, int32_t count, byte* digests, int32_t threads)
+{
+    // Below this many bytes per thread, starting a thread costs more than it saves.
+    const int64_t minimum = 1024 * 1024;
+
+    int64_t total = 0;
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        total += lengths[i];
+    }
+
+    if (threads <= 0) threads = (int32_t)std::thread::hardware_concurrency();
+    if (threads > total / minimum) threads = (int32_t)(total / minimum);
+    if (threads > count) threads = count;
+    if (threads <= 1)
+    {
+        sha256_range(sources, lengths, count, digests);
+
+        return;
+    }
+
+    // Split by bytes rather than by count, so a few large buffers do not end up on one thread.
+    int64_t chunk = (total + threads - 1) / threads;
+
+    Sha256_Batch batch;
+    batch.sources = sources;
+    batch.lengths = lengths;
+    batch.digests = digests;
+    batch.offsets.push_back(0);
+
+    int64_t sum = 0;
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        sum += lengths[i];
+
+        if (sum >= chunk && (i + 1) < count)
+        {
+            batch.offsets.push_back(i + 1);
+            sum = 0;
+        }
+    }
+
+    batch.offsets.push_back(count);
+
+    task_parallel_for(TaskLane_Bulk, (int32_t)batch.offsets.size() - 1, threads, NULL, sha256_batch_range, &batch);
+}
+
+int32_t sha256_verify_many(byte** sources, int32_t* lengths, int32_t count, byte* hashes, byte* results, int32_t threads)
+{
+    std::vector<byte> digests(count * hashSize);
+    if (count > 0) sha256_many(sources, lengths, count, &digests[0], threads);
+
+    memset(results, 0, (count + 7) / 8);
+
+    int32_t matches = 0;
+
+    for (int32_t i = 0; i < count; i++)
+    {
+        if (memcmp(&digests[i * hashSize], hashes + (i * hashSize), hashSize) != 0) continue;
+
+        results[i / 8] |= (byte)(1 << (i % 8));
+        matches++;
+    }
+
+    return matches;
+}
+
+int32_t sha256_lanes()
+{
+    return (sha256_kernel() == Sha256_Avx2) ? 8 : 1;
+}
+
+void sha256_compress8(const uint32_t* words, uint32_t* states)
+{
+    sha256_compress<Lanes8>(words, states);
+}
+
+void sha256_blocks(uint32_t* state, const byte* source, int32_t blocks)
+{
+#ifdef SHA256_SHANI
+    if (sha256_kernel() == Sha256_ShaNi)
+    {
+        sha256_blocks_shani(state, source, blocks);
+        return;
+    }
+#endif
+
+    sha256_blocks_scalar(state, source, blocks);
+}
+
+void sha256_initialize(Sha256_Context* context)
+{
+    memcpy(context->state, H, sizeof(context->state));
+    context->bufferLength = 0;
+    context->length = 0;
+}
+
+void sha256_update(Sha256_Context* context, const byte* source, int32_t length)
+{
+    context->length += length;
+
+    if (context->bufferLength > 0)
+    {
+        int32_t count = (blockSize - context->bufferLength < length) ? blockSize - context->bufferLength : length;
+        memcpy(context->buffer + context->bufferLength, source, count);
+        context->bufferLength += count;
+        source += count;
+        length -= count;
+
+        if (context->bufferLength < blockSize) return;
+
+        sha256_blocks(context->state, context->buffer, 1);
+        context->bufferLength = 0;
+    }
+
+    int32_t blocks = length / blockSize;
+
+    if (blocks > 0)
+    {
+        sha256_blocks(context->state, source, blocks);
+        source += blocks * blockSize;
+        length -= blocks * blockSize;
+    }
+
+    memcpy(context->buffer, source, length);
+    context->bufferLength = length;
+}
+
+void sha256_finalize(Sha256_Context* context, byte* digest)
+{
+    int32_t remain = context->bufferLength;
+    int32_t blocks = (remain + 9 > blockSize) ? 2 : 1;
+
+    byte tail[blockSize * 2];
+    memcpy(tail, context->buffer, remain);
+    tail[remain] = 0x80;
+    memset(tail + remain + 1, 0, (blocks * blockSize) - remain - 1);
+
+    uint64_t bits = context->length * 8;
+    store_be(tail + (blocks * blockSize) - 8, (uint32_t)(bits >> 32));
+    store_be(tail + (blocks * blockSize) - 4, (uint32_t)bits);
+
+    sha256_blocks(context->state, tail, blocks);
+
+    for (int32_t t = 0; t < 8; t++)
+    {
+        store_be(digest + (t * 4), context->state[t]);
+    }
+}
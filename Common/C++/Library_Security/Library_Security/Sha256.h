@@ -0,0 +1,30 @@
+#pragma once
+
+// SHA-256 of many independent buffers.
+// digests: count * 32 bytes
+// threads: 0 means one per core
+void sha256_many(byte** sources, int32_t* lengths, int32_t count, byte* digests, int32_t threads);
+
+// Hashes the buffers like sha256_many and compares them with the expected digests (count * 32 bytes).
+// Bit (i % 8) of results[i / 8] is set when buffer i matches. Returns the number of matches.
+int32_t sha256_verify_many(byte** sources, int32_t* lengths, int32_t count, byte* hashes, byte* results, int32_t threads);
+
+// Incremental SHA-256 for the other units of this library. Not exported.
+struct Sha256_Context
+{
+    uint32_t state[8];
+    byte buffer[64];
+    int32_t bufferLength;
+    uint64_t length;
+};
+
+void sha256_initialize(Sha256_Context* context);
+void sha256_update(Sha256_Context* context, const byte* source, int32_t length);
+void sha256_finalize(Sha256_Context* context, byte* digest);
+
+// Raw compression for the other units. Not exported.
+// sha256_blocks uses the fastest single-lane kernel. sha256_lanes returns 8 when the AVX2 multi-buffer kernel is
+// preferred, in which case sha256_compress8 runs one block in each of 8 lanes (words[t * 8 + lane], states[t * 8 + lane]).
+void sha256_blocks(uint32_t* state, const byte* source, int32_t blocks);
+int32_t sha256_lanes();
+void sha256_compress8(const uint32_t* words, uint32_t* states);
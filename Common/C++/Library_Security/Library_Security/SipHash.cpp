@@ -0,0 +1,87 @@
+#include "stdafx.h"
+#include "SipHash.h"
+#include "..\..\Library\Library\Stats.h"
+
+#include <stdlib.h>
+
+static const int32_t statsSipHash = stats_register("siphash13");
+
+#define SIPHASH_ROUND(v0, v1, v2, v3) \
+    v0 += v1; v1 = _rotl64(v1, 13); v1 ^= v0; v0 = _rotl64(v0, 32); \
+    v2 += v3; v3 = _rotl64(v3, 16); v3 ^= v2; \
+    v0 += v3; v3 = _rotl64(v3, 21); v3 ^= v0; \
+    v2 += v1; v1 = _rotl64(v1, 17); v1 ^= v2; v2 = _rotl64(v2, 32);
+
+static inline uint64_t siphash_load64(const byte* p)
+{
+    uint64_t x;
+    memcpy(&x, p, 8);
+
+    return x;
+}
+
+// Block count known at compile time, so the 32 and 64 byte keys (hashes, ids) run fully unrolled.
+template<int32_t blocks>
+static inline void siphash13_blocks(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3, const byte* source)
+{
+    for (int32_t i = 0; i < blocks; i++)
+    {
+        uint64_t m = siphash_load64(source + (i * 8));
+
+        v3 ^= m;
+        SIPHASH_ROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+}
+
+static inline void siphash13_blocks(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3, const byte* source, int32_t blocks)
+{
+    for (int32_t i = 0; i < blocks; i++)
+    {
+        uint64_t m = siphash_load64(source + (i * 8));
+
+        v3 ^= m;
+        SIPHASH_ROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+}
+
+uint64_t siphash13(uint64_t* state, byte* source, int32_t length)
+{
+    StatsScope stats(statsSipHash, StatsTier_Scalar, length);
+
+    uint64_t v0 = state[0];
+    uint64_t v1 = state[1];
+    uint64_t v2 = state[2];
+    uint64_t v3 = state[3];
+
+    if (length == 32) siphash13_blocks<4>(v0, v1, v2, v3, source);
+    else if (length == 64) siphash13_blocks<8>(v0, v1, v2, v3, source);
+    else siphash13_blocks(v0, v1, v2, v3, source, length / 8);
+
+    // The last block holds the remaining bytes and the length in its top byte.
+    const byte* tail = source + (length & ~7);
+    uint64_t b = (uint64_t)length << 56;
+
+    switch (length & 7)
+    {
+    case 7: b |= (uint64_t)tail[6] << 48;
+    case 6: b |= (uint64_t)tail[5] << 40;
+    case 5: b |= (uint64_t)tail[4] << 32;
+    case 4: b |= (uint64_t)tail[3] << 24;
+    case 3: b |= (uint64_t)tail[2] << 16;
+    case 2: b |= (uint64_t)tail[1] << 8;
+    case 1: b |= (uint64_t)tail[0];
+    }
+
+    v3 ^= b;
+    SIPHASH_ROUND(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPHASH_ROUND(v0, v1, v2, v3);
+    SIPHASH_ROUND(v0, v1, v2, v3);
+    SIPHASH_ROUND(v0, v1, v2, v3);
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// SipHash-1-3. state is the key expanded into the four starting words (k0 ^ "somepseu", k1 ^ "dorandom",
+// k0 ^ "lygenera", k1 ^ "tedbytes"); the caller expands its key once and passes the state to each call.
+uint64_t siphash13(uint64_t* state, byte* source, int32_t length);
@@ -1,5 +1,6 @@
 // dllmain.cpp : Defines the entry point for the DLL application.
 #include "stdafx.h"
+#include "..\..\Library\Library\Stats.h"
 
 BOOL APIENTRY DllMain( HMODULE hModule,
                        DWORD  ul_reason_for_call,
@@ -9,8 +10,12 @@ BOOL APIENTRY DllMain( HMODULE hModule,
 	switch (ul_reason_for_call)
 	{
 	case DLL_PROCESS_ATTACH:
-	case DLL_THREAD_ATTACH:
+		stats_initialize();
+		break;
 	case DLL_THREAD_DETACH:
+		stats_thread_detach();
+		break;
+	case DLL_THREAD_ATTACH:
 	case DLL_PROCESS_DETACH:
 		break;
 	}
@@ -0,0 +1,59 @@
+using System;
+using System.Collections.Generic;
+
+namespace Library.Collections
+{
+    // 生存時間が一定のコレクションのための、期限切れの候補の列。
+    // 生存時間が一定なので、更新された順に並べれば期限も同じ順に並ぶ。更新時刻は生存時間の 1/64 を単位に丸め、
+    // 同じ単位の中での再更新は並べ直さない。期限切れの確認は先頭から期限を過ぎたものを取り出すだけで、全体は走査しない。
+    // 取り出したキーの単位がコレクション側の単位と一致しなければ、その後に更新または削除されたものとして捨てる。
+    internal sealed class ExpirationQueue<T>
+    {
+        private readonly long _unitTicks;
+        private readonly long _survivalUnits;
+
+        private Queue<KeyValuePair<T, long>> _queue = new Queue<KeyValuePair<T, long>>();
+
+        public ExpirationQueue(TimeSpan survivalTime)
+        {
+            _unitTicks = Math.Max(1, survivalTime.Ticks / 64);
+            _survivalUnits = (survivalTime.Ticks + (_unitTicks - 1)) / _unitTicks;
+        }
+
+        public long Now
+        {
+            get
+            {
+                return DateTime.UtcNow.Ticks / _unitTicks;
+            }
+        }
+
+        public void Enqueue(T key, long unit)
+        {
+            _queue.Enqueue(new KeyValuePair<T, long>(key, unit));
+        }
+
+        // 単位の途中で更新されたものも含め、生存時間を確実に過ぎたものだけを返す。
+        public bool TryDequeue(long now, out T key, out long unit)
+        {
+            if (_queue.Count == 0 || (now - _queue.Peek().Value) <= _survivalUnits)
+            {
+                key = default(T);
+                unit = 0;
+
+                return false;
+            }
+
+            var pair = _queue.Dequeue();
+            key = pair.Key;
+            unit = pair.Value;
+
+            return true;
+        }
+
+        public void Clear()
+        {
+            _queue.Clear();
+        }
+    }
+}
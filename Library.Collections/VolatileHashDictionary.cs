@@ -8,6 +8,7 @@ namespace Library.Collections
     public class VolatileHashDictionary<TKey, TValue> : IDictionary<TKey, TValue>, ICollection<KeyValuePair<TKey, TValue>>, IEnumerable<KeyValuePair<TKey, TValue>>, IDictionary, ICollection, IEnumerable, IThisLock
     {
         private Dictionary<TKey, Info<TValue>> _dic;
+        private ExpirationQueue<TKey> _expirationQueue;
         private readonly TimeSpan _survivalTime;
 
         private readonly object _thisLock = new object();
@@ -15,12 +16,14 @@ namespace Library.Collections
         public VolatileHashDictionary(TimeSpan survivalTime)
         {
             _dic = new Dictionary<TKey, Info<TValue>>();
+            _expirationQueue = new ExpirationQueue<TKey>(survivalTime);
             _survivalTime = survivalTime;
         }
 
         public VolatileHashDictionary(TimeSpan survivalTime, IEqualityComparer<TKey> comparer)
         {
             _dic = new Dictionary<TKey, Info<TValue>>(comparer);
+            _expirationQueue = new ExpirationQueue<TKey>(survivalTime);
             _survivalTime = survivalTime;
         }
 
@@ -43,31 +46,18 @@ namespace Library.Collections
             }
         }
 
-        private void CheckLifeTime()
+        private void CheckLifeTime(long now, int limit)
         {
-            var now = DateTime.UtcNow;
-
             lock (this.ThisLock)
             {
-                List<TKey> list = null;
+                TKey key;
+                long unit;
 
-                foreach (var pair in _dic)
+                for (int i = 0; i < limit && _expirationQueue.TryDequeue(now, out key, out unit); i++)
                 {
-                    var key = pair.Key;
-                    var info = pair.Value;
-
-                    if ((now - info.UpdateTime) > _survivalTime)
-                    {
-                        if (list == null)
-                            list = new List<TKey>();
+                    Info<TValue> info;
 
-                        list.Add(key);
-                    }
-                }
-
-                if (list != null)
-                {
-                    foreach (var key in list)
+                    if (_dic.TryGetValue(key, out info) && info.Unit == unit)
                     {
                         _dic.Remove(key);
                     }
@@ -75,11 +65,23 @@ namespace Library.Collections
             }
         }
 
+        private void Update(TKey key, TValue value, long now)
+        {
+            Info<TValue> info;
+
+            if (!_dic.TryGetValue(key, out info) || info.Unit != now)
+            {
+                _expirationQueue.Enqueue(key, now);
+            }
+
+            _dic[key] = new Info<TValue>() { Value = value, Unit = now };
+        }
+
         public void TrimExcess()
         {
             lock (this.ThisLock)
             {
-                this.CheckLifeTime();
+                this.CheckLifeTime(_expirationQueue.Now, int.MaxValue);
             }
         }
 
@@ -140,7 +142,10 @@ namespace Library.Collections
             {
                 lock (this.ThisLock)
                 {
-                    _dic[key] = new Info<TValue>() { Value = value, UpdateTime = DateTime.UtcNow };
+                    var now = _expirationQueue.Now;
+
+                    this.CheckLifeTime(now, 2);
+                    this.Update(key, value, now);
                 }
             }
         }
@@ -149,8 +154,13 @@ namespace Library.Collections
         {
             lock (this.ThisLock)
             {
+                var now = _expirationQueue.Now;
+
+                // 期限切れのものを少しずつ取り除く。
+                this.CheckLifeTime(now, 2);
+
                 int count = _dic.Count;
-                _dic[key] = new Info<TValue>() { Value = value, UpdateTime = DateTime.UtcNow };
+                this.Update(key, value, now);
 
                 return (count != _dic.Count);
             }
@@ -161,6 +171,7 @@ namespace Library.Collections
             lock (this.ThisLock)
             {
                 _dic.Clear();
+                _expirationQueue.Clear();
             }
         }
 
@@ -471,7 +482,7 @@ namespace Library.Collections
         internal struct Info<T>
         {
             public T Value { get; set; }
-            public DateTime UpdateTime { get; set; }
+            public long Unit { get; set; }
         }
 
         public sealed class VolatileKeyCollection : ICollection<TKey>, IEnumerable<TKey>, ICollection, IEnumerable, IThisLock
@@ -7,20 +7,23 @@ namespace Library.Collections
 {
     public class VolatileHashSet<T> : ICollection<T>, IEnumerable<T>, ICollection, IEnumerable, IThisLock
     {
-        private Dictionary<T, DateTime> _dic;
+        private Dictionary<T, long> _dic;
+        private ExpirationQueue<T> _expirationQueue;
         private readonly TimeSpan _survivalTime;
 
         private readonly object _thisLock = new object();
 
         public VolatileHashSet(TimeSpan survivalTime)
         {
-            _dic = new Dictionary<T, DateTime>();
+            _dic = new Dictionary<T, long>();
+            _expirationQueue = new ExpirationQueue<T>(survivalTime);
             _survivalTime = survivalTime;
         }
 
         public VolatileHashSet(TimeSpan survivalTime, IEqualityComparer<T> comparer)
         {
-            _dic = new Dictionary<T, DateTime>(comparer);
+            _dic = new Dictionary<T, long>(comparer);
+            _expirationQueue = new ExpirationQueue<T>(survivalTime);
             _survivalTime = survivalTime;
         }
 
@@ -40,31 +43,18 @@ namespace Library.Collections
             }
         }
 
-        private void CheckLifeTime()
+        private void CheckLifeTime(long now, int limit)
         {
-            var now = DateTime.UtcNow;
-
             lock (this.ThisLock)
             {
-                List<T> list = null;
+                T key;
+                long unit;
 
-                foreach (var pair in _dic)
+                for (int i = 0; i < limit && _expirationQueue.TryDequeue(now, out key, out unit); i++)
                 {
-                    var key = pair.Key;
-                    var value = pair.Value;
-
-                    if ((now - value) > _survivalTime)
-                    {
-                        if (list == null)
-                            list = new List<T>();
-
-                        list.Add(key);
-                    }
-                }
+                    long current;
 
-                if (list != null)
-                {
-                    foreach (var key in list)
+                    if (_dic.TryGetValue(key, out current) && current == unit)
                     {
                         _dic.Remove(key);
                     }
@@ -72,6 +62,17 @@ namespace Library.Collections
             }
         }
 
+        private void Update(T item, long now)
+        {
+            long unit;
+
+            if (!_dic.TryGetValue(item, out unit) || unit != now)
+            {
+                _dic[item] = now;
+                _expirationQueue.Enqueue(item, now);
+            }
+        }
+
         public IEqualityComparer<T> Comparer
         {
             get
@@ -98,9 +99,12 @@ namespace Library.Collections
         {
             lock (this.ThisLock)
             {
+                var now = _expirationQueue.Now;
+
                 foreach (var item in collection)
                 {
-                    _dic[item] = DateTime.UtcNow;
+                    this.CheckLifeTime(now, 2);
+                    this.Update(item, now);
                 }
             }
         }
@@ -109,8 +113,13 @@ namespace Library.Collections
         {
             lock (this.ThisLock)
             {
+                var now = _expirationQueue.Now;
+
+                // 期限切れのものを少しずつ取り除く。
+                this.CheckLifeTime(now, 2);
+
                 int count = _dic.Count;
-                _dic[item] = DateTime.UtcNow;
+                this.Update(item, now);
 
                 return (count != _dic.Count);
             }
@@ -121,6 +130,7 @@ namespace Library.Collections
             lock (this.ThisLock)
             {
                 _dic.Clear();
+                _expirationQueue.Clear();
             }
         }
 
@@ -152,7 +162,7 @@ namespace Library.Collections
         {
             lock (this.ThisLock)
             {
-                this.CheckLifeTime();
+                this.CheckLifeTime(_expirationQueue.Now, int.MaxValue);
             }
         }
 
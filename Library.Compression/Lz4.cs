@@ -0,0 +1,125 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Library.Compression
+{
+    public unsafe static class Lz4
+    {
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int CompressDelegate(byte* source, int sourceLength, byte* destination, int destinationLength);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int DecompressDelegate(byte* source, int sourceLength, byte* destination, int destinationLength);
+
+        private static CompressDelegate _compress;
+        private static DecompressDelegate _decompress;
+#endif
+
+        static Lz4()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Compression_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Compression_x86.dll");
+                }
+
+                // 古い DLL で片方だけ読み込まれることがないよう、両方揃ってから設定する。
+                var compress = _nativeLibraryManager.GetMethod<CompressDelegate>("lz4_compress");
+                var decompress = _nativeLibraryManager.GetMethod<DecompressDelegate>("lz4_decompress");
+
+                _compress = compress;
+                _decompress = decompress;
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// ネイティブの Lz4 が読み込まれているかどうかを返します
+        /// </summary>
+        public static bool IsAvailable
+        {
+            get
+            {
+#if Mono
+                return false;
+#else
+                return _compress != null && _decompress != null;
+#endif
+            }
+        }
+
+        // Returns 0 when the data does not get smaller.
+        public static int Compress(byte[] sourceBuffer, int sourceOffset, int sourceLength, byte[] destinationBuffer, int destinationOffset, int destinationLength)
+        {
+            if (sourceBuffer == null) throw new ArgumentNullException("sourceBuffer");
+            if (sourceOffset < 0 || sourceBuffer.Length < sourceOffset) throw new ArgumentOutOfRangeException("sourceOffset");
+            if (sourceLength < 0 || (sourceBuffer.Length - sourceOffset) < sourceLength) throw new ArgumentOutOfRangeException("sourceLength");
+            if (destinationBuffer == null) throw new ArgumentNullException("destinationBuffer");
+            if (destinationOffset < 0 || destinationBuffer.Length < destinationOffset) throw new ArgumentOutOfRangeException("destinationOffset");
+            if (destinationLength < 0 || (destinationBuffer.Length - destinationOffset) < destinationLength) throw new ArgumentOutOfRangeException("destinationLength");
+
+            if (sourceLength == 0 || destinationLength == 0) return 0;
+
+#if Mono
+            throw new NotSupportedException();
+#else
+            fixed (byte* p_sourceBuffer = sourceBuffer, p_destinationBuffer = destinationBuffer)
+            {
+                return _compress(p_sourceBuffer + sourceOffset, sourceLength, p_destinationBuffer + destinationOffset, destinationLength);
+            }
+#endif
+        }
+
+        public static int Decompress(byte[] sourceBuffer, int sourceOffset, int sourceLength, byte[] destinationBuffer, int destinationOffset, int destinationLength)
+        {
+            if (sourceBuffer == null) throw new ArgumentNullException("sourceBuffer");
+            if (sourceOffset < 0 || sourceBuffer.Length < sourceOffset) throw new ArgumentOutOfRangeException("sourceOffset");
+            if (sourceLength < 0 || (sourceBuffer.Length - sourceOffset) < sourceLength) throw new ArgumentOutOfRangeException("sourceLength");
+            if (destinationBuffer == null) throw new ArgumentNullException("destinationBuffer");
+            if (destinationOffset < 0 || destinationBuffer.Length < destinationOffset) throw new ArgumentOutOfRangeException("destinationOffset");
+            if (destinationLength < 0 || (destinationBuffer.Length - destinationOffset) < destinationLength) throw new ArgumentOutOfRangeException("destinationLength");
+
+            if (sourceLength == 0) throw new Lz4Exception();
+
+#if Mono
+            throw new NotSupportedException();
+#else
+            int result;
+
+            fixed (byte* p_sourceBuffer = sourceBuffer, p_destinationBuffer = destinationBuffer)
+            {
+                result = _decompress(p_sourceBuffer + sourceOffset, sourceLength, p_destinationBuffer + destinationOffset, destinationLength);
+            }
+
+            if (result < 0) throw new Lz4Exception();
+
+            return result;
+#endif
+        }
+    }
+
+    [Serializable]
+    class Lz4Exception : Exception
+    {
+        public Lz4Exception() : base() { }
+        public Lz4Exception(string message) : base(message) { }
+        public Lz4Exception(string message, Exception innerException) : base(message, innerException) { }
+    }
+}
@@ -1,211 +1,182 @@
 using System;
-using System.Diagnostics;
 using System.IO;
+using System.Runtime.InteropServices;
+using System.Security;
 using System.Threading;
-using System.Threading.Tasks;
-using Library.Io;
 
 namespace Library.Compression
 {
-    public static class Xz
+    public unsafe static class Xz
     {
-        private static string _path;
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate IntPtr CompressCreateDelegate(int preset, int threads, long blockSize);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate IntPtr DecompressCreateDelegate(long memoryLimit, int threads);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int CodeDelegate(IntPtr context, byte* inBuffer, int inLength, out int inUsed, byte* outBuffer, int outLength, out int outUsed, [MarshalAs(UnmanagedType.U1)] bool finish);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void FreeDelegate(IntPtr context);
+
+        private static CompressCreateDelegate _compressCreate;
+        private static DecompressCreateDelegate _decompressCreate;
+        private static CodeDelegate _code;
+        private static FreeDelegate _free;
+#endif
+
+        private const int _preset = 4;
+        private const long _memoryLimit = 1024 * 1024 * 256;
+
+        // 以前の xz --threads=1 と同じく 1 スレッドで、呼び出し元のスレッド上で符号化する。
+        private const int _threadCount = 1;
 
         static Xz()
         {
-            OperatingSystem osInfo = Environment.OSVersion;
+#if Mono
 
-            if (osInfo.Platform == PlatformID.Win32NT)
+#else
+            try
             {
                 if (System.Environment.Is64BitProcess)
                 {
-                    _path = "Assemblies/Xz_x64.exe";
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Compression_x64.dll");
                 }
                 else
                 {
-                    _path = "Assemblies/Xz_x86.exe";
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Compression_x86.dll");
                 }
+
+                // 全て揃ってから設定する。
+                var compressCreate = _nativeLibraryManager.GetMethod<CompressCreateDelegate>("xz_compress_create");
+                var decompressCreate = _nativeLibraryManager.GetMethod<DecompressCreateDelegate>("xz_decompress_create");
+                var code = _nativeLibraryManager.GetMethod<CodeDelegate>("xz_code");
+                var free = _nativeLibraryManager.GetMethod<FreeDelegate>("xz_free");
+
+                _code = code;
+                _free = free;
+                _compressCreate = compressCreate;
+                _decompressCreate = decompressCreate;
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
             }
+#endif
         }
 
         public static void Compress(Stream inStream, Stream outStream, BufferManager bufferManager)
         {
-            var info = new ProcessStartInfo(_path);
-            info.CreateNoWindow = true;
-            info.UseShellExecute = false;
-            info.RedirectStandardInput = true;
-            info.RedirectStandardOutput = true;
-            info.RedirectStandardError = true;
+            if (inStream == null) throw new ArgumentNullException("inStream");
+            if (outStream == null) throw new ArgumentNullException("outStream");
+            if (bufferManager == null) throw new ArgumentNullException("bufferManager");
 
-            info.Arguments = "--compress --format=xz -4 --threads=1 --stdout";
+#if Mono
+            throw new NotSupportedException("Library_Compression is not available.");
+#else
+            if (_compressCreate == null) throw new NotSupportedException("Library_Compression is not available.");
 
-            using (var inCacheStream = new CacheStream(inStream, 1024 * 32, bufferManager))
-            using (var outCacheStream = new CacheStream(outStream, 1024 * 32, bufferManager))
-            {
-                using (Process process = Process.Start(info))
-                {
-                    process.PriorityClass = ProcessPriorityClass.Idle;
+            var context = _compressCreate(_preset, _threadCount, 0);
+            if (context == IntPtr.Zero) throw new XzException("Failed to create the compressor.");
 
-                    process.ErrorDataReceived += (object sender, DataReceivedEventArgs e) =>
-                    {
-                        Log.Error(e.Data);
-                    };
+            try
+            {
+                Xz.Code(context, inStream, outStream, bufferManager);
+            }
+            finally
+            {
+                _free(context);
+            }
+#endif
+        }
 
-                    Exception threadException = null;
+        public static void Decompress(Stream inStream, Stream outStream, BufferManager bufferManager)
+        {
+            if (inStream == null) throw new ArgumentNullException("inStream");
+            if (outStream == null) throw new ArgumentNullException("outStream");
+            if (bufferManager == null) throw new ArgumentNullException("bufferManager");
 
-                    var thread = new Thread(new ThreadStart(() =>
-                    {
-                        try
-                        {
-                            byte[] buffer = bufferManager.TakeBuffer(1024 * 32);
-
-                            try
-                            {
-                                using (var standardOutputStream = process.StandardOutput.BaseStream)
-                                {
-                                    int length = 0;
-
-                                    while ((length = standardOutputStream.Read(buffer, 0, buffer.Length)) > 0)
-                                    {
-                                        outCacheStream.Write(buffer, 0, length);
-                                    }
-                                }
-                            }
-                            finally
-                            {
-                                bufferManager.ReturnBuffer(buffer);
-                            }
-                        }
-                        catch (Exception e)
-                        {
-                            threadException = e;
-                        }
-                    }));
-                    thread.IsBackground = true;
-                    thread.Start();
+#if Mono
+            throw new NotSupportedException("Library_Compression is not available.");
+#else
+            if (_decompressCreate == null) throw new NotSupportedException("Library_Compression is not available.");
 
-                    try
-                    {
-                        byte[] buffer = bufferManager.TakeBuffer(1024 * 32);
+            var context = _decompressCreate(_memoryLimit, _threadCount);
+            if (context == IntPtr.Zero) throw new XzException("Failed to create the decompressor.");
 
-                        try
-                        {
-                            using (var standardInputStream = process.StandardInput.BaseStream)
-                            {
-                                int length = 0;
-
-                                while ((length = inCacheStream.Read(buffer, 0, buffer.Length)) > 0)
-                                {
-                                    standardInputStream.Write(buffer, 0, length);
-                                }
-                            }
-                        }
-                        finally
-                        {
-                            bufferManager.ReturnBuffer(buffer);
-                        }
-                    }
-                    catch (Exception)
-                    {
-                        throw;
-                    }
-
-                    thread.Join();
-                    if (threadException != null) throw threadException;
-
-                    process.WaitForExit();
-                }
+            try
+            {
+                Xz.Code(context, inStream, outStream, bufferManager);
+            }
+            finally
+            {
+                _free(context);
             }
+#endif
         }
 
-        public static void Decompress(Stream inStream, Stream outStream, BufferManager bufferManager)
+#if Mono
+
+#else
+        private static void Code(IntPtr context, Stream inStream, Stream outStream, BufferManager bufferManager)
         {
-            var info = new ProcessStartInfo(_path);
-            info.CreateNoWindow = true;
-            info.UseShellExecute = false;
-            info.RedirectStandardInput = true;
-            info.RedirectStandardOutput = true;
-            info.RedirectStandardError = true;
+            byte[] inBuffer = bufferManager.TakeBuffer(1024 * 256);
+            byte[] outBuffer = bufferManager.TakeBuffer(1024 * 256);
 
-            info.Arguments = "--decompress --format=xz --memlimit-decompress=256MiB --stdout";
+            // 以前の xz プロセスはアイドル優先度で動いていたので、符号化の間は呼び出し元のスレッドの優先度を下げる。
+            var priority = Thread.CurrentThread.Priority;
+            Thread.CurrentThread.Priority = ThreadPriority.Lowest;
 
-            using (var inCacheStream = new CacheStream(inStream, 1024 * 32, bufferManager))
-            using (var outCacheStream = new CacheStream(outStream, 1024 * 32, bufferManager))
+            try
             {
-                using (Process process = Process.Start(info))
+                fixed (byte* p_inBuffer = inBuffer, p_outBuffer = outBuffer)
                 {
-                    process.PriorityClass = ProcessPriorityClass.Idle;
-
-                    process.ErrorDataReceived += (object sender, DataReceivedEventArgs e) =>
-                    {
-                        Log.Error(e.Data);
-                    };
-
-                    Exception threadException = null;
+                    int inOffset = 0;
+                    int inLength = 0;
+                    bool finish = false;
 
-                    var thread = new Thread(new ThreadStart(() =>
+                    for (; ; )
                     {
-                        try
+                        if (inLength == 0 && !finish)
                         {
-                            byte[] buffer = bufferManager.TakeBuffer(1024 * 32);
-
-                            try
-                            {
-                                using (var standardOutputStream = process.StandardOutput.BaseStream)
-                                {
-                                    int length = 0;
-
-                                    while ((length = standardOutputStream.Read(buffer, 0, buffer.Length)) > 0)
-                                    {
-                                        outCacheStream.Write(buffer, 0, length);
-                                    }
-                                }
-                            }
-                            finally
-                            {
-                                bufferManager.ReturnBuffer(buffer);
-                            }
-                        }
-                        catch (Exception e)
-                        {
-                            threadException = e;
+                            inOffset = 0;
+                            inLength = inStream.Read(inBuffer, 0, inBuffer.Length);
+
+                            if (inLength == 0) finish = true;
                         }
-                    }));
-                    thread.IsBackground = true;
-                    thread.Start();
 
-                    try
-                    {
-                        byte[] buffer = bufferManager.TakeBuffer(1024 * 32);
+                        int inUsed, outUsed;
+                        int result = _code(context, p_inBuffer + inOffset, inLength, out inUsed, p_outBuffer, outBuffer.Length, out outUsed, finish);
 
-                        try
-                        {
-                            using (var standardInputStream = process.StandardInput.BaseStream)
-                            {
-                                int length = 0;
-
-                                while ((length = inCacheStream.Read(buffer, 0, buffer.Length)) > 0)
-                                {
-                                    standardInputStream.Write(buffer, 0, length);
-                                }
-                            }
-                        }
-                        finally
-                        {
-                            bufferManager.ReturnBuffer(buffer);
-                        }
-                    }
-                    catch (Exception)
-                    {
-                        throw;
-                    }
+                        inOffset += inUsed;
+                        inLength -= inUsed;
 
-                    thread.Join();
-                    if (threadException != null) throw threadException;
+                        if (outUsed > 0) outStream.Write(outBuffer, 0, outUsed);
 
-                    process.WaitForExit();
+                        if (result == 1) break;
+                        if (result < 0) throw new XzException();
+                    }
                 }
             }
+            finally
+            {
+                Thread.CurrentThread.Priority = priority;
+
+                bufferManager.ReturnBuffer(inBuffer);
+                bufferManager.ReturnBuffer(outBuffer);
+            }
         }
+#endif
+    }
+
+    [Serializable]
+    class XzException : Exception
+    {
+        public XzException() : base() { }
+        public XzException(string message) : base(message) { }
+        public XzException(string message, Exception innerException) : base(message, innerException) { }
     }
 }
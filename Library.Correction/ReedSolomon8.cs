@@ -8,6 +8,14 @@ namespace Library.Correction
 {
     public class ReedSolomon8 : ManagerBase, IThisLock
     {
+        // ネイティブ側の TaskLane と同じ値。
+        private enum TaskLane
+        {
+            Interactive = 0,
+            Bulk = 1,
+            Background = 2,
+        }
+
         private volatile ReedSolomon8.Math _fecMath;
         private volatile int _k;
         private volatile int _n;
@@ -59,9 +67,66 @@ namespace Library.Correction
             }
         }
 
+        // Same as Encode, and also stores the SHA-256 of each repair packet in hashes.
+        // Each packet is hashed piece by piece while it is being encoded, so it is not read a second time.
+        public void Encode(ArraySegment<byte>[] src, ArraySegment<byte>[] repair, int[] index, int size, byte[][] hashes)
+        {
+            if (hashes == null) throw new ArgumentNullException("hashes");
+            if (hashes.Length != repair.Length) throw new ArgumentOutOfRangeException("hashes");
+
+            _cancel = false;
+
+            lock (this.ThisLock)
+            {
+                var handles = new GCHandle[src.Length];
+                var srcPtrs = new IntPtr[src.Length];
+
+                try
+                {
+                    for (int i = 0; i < src.Length; i++)
+                    {
+                        handles[i] = GCHandle.Alloc(src[i].Array, GCHandleType.Pinned);
+                        srcPtrs[i] = Marshal.UnsafeAddrOfPinnedArrayElement(src[i].Array, src[i].Offset);
+                    }
+
+                    this.ParallelFor(TaskLane.Bulk, repair.Length, row =>
+                    {
+                        if (_cancel) return;
+
+                        Thread.CurrentThread.IsBackground = true;
+                        Thread.CurrentThread.Priority = ThreadPriority.Lowest;
+
+                        var coefficients = new byte[_k];
+
+                        if (index[row] < _k)
+                        {
+                            // < k, systematic so the row is a copy.
+                            coefficients[index[row]] = 1;
+                        }
+                        else
+                        {
+                            Array.Copy(_encMatrix, index[row] * _k, coefficients, 0, _k);
+                        }
+
+                        var hash = new byte[32];
+                        _fecMath.EncodeSha256(srcPtrs, coefficients, repair[row].Array, repair[row].Offset, size, hash);
+
+                        hashes[row] = hash;
+                    });
+                }
+                finally
+                {
+                    for (int i = 0; i < handles.Length; i++)
+                    {
+                        if (handles[i].IsAllocated) handles[i].Free();
+                    }
+                }
+            }
+        }
+
         private void Encode(byte[][] src, int[] srcOff, byte[][] repair, int[] repairOff, int[] index, int packetLength)
         {
-            Parallel.For(0, repair.Length, new ParallelOptions() { MaxDegreeOfParallelism = _threadCount }, row =>
+            this.ParallelFor(TaskLane.Bulk, repair.Length, row =>
             {
                 if (_cancel) return;
 
@@ -116,44 +181,75 @@ namespace Library.Correction
             byte[] decMatrix = _fecMath.CreateDecodeMatrix(_encMatrix, index, _k, _n);
 
             // do the actual decoding..
-            byte[][] tmpPkts = new byte[_k][];
+            // 復元する行は 64 バイト境界に揃ったネイティブのスラブに置き、mul の境界合わせを不要にする。
+            IntPtr[] tmpPkts = new IntPtr[_k];
 
-            Parallel.For(0, _k, new ParallelOptions() { MaxDegreeOfParallelism = _threadCount }, row =>
+            try
             {
-                if (_cancel) return;
-
-                Thread.CurrentThread.IsBackground = true;
-                Thread.CurrentThread.Priority = ThreadPriority.Lowest;
-
-                if (index[row] >= _k)
+                this.ParallelFor(TaskLane.Interactive, _k, row =>
                 {
-                    tmpPkts[row] = _bufferManager.TakeBuffer(packetLength);
-                    Unsafe.Zero(tmpPkts[row], 0, packetLength);
+                    if (_cancel) return;
 
-                    for (int col = 0; col < _k; col++)
+                    Thread.CurrentThread.IsBackground = true;
+                    Thread.CurrentThread.Priority = ThreadPriority.Lowest;
+
+                    if (index[row] >= _k)
                     {
-                        if (_cancel) return;
+                        tmpPkts[row] = NativeBufferManager.TakeBuffer(packetLength);
+                        NativeBufferManager.Zero(tmpPkts[row], packetLength);
+
+                        for (int col = 0; col < _k; col++)
+                        {
+                            if (_cancel) return;
 
-                        _fecMath.AddMul(tmpPkts[row], 0, pkts[col], pktsOff[col], decMatrix[row * _k + col], packetLength);
+                            _fecMath.AddMul(tmpPkts[row], pkts[col], pktsOff[col], decMatrix[row * _k + col], packetLength);
+                        }
                     }
-                }
-            });
+                });
 
-            if (_cancel) return;
+                if (_cancel) return;
 
-            // move pkts to their final destination
-            for (int row = 0; row < _k; row++)
+                // move pkts to their final destination
+                for (int row = 0; row < _k; row++)
+                {
+                    if (index[row] >= _k)
+                    {
+                        // only copy those actually decoded.
+                        Marshal.Copy(tmpPkts[row], pkts[row], pktsOff[row], packetLength);
+                        index[row] = row;
+                    }
+                }
+            }
+            finally
             {
-                if (index[row] >= _k)
+                for (int row = 0; row < _k; row++)
                 {
-                    // only copy those actually decoded.
-                    Unsafe.Copy(tmpPkts[row], 0, pkts[row], pktsOff[row], packetLength);
-                    index[row] = row;
-                    _bufferManager.ReturnBuffer(tmpPkts[row]);
+                    if (tmpPkts[row] != IntPtr.Zero)
+                    {
+                        NativeBufferManager.ReturnBuffer(tmpPkts[row], packetLength);
+                    }
                 }
             }
         }
 
+        // 同じプロセスのネイティブ処理 (マイニングなど) と一つのコア数の枠を分け合う。
+        // 復元はダウンロードを待つ利用者がいるため Interactive、符号化は Bulk として、実行中のスレッド数を知らせる。
+        private void ParallelFor(TaskLane lane, int count, Action<int> body)
+        {
+            int threads = System.Math.Min((_threadCount > 0) ? _threadCount : Environment.ProcessorCount, count);
+
+            _fecMath.EnterTask(lane, threads);
+
+            try
+            {
+                Parallel.For(0, count, new ParallelOptions() { MaxDegreeOfParallelism = _threadCount }, body);
+            }
+            finally
+            {
+                _fecMath.LeaveTask(lane, threads);
+            }
+        }
+
         private static void Shuffle(ArraySegment<byte>[] pkts, int[] index, int k)
         {
             for (int i = 0; i < k; )
@@ -211,6 +307,15 @@ namespace Library.Correction
 
             delegate void MulDelegate(byte* src, byte* dst, byte* mulc, int len);
             private MulDelegate _mul;
+
+            delegate void EncodeSha256Delegate(byte** sources, int k, byte* coefficients, byte* table, byte* parity, int length, byte* hash);
+            private EncodeSha256Delegate _encodeSha256;
+
+            delegate void TaskEnterDelegate(int lane, int threads);
+            private TaskEnterDelegate _taskEnter;
+
+            delegate void TaskLeaveDelegate(int lane, int threads);
+            private TaskLeaveDelegate _taskLeave;
 #endif
 
             private const int _gfBits = 8;
@@ -269,6 +374,9 @@ namespace Library.Correction
              */
             private volatile byte[][] _gf_mul_table;
 
+            // _gf_mul_table as one 256 * 256 array, for the native encoder.
+            private volatile byte[] _gf_mul_table_flat;
+
             private volatile bool _disposed;
 
             public Math()
@@ -288,6 +396,16 @@ namespace Library.Correction
                     }
 
                     _mul = _nativeLibraryManager.GetMethod<MulDelegate>("mul");
+
+                    // 古い DLL では encode_sha256、task_enter、task_leave が見つからない。
+                    // 一部だけ設定されることがないよう、全て揃ってから設定する。
+                    var encodeSha256 = _nativeLibraryManager.GetMethod<EncodeSha256Delegate>("encode_sha256");
+                    var taskEnter = _nativeLibraryManager.GetMethod<TaskEnterDelegate>("task_enter");
+                    var taskLeave = _nativeLibraryManager.GetMethod<TaskLeaveDelegate>("task_leave");
+
+                    _encodeSha256 = encodeSha256;
+                    _taskEnter = taskEnter;
+                    _taskLeave = taskLeave;
                 }
                 catch (Exception e)
                 {
@@ -406,6 +524,13 @@ namespace Library.Correction
                     _gf_mul_table[0][i] = (byte)0;
                     _gf_mul_table[i][0] = (byte)0;
                 }
+
+                _gf_mul_table_flat = new byte[(_gfSize + 1) * (_gfSize + 1)];
+
+                for (int i = 0; i < _gfSize + 1; i++)
+                {
+                    Array.Copy(_gf_mul_table[i], 0, _gf_mul_table_flat, i * (_gfSize + 1), _gfSize + 1);
+                }
             }
 
             public byte Modnn(int x)
@@ -504,6 +629,25 @@ namespace Library.Correction
                     Log.Error(e);
                 }
             }
+
+            public void AddMul(IntPtr dst, byte[] src, int srcPos, byte c, int len)
+            {
+                // nop, optimize
+                if (c == 0) return;
+
+                byte[] gf_mulc = _gf_mul_table[c];
+
+                byte* p_dst = (byte*)dst;
+
+                fixed (byte* p_src = src)
+                fixed (byte* p_gf_mulc = gf_mulc)
+                {
+                    for (int i = 0; i < len; i++)
+                    {
+                        p_dst[i] ^= p_gf_mulc[p_src[srcPos + i]];
+                    }
+                }
+            }
 #else
             public void AddMul(byte[] dst, int dstPos, byte[] src, int srcPos, byte c, int len)
             {
@@ -530,8 +674,100 @@ namespace Library.Correction
                     Log.Error(e);
                 }
             }
+
+            public void AddMul(IntPtr dst, byte[] src, int srcPos, byte c, int len)
+            {
+                // nop, optimize
+                if (c == 0) return;
+
+                byte[] gf_mulc = _gf_mul_table[c];
+
+                try
+                {
+                    fixed (byte* p_src = src)
+                    fixed (byte* p_gf_mulc = gf_mulc)
+                    {
+                        _mul(p_src + srcPos, (byte*)dst, p_gf_mulc, len);
+                    }
+                }
+                catch (Exception e)
+                {
+                    Log.Error(e);
+                }
+            }
 #endif
 
+#if Mono
+            public void EncodeSha256(IntPtr[] sources, byte[] coefficients, byte[] dst, int dstPos, int len, byte[] hash)
+            {
+                this.EncodeSha256Managed(sources, coefficients, dst, dstPos, len, hash);
+            }
+#else
+            public void EncodeSha256(IntPtr[] sources, byte[] coefficients, byte[] dst, int dstPos, int len, byte[] hash)
+            {
+                // encode_sha256 が無い古い DLL では、マネージドの実装で符号化する。
+                if (_encodeSha256 == null)
+                {
+                    this.EncodeSha256Managed(sources, coefficients, dst, dstPos, len, hash);
+
+                    return;
+                }
+
+                fixed (IntPtr* p_sources = sources)
+                fixed (byte* p_coefficients = coefficients)
+                fixed (byte* p_table = _gf_mul_table_flat)
+                fixed (byte* p_dst = dst)
+                fixed (byte* p_hash = hash)
+                {
+                    _encodeSha256((byte**)p_sources, coefficients.Length, p_coefficients, p_table, p_dst + dstPos, len, p_hash);
+                }
+            }
+#endif
+
+            private void EncodeSha256Managed(IntPtr[] sources, byte[] coefficients, byte[] dst, int dstPos, int len, byte[] hash)
+            {
+                Unsafe.Zero(dst, dstPos, len);
+
+                fixed (byte* p_dst = dst)
+                {
+                    for (int i = 0; i < coefficients.Length; i++)
+                    {
+                        if (coefficients[i] == 0) continue;
+
+                        byte[] gf_mulc = _gf_mul_table[coefficients[i]];
+                        byte* p_src = (byte*)sources[i];
+
+                        for (int j = 0; j < len; j++)
+                        {
+                            p_dst[dstPos + j] ^= gf_mulc[p_src[j]];
+                        }
+                    }
+                }
+
+                using (var sha256 = System.Security.Cryptography.SHA256.Create())
+                {
+                    Array.Copy(sha256.ComputeHash(dst, dstPos, len), hash, 32);
+                }
+            }
+
+            public void EnterTask(TaskLane lane, int threads)
+            {
+#if Mono
+
+#else
+                if (_taskEnter != null) _taskEnter((int)lane, threads);
+#endif
+            }
+
+            public void LeaveTask(TaskLane lane, int threads)
+            {
+#if Mono
+
+#else
+                if (_taskLeave != null) _taskLeave((int)lane, threads);
+#endif
+            }
+
             public void MatMul(byte[] a, int aStart, byte[] b, int bStart, byte[] c, int cStart, int n, int k, int m)
             {
                 for (int row = 0; row < n; row++)
@@ -2,11 +2,13 @@ using System;
 using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
+using System.IO.Compression;
 using System.Linq;
 using System.Runtime.InteropServices;
 using System.Runtime.Serialization;
 using System.Security.Cryptography;
 using System.Threading;
+using System.Xml;
 using Library.Collections;
 using Library.Compression;
 using Library.Correction;
@@ -30,7 +32,7 @@ namespace Library.Net.Amoeba
 
     class CacheManager : ManagerBase, Library.Configuration.ISettings, ISetOperators<Key>, IEnumerable<Key>, IThisLock
     {
-        private FileStream _fileStream;
+        private MappedFile _mappedFile;
         private BitmapManager _bitmapManager;
         private BufferManager _bufferManager;
 
@@ -64,12 +66,14 @@ namespace Library.Net.Amoeba
 
         public static readonly int SectorSize = 1024 * 256;
         public static readonly int SpaceSectorUnit = 4 * 1024; // 1MB * 1024 = 1024MB
+        private static readonly int ShareHashBlockCount = 32;
+        private static readonly int ReadQueueDepth = 16;
 
         private int _threadCount = 2;
 
         public CacheManager(string cachePath, BitmapManager bitmapManager, BufferManager bufferManager)
         {
-            _fileStream = new FileStream(cachePath, FileMode.OpenOrCreate, FileAccess.ReadWrite, FileShare.None, 8192, FileOptions.None);
+            _mappedFile = new MappedFile(cachePath);
             _bitmapManager = bitmapManager;
             _bufferManager = bufferManager;
 
@@ -215,7 +219,7 @@ namespace Library.Net.Amoeba
 
                     contexts.Add(new InformationContext("SeedCount", _settings.SeedsInformation.Count));
                     contexts.Add(new InformationContext("ShareCount", _settings.ShareIndex.Count));
-                    contexts.Add(new InformationContext("UsingSpace", _fileStream.Length));
+                    contexts.Add(new InformationContext("UsingSpace", _mappedFile.Length));
                     contexts.Add(new InformationContext("LockSpace", _lockSpace));
                     contexts.Add(new InformationContext("FreeSpace", _freeSpace));
 
@@ -587,7 +591,7 @@ namespace Library.Net.Amoeba
                 }
 
                 _settings.Size = ((size + ((long)CacheManager.SectorSize - 1)) / (long)CacheManager.SectorSize) * CacheManager.SectorSize;
-                _fileStream.SetLength(Math.Min(_settings.Size, _fileStream.Length));
+                _mappedFile.SetLength(Math.Min(_settings.Size, _mappedFile.Length));
 
                 _spaceSectors.Clear();
                 _spaceSectorsInitialized = false;
@@ -820,28 +824,63 @@ namespace Library.Net.Amoeba
         {
             if (inStream == null) throw new ArgumentNullException("inStream");
 
-            byte[] buffer = _bufferManager.TakeBuffer(blockLength);
-
             KeyCollection keys = new KeyCollection();
             ShareInfo shareInfo = new ShareInfo();
             shareInfo.BlockLength = blockLength;
 
-            while (inStream.Position < inStream.Length)
+            // ブロックをまとめて読み込み、ハッシュを一括で計算する。
+            var buffers = new List<ArraySegment<byte>>();
+
+            try
             {
-                int length = (int)Math.Min(inStream.Length - inStream.Position, blockLength);
-                inStream.Read(buffer, 0, length);
+                while (inStream.Position < inStream.Length)
+                {
+                    for (int i = 0; i < CacheManager.ShareHashBlockCount && inStream.Position < inStream.Length; i++)
+                    {
+                        int length = (int)Math.Min(inStream.Length - inStream.Position, blockLength);
 
-                Key key = null;
+                        byte[] buffer = _bufferManager.TakeBuffer(blockLength);
+                        buffers.Add(new ArraySegment<byte>(buffer, 0, length));
 
-                if (hashAlgorithm == HashAlgorithm.Sha256)
-                {
-                    key = new Key(Sha256.ComputeHash(buffer, 0, length), HashAlgorithm.Sha256);
-                }
+                        inStream.Read(buffer, 0, length);
+                    }
+
+                    byte[][] hashes = null;
+
+                    if (hashAlgorithm == HashAlgorithm.Sha256)
+                    {
+                        hashes = Sha256.ComputeHashes(buffers);
+                    }
+
+                    for (int i = 0; i < buffers.Count; i++)
+                    {
+                        Key key = null;
+
+                        if (hashAlgorithm == HashAlgorithm.Sha256)
+                        {
+                            key = new Key(hashes[i], HashAlgorithm.Sha256);
+                        }
+
+                        if (!shareInfo.Indexes.ContainsKey(key))
+                            shareInfo.Indexes.Add(key, keys.Count);
+
+                        keys.Add(key);
+                    }
 
-                if (!shareInfo.Indexes.ContainsKey(key))
-                    shareInfo.Indexes.Add(key, keys.Count);
+                    foreach (var buffer in buffers)
+                    {
+                        _bufferManager.ReturnBuffer(buffer.Array);
+                    }
 
-                keys.Add(key);
+                    buffers.Clear();
+                }
+            }
+            finally
+            {
+                foreach (var buffer in buffers)
+                {
+                    _bufferManager.ReturnBuffer(buffer.Array);
+                }
             }
 
             lock (this.ThisLock)
@@ -894,7 +933,8 @@ namespace Library.Net.Amoeba
             if (!Enum.IsDefined(typeof(CryptoAlgorithm), cryptoAlgorithm)) throw new ArgumentException("CryptoAlgorithm に存在しない列挙");
             if (!Enum.IsDefined(typeof(HashAlgorithm), hashAlgorithm)) throw new ArgumentException("HashAlgorithm に存在しない列挙");
 
-            if (compressionAlgorithm == CompressionAlgorithm.Xz && cryptoAlgorithm == CryptoAlgorithm.Aes256)
+            if (compressionAlgorithm == CompressionAlgorithm.Xz
+                && (cryptoAlgorithm == CryptoAlgorithm.Aes256 || cryptoAlgorithm == CryptoAlgorithm.Aes256_Ctr))
             {
                 byte[] aesKey = new byte[32];
                 byte[] aesIv = new byte[16];
@@ -910,21 +950,15 @@ namespace Library.Net.Amoeba
                     }
                 }
 
+                var mode = (cryptoAlgorithm == CryptoAlgorithm.Aes256_Ctr) ? Aes256Mode.Ctr : Aes256Mode.Cbc;
                 var keys = new KeyCollection();
 
                 try
                 {
-                    using (var aes = Aes.Create())
+                    using (var outStream = new CacheManagerStreamWriter(out keys, blockLength, hashAlgorithm, this, _bufferManager))
+                    using (var cs = new Aes256Stream(outStream, aesKey, aesIv, mode, CryptoStreamMode.Write, _bufferManager))
                     {
-                        aes.KeySize = 256;
-                        aes.Mode = CipherMode.CBC;
-                        aes.Padding = PaddingMode.PKCS7;
-
-                        using (var outStream = new CacheManagerStreamWriter(out keys, blockLength, hashAlgorithm, this, _bufferManager))
-                        using (CryptoStream cs = new CryptoStream(outStream, aes.CreateEncryptor(aesKey, aesIv), CryptoStreamMode.Write))
-                        {
-                            Xz.Compress(inStream, cs, _bufferManager);
-                        }
+                        Xz.Compress(inStream, cs, _bufferManager);
                     }
                 }
                 catch (Exception)
@@ -996,7 +1030,8 @@ namespace Library.Net.Amoeba
             if (!Enum.IsDefined(typeof(CompressionAlgorithm), compressionAlgorithm)) throw new ArgumentException("CompressAlgorithm に存在しない列挙");
             if (!Enum.IsDefined(typeof(CryptoAlgorithm), cryptoAlgorithm)) throw new ArgumentException("CryptoAlgorithm に存在しない列挙");
 
-            if (compressionAlgorithm == CompressionAlgorithm.Xz && cryptoAlgorithm == CryptoAlgorithm.Aes256)
+            if (compressionAlgorithm == CompressionAlgorithm.Xz
+                && (cryptoAlgorithm == CryptoAlgorithm.Aes256 || cryptoAlgorithm == CryptoAlgorithm.Aes256_Ctr))
             {
                 byte[] aesKey = new byte[32];
                 byte[] aesIv = new byte[16];
@@ -1012,17 +1047,12 @@ namespace Library.Net.Amoeba
                     }
                 }
 
-                using (var aes = Aes.Create())
-                {
-                    aes.KeySize = 256;
-                    aes.Mode = CipherMode.CBC;
-                    aes.Padding = PaddingMode.PKCS7;
+                var mode = (cryptoAlgorithm == CryptoAlgorithm.Aes256_Ctr) ? Aes256Mode.Ctr : Aes256Mode.Cbc;
 
-                    using (var inStream = new CacheManagerStreamReader(keys, this, _bufferManager))
-                    using (CryptoStream cs = new CryptoStream(inStream, aes.CreateDecryptor(aesKey, aesIv), CryptoStreamMode.Read))
-                    {
-                        Xz.Decompress(cs, outStream, _bufferManager);
-                    }
+                using (var inStream = new CacheManagerStreamReader(keys, this, _bufferManager))
+                using (var cs = new Aes256Stream(inStream, aesKey, aesIv, mode, CryptoStreamMode.Read, _bufferManager))
+                {
+                    Xz.Decompress(cs, outStream, _bufferManager);
                 }
             }
             else if (compressionAlgorithm == CompressionAlgorithm.None && cryptoAlgorithm == CryptoAlgorithm.None)
@@ -1086,20 +1116,25 @@ namespace Library.Net.Amoeba
 
                     var buffers = new ArraySegment<byte>[keys.Count];
                     var parityBuffers = new ArraySegment<byte>[keys.Count];
+                    ArraySegment<byte>[] blocks = null;
 
                     int sumLength = 0;
 
                     try
                     {
+                        blocks = this.GetBlocks(keys);
+
                         for (int i = 0; i < buffers.Length; i++)
                         {
                             if (watchEvent(this)) throw new StopException();
 
-                            ArraySegment<byte> buffer = new ArraySegment<byte>();
+                            ArraySegment<byte> buffer = blocks[i];
+                            blocks[i] = new ArraySegment<byte>();
 
                             try
                             {
-                                buffer = this[keys[i]];
+                                if (buffer.Array == null) throw new BlockNotFoundException();
+
                                 int bufferLength = buffer.Count;
 
                                 sumLength += bufferLength;
@@ -1142,6 +1177,9 @@ namespace Library.Net.Amoeba
                             indexes[i] = buffers.Length + i;
                         }
 
+                        // パリティのハッシュはエンコードと同時に計算する。
+                        byte[][] parityHashes = new byte[parityBuffers.Length][];
+
                         using (ReedSolomon8 reedSolomon = new ReedSolomon8(buffers.Length, buffers.Length + parityBuffers.Length, _threadCount, _bufferManager))
                         {
                             Exception exception = null;
@@ -1150,7 +1188,14 @@ namespace Library.Net.Amoeba
                             {
                                 try
                                 {
-                                    reedSolomon.Encode(buffers, parityBuffers, indexes, blockLength);
+                                    if (hashAlgorithm == HashAlgorithm.Sha256)
+                                    {
+                                        reedSolomon.Encode(buffers, parityBuffers, indexes, blockLength, parityHashes);
+                                    }
+                                    else
+                                    {
+                                        reedSolomon.Encode(buffers, parityBuffers, indexes, blockLength);
+                                    }
                                 }
                                 catch (Exception e)
                                 {
@@ -1183,7 +1228,7 @@ namespace Library.Net.Amoeba
                         {
                             if (hashAlgorithm == HashAlgorithm.Sha256)
                             {
-                                var key = new Key(Sha256.ComputeHash(parityBuffers[i]), hashAlgorithm);
+                                var key = new Key(parityHashes[i], hashAlgorithm);
 
                                 lock (this.ThisLock)
                                 {
@@ -1215,6 +1260,17 @@ namespace Library.Net.Amoeba
                     }
                     finally
                     {
+                        if (blocks != null)
+                        {
+                            for (int i = 0; i < blocks.Length; i++)
+                            {
+                                if (blocks[i].Array != null)
+                                {
+                                    _bufferManager.ReturnBuffer(blocks[i].Array);
+                                }
+                            }
+                        }
+
                         for (int i = 0; i < buffers.Length; i++)
                         {
                             if (buffers[i].Array != null)
@@ -1259,49 +1315,73 @@ namespace Library.Net.Amoeba
 
                         int count = 0;
 
-                        for (int i = 0; i < group.Keys.Count && count < group.InformationLength; i++)
+                        for (int i = 0; i < group.Keys.Count && count < group.InformationLength; )
                         {
                             if (watchEvent(this)) throw new StopException();
 
-                            if (!this.Contains(group.Keys[i])) continue;
+                            // 足りない分のブロックをまとめて読み込む。読めなかった分は次の周回で補う。
+                            var targetIndexes = new List<int>();
 
-                            ArraySegment<byte> buffer = new ArraySegment<byte>();
+                            for (; i < group.Keys.Count && targetIndexes.Count < group.InformationLength - count; i++)
+                            {
+                                if (!this.Contains(group.Keys[i])) continue;
+
+                                targetIndexes.Add(i);
+                            }
+
+                            var blocks = this.GetBlocks(targetIndexes.Select(n => group.Keys[n]).ToArray());
 
                             try
                             {
-                                buffer = this[group.Keys[i]];
-                                int bufferLength = buffer.Count;
-
-                                if (bufferLength > group.BlockLength)
+                                for (int j = 0; j < blocks.Length; j++)
                                 {
-                                    throw new ArgumentOutOfRangeException("group.BlockLength");
-                                }
-                                else if (bufferLength < group.BlockLength)
-                                {
-                                    ArraySegment<byte> tbuffer = new ArraySegment<byte>(_bufferManager.TakeBuffer(group.BlockLength), 0, group.BlockLength);
-                                    Unsafe.Copy(buffer.Array, buffer.Offset, tbuffer.Array, tbuffer.Offset, buffer.Count);
-                                    Unsafe.Zero(tbuffer.Array, tbuffer.Offset + buffer.Count, tbuffer.Count - buffer.Count);
-                                    _bufferManager.ReturnBuffer(buffer.Array);
-                                    buffer = tbuffer;
-                                }
+                                    ArraySegment<byte> buffer = blocks[j];
+                                    blocks[j] = new ArraySegment<byte>();
 
-                                indexes[count] = i;
-                                buffers[count] = buffer;
+                                    if (buffer.Array == null) continue;
 
-                                count++;
-                            }
-                            catch (BlockNotFoundException)
-                            {
+                                    try
+                                    {
+                                        int bufferLength = buffer.Count;
+
+                                        if (bufferLength > group.BlockLength)
+                                        {
+                                            throw new ArgumentOutOfRangeException("group.BlockLength");
+                                        }
+                                        else if (bufferLength < group.BlockLength)
+                                        {
+                                            ArraySegment<byte> tbuffer = new ArraySegment<byte>(_bufferManager.TakeBuffer(group.BlockLength), 0, group.BlockLength);
+                                            Unsafe.Copy(buffer.Array, buffer.Offset, tbuffer.Array, tbuffer.Offset, buffer.Count);
+                                            Unsafe.Zero(tbuffer.Array, tbuffer.Offset + buffer.Count, tbuffer.Count - buffer.Count);
+                                            _bufferManager.ReturnBuffer(buffer.Array);
+                                            buffer = tbuffer;
+                                        }
+
+                                        indexes[count] = targetIndexes[j];
+                                        buffers[count] = buffer;
+
+                                        count++;
+                                    }
+                                    catch (Exception)
+                                    {
+                                        if (buffer.Array != null)
+                                        {
+                                            _bufferManager.ReturnBuffer(buffer.Array);
+                                        }
 
+                                        throw;
+                                    }
+                                }
                             }
-                            catch (Exception)
+                            finally
                             {
-                                if (buffer.Array != null)
+                                for (int j = 0; j < blocks.Length; j++)
                                 {
-                                    _bufferManager.ReturnBuffer(buffer.Array);
+                                    if (blocks[j].Array != null)
+                                    {
+                                        _bufferManager.ReturnBuffer(blocks[j].Array);
+                                    }
                                 }
-
-                                throw;
                             }
                         }
 
@@ -1376,6 +1456,162 @@ namespace Library.Net.Amoeba
             }
         }
 
+        // パリティの計算に使うブロックを、全セクタの先読みを出した上で並列にまとめて読み込み、ハッシュを一括で検証する。
+        // 読めなかったブロックは Remove し、戻り値の該当要素は空になる。
+        // ロックはセクタ位置の取得と Remove の間だけ持ち、読み込みとハッシュの計算はロックの外で行う。
+        // その間に上書きされたセクタはハッシュの検証で弾かれる。
+        private ArraySegment<byte>[] GetBlocks(IList<Key> keys)
+        {
+            var blocks = new ArraySegment<byte>[keys.Count];
+            var clusterInfos = new ClusterInfo[keys.Count];
+
+            try
+            {
+                var positions = new List<long>();
+                var sectors = new List<ArraySegment<byte>>();
+                var owners = new List<int>();
+
+                lock (this.ThisLock)
+                {
+                    for (int i = 0; i < keys.Count; i++)
+                    {
+                        ClusterInfo clusterInfo = null;
+
+                        if (keys[i].HashAlgorithm != HashAlgorithm.Sha256) continue;
+                        if (!_settings.ClusterIndex.TryGetValue(keys[i], out clusterInfo)) continue;
+
+                        clusterInfo.UpdateTime = DateTime.UtcNow;
+                        clusterInfos[i] = clusterInfo;
+
+                        byte[] buffer = _bufferManager.TakeBuffer(clusterInfo.Length);
+                        blocks[i] = new ArraySegment<byte>(buffer, 0, clusterInfo.Length);
+
+                        for (int j = 0, remain = clusterInfo.Length; j < clusterInfo.Indexes.Length; j++, remain -= CacheManager.SectorSize)
+                        {
+                            long posision = clusterInfo.Indexes[j] * CacheManager.SectorSize;
+                            int length = Math.Min(remain, CacheManager.SectorSize);
+
+                            positions.Add(posision);
+                            sectors.Add(new ArraySegment<byte>(buffer, CacheManager.SectorSize * j, length));
+                            owners.Add(i);
+                        }
+                    }
+                }
+
+                for (int j = 0; j < positions.Count; j++)
+                {
+                    _mappedFile.Advise(positions[j], sectors[j].Count, MappedFileAdvice.WillNeed);
+                }
+
+                var results = _mappedFile.Read(positions, sectors, CacheManager.ReadQueueDepth);
+                var unread = new bool[keys.Count];
+
+                for (int j = 0; j < results.Length; j++)
+                {
+                    if (!results[j]) unread[owners[j]] = true;
+                }
+
+                // 読めなかったブロックは消さずに、下の this[key] で一つずつ読み直す。
+                // ビューを割り当てられなかっただけの一時的な失敗と、本当に読めない場合はそちらで区別する。
+                for (int i = 0; i < keys.Count; i++)
+                {
+                    if (!unread[i]) continue;
+
+                    _bufferManager.ReturnBuffer(blocks[i].Array);
+                    blocks[i] = new ArraySegment<byte>();
+                }
+
+                var failed = new bool[keys.Count];
+
+                var targetIndexes = Enumerable.Range(0, keys.Count).Where(n => blocks[n].Array != null).ToArray();
+                var hashes = Sha256.ComputeHashes(targetIndexes.Select(n => blocks[n]).ToArray());
+
+                // ハッシュの照合は 1 回のネイティブ呼び出しにまとめる。
+                {
+                    var batch = new UnsafeBatch(32, targetIndexes.Length * 2);
+                    var operations = new int[targetIndexes.Length];
+
+                    for (int j = 0; j < targetIndexes.Length; j++)
+                    {
+                        var hash = keys[targetIndexes[j]].Hash;
+
+                        if (hash.Length != 32)
+                        {
+                            operations[j] = -1;
+
+                            continue;
+                        }
+
+                        operations[j] = batch.AddEquals(batch.AddOperand(hashes[j]), batch.AddOperand(hash));
+                    }
+
+                    batch.Execute();
+
+                    for (int j = 0; j < targetIndexes.Length; j++)
+                    {
+                        if (operations[j] == -1 || !batch.GetEquals(operations[j])) failed[targetIndexes[j]] = true;
+                    }
+                }
+
+                if (failed.Any(n => n))
+                {
+                    lock (this.ThisLock)
+                    {
+                        for (int i = 0; i < keys.Count; i++)
+                        {
+                            if (!failed[i]) continue;
+
+                            // 読み込みの間に消されて別の場所に入り直したブロックは残す。
+                            ClusterInfo clusterInfo = null;
+
+                            if (_settings.ClusterIndex.TryGetValue(keys[i], out clusterInfo)
+                                && object.ReferenceEquals(clusterInfo, clusterInfos[i]))
+                            {
+                                this.Remove(keys[i]);
+                            }
+                        }
+                    }
+
+                    for (int i = 0; i < keys.Count; i++)
+                    {
+                        if (!failed[i]) continue;
+
+                        _bufferManager.ReturnBuffer(blocks[i].Array);
+                        blocks[i] = new ArraySegment<byte>();
+                    }
+                }
+
+                // Share されたファイルのブロックと、まとめて読めなかったブロックは一つずつ読み込む。
+                for (int i = 0; i < keys.Count; i++)
+                {
+                    if (blocks[i].Array != null || failed[i]) continue;
+
+                    try
+                    {
+                        blocks[i] = this[keys[i]];
+                    }
+                    catch (BlockNotFoundException)
+                    {
+
+                    }
+                }
+
+                return blocks;
+            }
+            catch (Exception)
+            {
+                for (int i = 0; i < blocks.Length; i++)
+                {
+                    if (blocks[i].Array != null)
+                    {
+                        _bufferManager.ReturnBuffer(blocks[i].Array);
+                    }
+                }
+
+                throw;
+            }
+        }
+
         public ArraySegment<byte> this[Key key]
         {
             get
@@ -1399,20 +1635,15 @@ namespace Library.Net.Amoeba
                                     {
                                         long posision = clusterInfo.Indexes[i] * CacheManager.SectorSize;
 
-                                        if (posision > _fileStream.Length)
+                                        if (posision > _mappedFile.Length)
                                         {
                                             this.Remove(key);
 
                                             throw new BlockNotFoundException();
                                         }
 
-                                        if (_fileStream.Position != posision)
-                                        {
-                                            _fileStream.Seek(posision, SeekOrigin.Begin);
-                                        }
-
                                         int length = Math.Min(remain, CacheManager.SectorSize);
-                                        _fileStream.Read(buffer, CacheManager.SectorSize * i, length);
+                                        _mappedFile.Read(posision, buffer, CacheManager.SectorSize * i, length);
                                     }
                                     catch (EndOfStreamException)
                                     {
@@ -1420,6 +1651,11 @@ namespace Library.Net.Amoeba
 
                                         throw new BlockNotFoundException();
                                     }
+                                    catch (MappedFileUnavailableException)
+                                    {
+                                        // ビューを割り当てられなかっただけで、ブロックは壊れていないので消さない。
+                                        throw new BlockNotFoundException();
+                                    }
                                     catch (IOException)
                                     {
                                         this.Remove(key);
@@ -1562,24 +1798,17 @@ namespace Library.Net.Amoeba
                         {
                             long posision = sectorList[i] * CacheManager.SectorSize;
 
-                            if ((_fileStream.Length < posision + CacheManager.SectorSize))
+                            if ((_mappedFile.Length < posision + CacheManager.SectorSize))
                             {
                                 int unit = 1024 * 1024 * 256;// 256MB
                                 long size = (((posision + CacheManager.SectorSize) + (unit - 1)) / unit) * unit;
 
-                                _fileStream.SetLength(Math.Min(size, this.Size));
-                            }
-
-                            if (_fileStream.Position != posision)
-                            {
-                                _fileStream.Seek(posision, SeekOrigin.Begin);
+                                _mappedFile.SetLength(Math.Min(size, this.Size));
                             }
 
                             int length = Math.Min(remain, CacheManager.SectorSize);
-                            _fileStream.Write(value.Array, value.Offset + (CacheManager.SectorSize * i), length);
+                            _mappedFile.Write(posision, value.Array, value.Offset + (CacheManager.SectorSize * i), length);
                         }
-
-                        _fileStream.Flush();
                     }
                     catch (SpaceNotFoundException e)
                     {
@@ -1632,6 +1861,9 @@ namespace Library.Net.Amoeba
         {
             lock (this.ThisLock)
             {
+                // マップ中の書き込みをインデックスと同時にディスクへ書き戻す。
+                _mappedFile.Flush();
+
                 _settings.Save(directoryPath);
             }
         }
@@ -1707,9 +1939,11 @@ namespace Library.Net.Amoeba
         {
             private volatile object _thisLock;
 
+            // ClustersIndex はキャッシュの大きさに比例して大きくなるため、DataContractSerializer を通さず独自の形式で保存する。
+            private LockedHashDictionary<Key, ClusterInfo> _clusterIndex = new LockedHashDictionary<Key, ClusterInfo>();
+
             public Settings(object lockObject)
                 : base(new List<Library.Configuration.ISettingContent>() { 
-                    new Library.Configuration.SettingContent<LockedHashDictionary<Key, ClusterInfo>>() { Name = "ClustersIndex", Value = new LockedHashDictionary<Key, ClusterInfo>() },
                     new Library.Configuration.SettingContent<long>() { Name = "Size", Value = (long)1024 * 1024 * 1024 * 50 },
                     new Library.Configuration.SettingContent<LockedHashDictionary<string, ShareInfo>>() { Name = "ShareIndex", Value = new LockedHashDictionary<string, ShareInfo>() },
                     new Library.Configuration.SettingContent<LockedList<SeedInfo>>() { Name = "SeedInformation", Value = new LockedList<SeedInfo>() },
@@ -1723,6 +1957,8 @@ namespace Library.Net.Amoeba
                 lock (_thisLock)
                 {
                     base.Load(directoryPath);
+
+                    _clusterIndex = ClusterIndexSnapshot.Load(directoryPath);
                 }
             }
 
@@ -1731,6 +1967,8 @@ namespace Library.Net.Amoeba
                 lock (_thisLock)
                 {
                     base.Save(directoryPath);
+
+                    ClusterIndexSnapshot.Save(directoryPath, _clusterIndex);
                 }
             }
 
@@ -1740,7 +1978,7 @@ namespace Library.Net.Amoeba
                 {
                     lock (_thisLock)
                     {
-                        return (LockedHashDictionary<Key, ClusterInfo>)this["ClustersIndex"];
+                        return _clusterIndex;
                     }
                 }
             }
@@ -1786,8 +2024,238 @@ namespace Library.Net.Amoeba
             }
         }
 
+        // ClustersIndex.snapshot の読み書き。Settings から使うほか、単体テストからも直接呼ぶ。
+        internal static class ClusterIndexSnapshot
+        {
+            // ClustersIndex.snapshot の形式。値はすべてリトルエンディアン。
+            // 先頭 16 バイト: 署名 "CIDX"、版、件数、以降の本体の CRC32C。
+            // 本体はクラスタごとに: HashAlgorithm (1)、ハッシュ長 (1)、ハッシュ、Length (4)、UpdateTime の Ticks (8)、セクタ数 (4)、セクタ番号 (8 * セクタ数)。
+            private static readonly byte[] _clusterIndexSignature = new byte[] { (byte)'C', (byte)'I', (byte)'D', (byte)'X' };
+            private const int _clusterIndexVersion = 1;
+            private const int _clusterIndexHeaderLength = 16;
+
+            public static LockedHashDictionary<Key, ClusterInfo> Load(string directoryPath)
+            {
+#if DEBUG
+                var sw = Stopwatch.StartNew();
+#endif
+
+                foreach (var extension in new string[] { ".snapshot", ".snapshot.bak" })
+                {
+                    var path = Path.Combine(directoryPath, "ClustersIndex" + extension);
+                    if (!File.Exists(path)) continue;
+
+                    try
+                    {
+                        var clusterIndex = ClusterIndexSnapshot.Decode(File.ReadAllBytes(path));
+
+#if DEBUG
+                        sw.Stop();
+                        Debug.WriteLine("Settings Load ClustersIndex {0} {1}", clusterIndex.Count, sw.ElapsedMilliseconds);
+#endif
+
+                        return clusterIndex;
+                    }
+                    catch (Exception e)
+                    {
+                        Log.Warning(e);
+                    }
+                }
+
+                // 以前の版が DataContractSerializer で保存したもの。次の Save で独自の形式に置き換わる。
+                foreach (var extension in new string[] { ".v2", ".v2.bak", ".gz", ".gz.bak" })
+                {
+                    var path = Path.Combine(directoryPath, "ClustersIndex" + extension);
+                    if (!File.Exists(path)) continue;
+
+                    try
+                    {
+                        using (FileStream stream = new FileStream(path, FileMode.Open))
+                        using (GZipStream decompressStream = new GZipStream(stream, CompressionMode.Decompress))
+                        using (XmlDictionaryReader xml = extension.StartsWith(".v2")
+                            ? XmlDictionaryReader.CreateBinaryReader(decompressStream, XmlDictionaryReaderQuotas.Max)
+                            : XmlDictionaryReader.CreateTextReader(decompressStream, XmlDictionaryReaderQuotas.Max))
+                        {
+                            var deserializer = new DataContractSerializer(typeof(LockedHashDictionary<Key, ClusterInfo>));
+                            return (LockedHashDictionary<Key, ClusterInfo>)deserializer.ReadObject(xml);
+                        }
+                    }
+                    catch (Exception e)
+                    {
+                        Log.Warning(e);
+                    }
+                }
+
+                return new LockedHashDictionary<Key, ClusterInfo>();
+            }
+
+            public static void Save(string directoryPath, LockedHashDictionary<Key, ClusterInfo> clusterIndex)
+            {
+                try
+                {
+                    var buffer = ClusterIndexSnapshot.Encode(clusterIndex);
+
+                    string tempPath = Path.Combine(directoryPath, "ClustersIndex.snapshot.tmp");
+                    string newPath = Path.Combine(directoryPath, "ClustersIndex.snapshot");
+                    string bakPath = Path.Combine(directoryPath, "ClustersIndex.snapshot.bak");
+
+                    using (FileStream stream = new FileStream(tempPath, FileMode.Create))
+                    {
+                        stream.Write(buffer, 0, buffer.Length);
+                        stream.Flush(true);
+                    }
+
+                    if (File.Exists(newPath))
+                    {
+                        if (File.Exists(bakPath))
+                        {
+                            File.Delete(bakPath);
+                        }
+
+                        File.Move(newPath, bakPath);
+                    }
+
+                    File.Move(tempPath, newPath);
+
+                    foreach (var extension in new string[] { ".v2", ".v2.bak", ".gz", ".gz.bak" })
+                    {
+                        string deleteFilePath = Path.Combine(directoryPath, "ClustersIndex" + extension);
+
+                        if (File.Exists(deleteFilePath))
+                        {
+                            File.Delete(deleteFilePath);
+                        }
+                    }
+                }
+                catch (Exception e)
+                {
+                    Log.Warning(e);
+                }
+            }
+
+            public static byte[] Encode(LockedHashDictionary<Key, ClusterInfo> clusterIndex)
+            {
+                var pairs = clusterIndex.ToArray();
+
+                long length = _clusterIndexHeaderLength;
+
+                foreach (var pair in pairs)
+                {
+                    length += 1 + 1 + pair.Key.Hash.Length + 4 + 8 + 4 + ((long)pair.Value.Indexes.Length * 8);
+                }
+
+                var buffer = new byte[length];
+
+                int position = _clusterIndexHeaderLength;
+
+                foreach (var pair in pairs)
+                {
+                    var key = pair.Key;
+                    var clusterInfo = pair.Value;
+
+                    buffer[position++] = (byte)key.HashAlgorithm;
+                    buffer[position++] = (byte)key.Hash.Length;
+                    Unsafe.Copy(key.Hash, 0, buffer, position, key.Hash.Length);
+                    position += key.Hash.Length;
+
+                    ClusterIndexSnapshot.WriteInt64(buffer, position, clusterInfo.Length, 4);
+                    position += 4;
+                    ClusterIndexSnapshot.WriteInt64(buffer, position, clusterInfo.UpdateTime.Ticks, 8);
+                    position += 8;
+                    ClusterIndexSnapshot.WriteInt64(buffer, position, clusterInfo.Indexes.Length, 4);
+                    position += 4;
+
+                    foreach (var index in clusterInfo.Indexes)
+                    {
+                        ClusterIndexSnapshot.WriteInt64(buffer, position, index, 8);
+                        position += 8;
+                    }
+                }
+
+                Unsafe.Copy(_clusterIndexSignature, 0, buffer, 0, 4);
+                ClusterIndexSnapshot.WriteInt64(buffer, 4, _clusterIndexVersion, 4);
+                ClusterIndexSnapshot.WriteInt64(buffer, 8, pairs.Length, 4);
+                Unsafe.Copy(Crc32_Castagnoli.ComputeHash(buffer, _clusterIndexHeaderLength, buffer.Length - _clusterIndexHeaderLength), 0, buffer, 12, 4);
+
+                return buffer;
+            }
+
+            public static LockedHashDictionary<Key, ClusterInfo> Decode(byte[] buffer)
+            {
+                if (buffer.Length < _clusterIndexHeaderLength
+                    || !Unsafe.Equals(buffer, 0, _clusterIndexSignature, 0, 4))
+                {
+                    throw new FormatException("ClustersIndex signature");
+                }
+
+                if (ClusterIndexSnapshot.ReadInt64(buffer, 4, 4) != _clusterIndexVersion) throw new FormatException("ClustersIndex version");
+
+                var crc = Crc32_Castagnoli.ComputeHash(buffer, _clusterIndexHeaderLength, buffer.Length - _clusterIndexHeaderLength);
+                if (!Unsafe.Equals(crc, 0, buffer, 12, 4)) throw new FormatException("ClustersIndex crc");
+
+                int count = (int)ClusterIndexSnapshot.ReadInt64(buffer, 8, 4);
+                var clusterIndex = new LockedHashDictionary<Key, ClusterInfo>();
+
+                int position = _clusterIndexHeaderLength;
+
+                for (int i = 0; i < count; i++)
+                {
+                    var hashAlgorithm = (HashAlgorithm)buffer[position++];
+                    var hash = new byte[buffer[position++]];
+                    Unsafe.Copy(buffer, position, hash, 0, hash.Length);
+                    position += hash.Length;
+
+                    var clusterInfo = new ClusterInfo();
+                    clusterInfo.Length = (int)ClusterIndexSnapshot.ReadInt64(buffer, position, 4);
+                    position += 4;
+                    clusterInfo.UpdateTime = new DateTime(ClusterIndexSnapshot.ReadInt64(buffer, position, 8), DateTimeKind.Utc);
+                    position += 8;
+
+                    var indexes = new long[(int)ClusterIndexSnapshot.ReadInt64(buffer, position, 4)];
+                    position += 4;
+
+                    for (int j = 0; j < indexes.Length; j++)
+                    {
+                        indexes[j] = ClusterIndexSnapshot.ReadInt64(buffer, position, 8);
+                        position += 8;
+                    }
+
+                    clusterInfo.Indexes = indexes;
+
+                    clusterIndex[new Key(hash, hashAlgorithm)] = clusterInfo;
+                }
+
+                if (position != buffer.Length) throw new FormatException("ClustersIndex length");
+
+                return clusterIndex;
+            }
+
+            private static void WriteInt64(byte[] buffer, int offset, long value, int length)
+            {
+                for (int i = 0; i < length; i++)
+                {
+                    buffer[offset + i] = (byte)(value >> (i * 8));
+                }
+            }
+
+            private static long ReadInt64(byte[] buffer, int offset, int length)
+            {
+                long value = 0;
+
+                for (int i = length - 1; i >= 0; i--)
+                {
+                    value = (value << 8) | buffer[offset + i];
+                }
+
+                // 4 バイトの値は符号付きとして戻す。
+                if (length == 4) value = (int)value;
+
+                return value;
+            }
+        }
+
         [DataContract(Name = "Clusters", Namespace = "http://Library/Net/Amoeba/CacheManager")]
-        private class ClusterInfo
+        internal class ClusterInfo
         {
             private long[] _indexes;
             private int _length;
@@ -1919,18 +2387,18 @@ namespace Library.Net.Amoeba
 
             if (disposing)
             {
-                if (_fileStream != null)
+                if (_mappedFile != null)
                 {
                     try
                     {
-                        _fileStream.Dispose();
+                        _mappedFile.Dispose();
                     }
                     catch (Exception)
                     {
 
                     }
 
-                    _fileStream = null;
+                    _mappedFile = null;
                 }
 
                 if (_watchTimer != null)
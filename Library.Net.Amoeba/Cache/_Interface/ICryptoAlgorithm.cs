@@ -10,6 +10,9 @@ namespace Library.Net.Amoeba
 
         [EnumMember(Value = "Aes256")]
         Aes256 = 1,
+
+        [EnumMember(Value = "Aes256_Ctr")]
+        Aes256_Ctr = 2,
     }
 
     public interface ICryptoAlgorithm
@@ -441,6 +441,8 @@ namespace Library.Net.Connections
                         _informationVersion3.OtherCryptoKey = otherCryptoKey;
                         _informationVersion3.MyHmacKey = myHmacKey;
                         _informationVersion3.OtherHmacKey = otherHmacKey;
+                        _informationVersion3.MyAes256 = new Aes256(myCryptoKey);
+                        _informationVersion3.OtherAes256 = new Aes256(otherCryptoKey);
                     }
                     else
                     {
@@ -498,70 +500,61 @@ namespace Library.Net.Connections
                     {
                         using (Stream stream = _connection.Receive(timeout, options))
                         {
-                            byte[] totalReceiveSizeBuff = new byte[8];
-                            if (stream.Read(totalReceiveSizeBuff, 0, totalReceiveSizeBuff.Length) != totalReceiveSizeBuff.Length) throw new ConnectionException();
-                            long totalReceiveSize = NetworkConverter.ToInt64(totalReceiveSizeBuff);
-
-                            if (_informationVersion3.HashAlgorithm.HasFlag(SecureVersion3.HashAlgorithm.Sha256))
+                            if (_informationVersion3.CryptoAlgorithm.HasFlag(SecureVersion3.CryptoAlgorithm.Aes256)
+                                && _informationVersion3.HashAlgorithm.HasFlag(SecureVersion3.HashAlgorithm.Sha256))
                             {
+                                const int headerLength = 8 + 16;
                                 const int hashLength = 32;
 
-                                _totalReceiveSize += (stream.Length - (8 + hashLength));
+                                if (stream.Length < headerLength + 16 + hashLength || stream.Length > int.MaxValue) throw new ConnectionException();
+                                int length = (int)stream.Length;
 
-                                if (totalReceiveSize != _totalReceiveSize) throw new ConnectionException();
+                                byte[] buffer = null;
 
-                                byte[] otherHmacBuff = new byte[hashLength];
-                                stream.Seek(-hashLength, SeekOrigin.End);
-                                if (stream.Read(otherHmacBuff, 0, otherHmacBuff.Length) != otherHmacBuff.Length) throw new ConnectionException();
-                                stream.SetLength(stream.Length - hashLength);
-                                stream.Seek(0, SeekOrigin.Begin);
+                                try
+                                {
+                                    buffer = _bufferManager.TakeBuffer(length);
 
-                                byte[] myHmacBuff = HmacSha256.ComputeHash(stream, _informationVersion3.OtherHmacKey);
+                                    {
+                                        int offset = 0;
+                                        int count = length;
+                                        int i = -1;
 
-                                if (!Unsafe.Equals(otherHmacBuff, myHmacBuff)) throw new ConnectionException();
+                                        while (count > 0 && (i = stream.Read(buffer, offset, count)) > 0)
+                                        {
+                                            offset += i;
+                                            count -= i;
+                                        }
 
-                                stream.Seek(8, SeekOrigin.Begin);
-                            }
-                            else
-                            {
-                                throw new ConnectionException();
-                            }
+                                        if (count != 0) throw new ConnectionException();
+                                    }
 
-                            BufferStream bufferStream = new BufferStream(_bufferManager);
+                                    long totalReceiveSize = NetworkConverter.ToInt64(buffer, 0);
 
-                            if (_informationVersion3.CryptoAlgorithm.HasFlag(SecureVersion3.CryptoAlgorithm.Aes256))
-                            {
-                                byte[] iv = new byte[16];
-                                stream.Read(iv, 0, iv.Length);
+                                    _totalReceiveSize += (length - (8 + hashLength));
 
-                                using (var aes = Aes.Create())
-                                {
-                                    aes.KeySize = 256;
-                                    aes.Mode = CipherMode.CBC;
-                                    aes.Padding = PaddingMode.PKCS7;
+                                    if (totalReceiveSize != _totalReceiveSize) throw new ConnectionException();
 
-                                    using (CryptoStream cs = new CryptoStream(new WrapperStream(bufferStream, true), aes.CreateDecryptor(_informationVersion3.OtherCryptoKey, iv), CryptoStreamMode.Write))
-                                    {
-                                        byte[] receiveBuffer = null;
+                                    byte[] iv = new byte[16];
+                                    Unsafe.Copy(buffer, 8, iv, 0, iv.Length);
 
-                                        try
-                                        {
-                                            receiveBuffer = _bufferManager.TakeBuffer(1024 * 4);
+                                    // HMAC ̌؂ƕ 1 pXōsBHMAC vȂꍇ͕ԂȂB
+                                    int plainLength = _informationVersion3.OtherAes256.CbcDecryptHmacSha256(
+                                        iv, _informationVersion3.OtherHmacKey, buffer, 0, headerLength, length - (headerLength + hashLength));
 
-                                            int i = -1;
+                                    if (plainLength < 0) throw new ConnectionException();
 
-                                            while ((i = stream.Read(receiveBuffer, 0, receiveBuffer.Length)) > 0)
-                                            {
-                                                cs.Write(receiveBuffer, 0, i);
-                                            }
-                                        }
-                                        finally
-                                        {
-                                            if (receiveBuffer != null)
-                                            {
-                                                _bufferManager.ReturnBuffer(receiveBuffer);
-                                            }
-                                        }
+                                    BufferStream bufferStream = new BufferStream(_bufferManager);
+                                    bufferStream.Write(buffer, headerLength, plainLength);
+
+                                    bufferStream.Seek(0, SeekOrigin.Begin);
+                                    return bufferStream;
+                                }
+                                finally
+                                {
+                                    if (buffer != null)
+                                    {
+                                        _bufferManager.ReturnBuffer(buffer);
                                     }
                                 }
                             }
@@ -569,9 +562,6 @@ namespace Library.Net.Connections
                             {
                                 throw new ConnectionException();
                             }
-
-                            bufferStream.Seek(0, SeekOrigin.Begin);
-                            return bufferStream;
                         }
                     }
                     else
@@ -605,76 +595,67 @@ namespace Library.Net.Connections
                     {
                         if (_version.HasFlag(SecureConnectionVersion.Version3))
                         {
-                            using (BufferStream bufferStream = new BufferStream(_bufferManager))
+                            if (_informationVersion3.CryptoAlgorithm.HasFlag(SecureVersion3.CryptoAlgorithm.Aes256)
+                                && _informationVersion3.HashAlgorithm.HasFlag(SecureVersion3.HashAlgorithm.Sha256))
                             {
-                                bufferStream.SetLength(8);
-                                bufferStream.Seek(8, SeekOrigin.Begin);
+                                const int headerLength = 8 + 16;
+                                const int hashLength = 32;
+
+                                if (targetStream.Length > int.MaxValue - (headerLength + 16 + hashLength)) throw new ArgumentOutOfRangeException("stream");
+                                int length = (int)targetStream.Length;
+
+                                byte[] buffer = null;
 
-                                if (_informationVersion3.CryptoAlgorithm.HasFlag(SecureVersion3.CryptoAlgorithm.Aes256))
+                                try
                                 {
+                                    buffer = _bufferManager.TakeBuffer(headerLength + length + 16 + hashLength);
+
                                     byte[] iv = new byte[16];
                                     _random.GetBytes(iv);
-                                    bufferStream.Write(iv, 0, iv.Length);
+                                    Unsafe.Copy(iv, 0, buffer, 8, iv.Length);
 
-                                    using (var aes = Aes.Create())
                                     {
-                                        aes.KeySize = 256;
-                                        aes.Mode = CipherMode.CBC;
-                                        aes.Padding = PaddingMode.PKCS7;
+                                        int offset = headerLength;
+                                        int count = length;
+                                        int i = -1;
 
-                                        using (CryptoStream cs = new CryptoStream(new WrapperStream(bufferStream, true), aes.CreateEncryptor(_informationVersion3.MyCryptoKey, iv), CryptoStreamMode.Write))
+                                        while (count > 0 && (i = targetStream.Read(buffer, offset, count)) > 0)
                                         {
-                                            byte[] sendBuffer = null;
-
-                                            try
-                                            {
-                                                sendBuffer = _bufferManager.TakeBuffer(1024 * 4);
-
-                                                int i = -1;
-
-                                                while ((i = targetStream.Read(sendBuffer, 0, sendBuffer.Length)) > 0)
-                                                {
-                                                    cs.Write(sendBuffer, 0, i);
-                                                }
-                                            }
-                                            finally
-                                            {
-                                                if (sendBuffer != null)
-                                                {
-                                                    _bufferManager.ReturnBuffer(sendBuffer);
-                                                }
-                                            }
+                                            offset += i;
+                                            count -= i;
                                         }
+
+                                        if (count != 0) throw new ConnectionException();
                                     }
-                                }
-                                else
-                                {
-                                    throw new ConnectionException();
-                                }
 
-                                _totalSendSize += (bufferStream.Length - 8);
+                                    // Í̒ PKCS7 pfBOŌ܂̂ŁAHMAC ̑ΏۂɂȂ鑗MTCYÍ̑Oɏ߂B
+                                    int cryptoLength = ((length / 16) + 1) * 16;
 
-                                bufferStream.Seek(0, SeekOrigin.Begin);
+                                    _totalSendSize += (16 + cryptoLength);
 
-                                byte[] totalSendSizeBuff = NetworkConverter.GetBytes(_totalSendSize);
-                                bufferStream.Write(totalSendSizeBuff, 0, totalSendSizeBuff.Length);
+                                    byte[] totalSendSizeBuff = NetworkConverter.GetBytes(_totalSendSize);
+                                    Unsafe.Copy(totalSendSizeBuff, 0, buffer, 0, totalSendSizeBuff.Length);
 
-                                if (_informationVersion3.HashAlgorithm.HasFlag(SecureVersion3.HashAlgorithm.Sha256))
-                                {
-                                    bufferStream.Seek(0, SeekOrigin.Begin);
-                                    byte[] hmacBuff = HmacSha256.ComputeHash(bufferStream, _informationVersion3.MyHmacKey);
+                                    // Í HMAC ̌vZ 1 pXōsB
+                                    _informationVersion3.MyAes256.CbcEncryptHmacSha256(
+                                        iv, _informationVersion3.MyHmacKey, buffer, 0, headerLength, length);
 
-                                    bufferStream.Seek(0, SeekOrigin.End);
-                                    bufferStream.Write(hmacBuff, 0, hmacBuff.Length);
+                                    using (MemoryStream sendStream = new MemoryStream(buffer, 0, headerLength + cryptoLength + hashLength))
+                                    {
+                                        _connection.Send(sendStream, timeout, options);
+                                    }
                                 }
-                                else
+                                finally
                                 {
-                                    throw new ConnectionException();
+                                    if (buffer != null)
+                                    {
+                                        _bufferManager.ReturnBuffer(buffer);
+                                    }
                                 }
-
-                                bufferStream.Seek(0, SeekOrigin.Begin);
-
-                                _connection.Send(bufferStream, timeout, options);
+                            }
+                            else
+                            {
+                                throw new ConnectionException();
                             }
                         }
                         else
@@ -704,6 +685,10 @@ namespace Library.Net.Connections
 
             public byte[] MyHmacKey { get; set; }
             public byte[] OtherHmacKey { get; set; }
+
+            // XPW[̓WJ͐ڑƂɈxsB
+            public Aes256 MyAes256 { get; set; }
+            public Aes256 OtherAes256 { get; set; }
         }
 
         protected override void Dispose(bool disposing)
@@ -740,6 +725,29 @@ namespace Library.Net.Connections
 
                     _random = null;
                 }
+
+                // M̓rŌ̃lCeBuȃReLXgȂ悤ɁAꂼ̃bNĂjB
+                // ڑ͐ɕĂ̂ŁAbNĂ鑗M͂ɔB
+                if (_informationVersion3 != null)
+                {
+                    lock (_sendLock)
+                    {
+                        if (_informationVersion3.MyAes256 != null)
+                        {
+                            _informationVersion3.MyAes256.Dispose();
+                            _informationVersion3.MyAes256 = null;
+                        }
+                    }
+
+                    lock (_receiveLock)
+                    {
+                        if (_informationVersion3.OtherAes256 != null)
+                        {
+                            _informationVersion3.OtherAes256.Dispose();
+                            _informationVersion3.OtherAes256 = null;
+                        }
+                    }
+                }
             }
         }
 
@@ -15,28 +15,27 @@ namespace Library.Net.Connections
     {
         private static readonly BufferManager _bufferManager = BufferManager.Instance;
         private static readonly ThreadLocal<Encoding> _threadLocalEncoding = new ThreadLocal<Encoding>(() => new UTF8Encoding(false));
-        private static readonly byte[] _vector;
+        private static readonly SipHash _sipHash;
 
         static ItemUtilities()
         {
-            _vector = new byte[4];
+            byte[] key = new byte[16];
 
             using (var rng = RandomNumberGenerator.Create())
             {
-                rng.GetBytes(_vector);
+                rng.GetBytes(key);
             }
+
+            _sipHash = new SipHash(key);
         }
 
         public static int GetHashCode(byte[] buffer)
         {
             if (buffer == null) throw new ArgumentNullException("buffer");
 
-            return (BitConverter.ToInt32(Crc32_Castagnoli.ComputeHash(
-                new ArraySegment<byte>[]
-                {
-                    new ArraySegment<byte>(_vector),
-                    new ArraySegment<byte>(buffer),
-                }), 0));
+            long hash = _sipHash.ComputeHash(buffer);
+
+            return (int)(hash ^ (hash >> 32));
         }
 
         public static void Write(Stream stream, byte type, Stream exportStream)
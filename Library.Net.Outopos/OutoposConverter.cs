@@ -20,26 +20,22 @@ namespace Library.Net.Outopos
         private static readonly BufferManager _bufferManager = BufferManager.Instance;
         private static readonly Regex _base64Regex = new Regex(@"^([a-zA-Z0-9\-_]*).*?$", RegexOptions.Compiled | RegexOptions.Singleline);
 
-        private static Stream ToStream<T>(ItemBase<T> item)
+        // 種類 (1 バイト)、本体、CRC32C (4 バイト) を BufferManager のバッファ一つに続けて書き込む。
+        // 呼び出し側は使い終わったら segment.Array を _bufferManager に返すこと。
+        private static ArraySegment<byte> ToBuffer<T>(ItemBase<T> item)
                 where T : ItemBase<T>
         {
-            Stream stream = null;
-
             try
             {
-                stream = new RangeStream(item.Export(_bufferManager));
-
-                List<KeyValuePair<byte, Stream>> list = new List<KeyValuePair<byte, Stream>>();
-
-                try
+                using (Stream stream = new RangeStream(item.Export(_bufferManager)))
+                using (BufferStream deflateBufferStream = new BufferStream(_bufferManager))
                 {
-                    stream.Seek(0, SeekOrigin.Begin);
-
-                    BufferStream deflateBufferStream = null;
+                    Stream targetStream = stream;
+                    byte type = (byte)ConvertCompressionAlgorithm.None;
 
                     try
                     {
-                        deflateBufferStream = new BufferStream(_bufferManager);
+                        stream.Seek(0, SeekOrigin.Begin);
 
                         using (DeflateStream deflateStream = new DeflateStream(deflateBufferStream, CompressionMode.Compress, true))
                         {
@@ -65,144 +61,127 @@ namespace Library.Net.Outopos
                             }
                         }
 
-                        deflateBufferStream.Seek(0, SeekOrigin.Begin);
-
-                        list.Add(new KeyValuePair<byte, Stream>((byte)ConvertCompressionAlgorithm.Deflate, deflateBufferStream));
+                        // 長さが同じなら無圧縮を選ぶ。
+                        if (deflateBufferStream.Length < stream.Length)
+                        {
+                            targetStream = deflateBufferStream;
+                            type = (byte)ConvertCompressionAlgorithm.Deflate;
+                        }
                     }
                     catch (Exception)
                     {
-                        if (deflateBufferStream != null)
-                        {
-                            deflateBufferStream.Dispose();
-                        }
+
                     }
-                }
-                catch (Exception)
-                {
 
-                }
+#if DEBUG
+                    if (targetStream.Length != stream.Length)
+                    {
+                        Debug.WriteLine("OutoposConverter ToBuffer : {0}→{1} {2}",
+                            NetworkConverter.ToSizeString(stream.Length),
+                            NetworkConverter.ToSizeString(targetStream.Length),
+                            NetworkConverter.ToSizeString(targetStream.Length - stream.Length));
+                    }
+#endif
 
-                list.Add(new KeyValuePair<byte, Stream>((byte)ConvertCompressionAlgorithm.None, stream));
+                    int length = (int)targetStream.Length;
+                    byte[] buffer = _bufferManager.TakeBuffer(1 + length + 4);
 
-                list.Sort((x, y) =>
-                {
-                    int c = x.Value.Length.CompareTo(y.Value.Length);
-                    if (c != 0) return c;
+                    try
+                    {
+                        buffer[0] = type;
 
-                    return x.Key.CompareTo(y.Key);
-                });
+                        targetStream.Seek(0, SeekOrigin.Begin);
 
-#if DEBUG
-                if (list[0].Value.Length != stream.Length)
-                {
-                    Debug.WriteLine("OutoposConverter ToStream : {0}→{1} {2}",
-                        NetworkConverter.ToSizeString(stream.Length),
-                        NetworkConverter.ToSizeString(list[0].Value.Length),
-                        NetworkConverter.ToSizeString(list[0].Value.Length - stream.Length));
-                }
-#endif
-
-                for (int i = 1; i < list.Count; i++)
-                {
-                    list[i].Value.Dispose();
-                }
+                        for (int count = 0, i = -1; count < length; count += i)
+                        {
+                            if ((i = targetStream.Read(buffer, 1 + count, length - count)) <= 0) throw new EndOfStreamException();
+                        }
 
-                BufferStream metadataStream = new BufferStream(_bufferManager);
-                metadataStream.WriteByte((byte)list[0].Key);
+                        var crc = Crc32_Castagnoli.ComputeHash(buffer, 0, 1 + length);
+                        Unsafe.Copy(crc, 0, buffer, 1 + length, crc.Length);
 
-                var dataStream = new UniteStream(metadataStream, list[0].Value);
+                        return new ArraySegment<byte>(buffer, 0, 1 + length + 4);
+                    }
+                    catch (Exception)
+                    {
+                        _bufferManager.ReturnBuffer(buffer);
 
-                MemoryStream crcStream = new MemoryStream(Crc32_Castagnoli.ComputeHash(dataStream));
-                return new UniteStream(dataStream, crcStream);
+                        throw;
+                    }
+                }
             }
             catch (Exception ex)
             {
-                if (stream != null)
-                {
-                    stream.Dispose();
-                }
-
                 throw new ArgumentException(ex.Message, ex);
             }
         }
 
-        private static T FromStream<T>(Stream stream)
+        private static T FromBuffer<T>(byte[] buffer, int offset, int length)
             where T : ItemBase<T>
         {
             try
             {
-                using (var targetStream = new RangeStream(stream, true))
-                {
-                    using (Stream verifyStream = new RangeStream(targetStream, 0, targetStream.Length - 4, true))
-                    {
-                        byte[] verifyCrc = Crc32_Castagnoli.ComputeHash(verifyStream);
-                        byte[] orignalCrc = new byte[4];
+                if (length < 1 + 4) throw new ArgumentException("ArgumentException");
 
-                        using (RangeStream crcStream = new RangeStream(targetStream, targetStream.Length - 4, 4, true))
-                        {
-                            crcStream.Read(orignalCrc, 0, orignalCrc.Length);
-                        }
+                var verifyCrc = Crc32_Castagnoli.ComputeHash(buffer, offset, length - 4);
 
-                        if (!Unsafe.Equals(verifyCrc, orignalCrc))
-                        {
-                            throw new ArgumentException("Crc Error");
-                        }
-                    }
+                if (!Unsafe.Equals(verifyCrc, 0, buffer, offset + (length - 4), verifyCrc.Length))
+                {
+                    throw new ArgumentException("Crc Error");
+                }
 
-                    targetStream.Seek(0, SeekOrigin.Begin);
-                    byte type = (byte)targetStream.ReadByte();
+                byte type = buffer[offset];
 
-                    using (Stream dataStream = new RangeStream(targetStream, targetStream.Position, targetStream.Length - targetStream.Position - 4, true))
+                using (Stream dataStream = new MemoryStream(buffer, offset + 1, length - (1 + 4), false))
+                {
+                    if (type == (byte)ConvertCompressionAlgorithm.None)
                     {
-                        if (type == (byte)ConvertCompressionAlgorithm.None)
-                        {
-                            return ItemBase<T>.Import(dataStream, _bufferManager);
-                        }
-                        else if (type == (byte)ConvertCompressionAlgorithm.Deflate)
+                        return ItemBase<T>.Import(dataStream, _bufferManager);
+                    }
+                    else if (type == (byte)ConvertCompressionAlgorithm.Deflate)
+                    {
+                        using (BufferStream deflateBufferStream = new BufferStream(_bufferManager))
                         {
-                            using (BufferStream deflateBufferStream = new BufferStream(_bufferManager))
+                            byte[] decompressBuffer = null;
+
+                            try
                             {
-                                byte[] decompressBuffer = null;
+                                decompressBuffer = _bufferManager.TakeBuffer(1024 * 4);
 
-                                try
+                                using (DeflateStream deflateStream = new DeflateStream(dataStream, CompressionMode.Decompress, true))
                                 {
-                                    decompressBuffer = _bufferManager.TakeBuffer(1024 * 4);
+                                    int i = -1;
 
-                                    using (DeflateStream deflateStream = new DeflateStream(dataStream, CompressionMode.Decompress, true))
+                                    while ((i = deflateStream.Read(decompressBuffer, 0, decompressBuffer.Length)) > 0)
                                     {
-                                        int i = -1;
-
-                                        while ((i = deflateStream.Read(decompressBuffer, 0, decompressBuffer.Length)) > 0)
-                                        {
-                                            deflateBufferStream.Write(decompressBuffer, 0, i);
-                                        }
+                                        deflateBufferStream.Write(decompressBuffer, 0, i);
                                     }
                                 }
-                                finally
+                            }
+                            finally
+                            {
+                                if (decompressBuffer != null)
                                 {
-                                    if (decompressBuffer != null)
-                                    {
-                                        _bufferManager.ReturnBuffer(decompressBuffer);
-                                    }
+                                    _bufferManager.ReturnBuffer(decompressBuffer);
                                 }
+                            }
 
 #if DEBUG
-                                Debug.WriteLine("OutoposConverter FromStream : {0}→{1} {2}",
-                                    NetworkConverter.ToSizeString(dataStream.Length),
-                                    NetworkConverter.ToSizeString(deflateBufferStream.Length),
-                                    NetworkConverter.ToSizeString(dataStream.Length - deflateBufferStream.Length));
+                            Debug.WriteLine("OutoposConverter FromBuffer : {0}→{1} {2}",
+                                NetworkConverter.ToSizeString(dataStream.Length),
+                                NetworkConverter.ToSizeString(deflateBufferStream.Length),
+                                NetworkConverter.ToSizeString(dataStream.Length - deflateBufferStream.Length));
 #endif
 
-                                deflateBufferStream.Seek(0, SeekOrigin.Begin);
+                            deflateBufferStream.Seek(0, SeekOrigin.Begin);
 
-                                return ItemBase<T>.Import(deflateBufferStream, _bufferManager);
-                            }
-                        }
-                        else
-                        {
-                            throw new ArgumentException("ArgumentException");
+                            return ItemBase<T>.Import(deflateBufferStream, _bufferManager);
                         }
                     }
+                    else
+                    {
+                        throw new ArgumentException("ArgumentException");
+                    }
                 }
             }
             catch (Exception e)
@@ -211,38 +190,30 @@ namespace Library.Net.Outopos
             }
         }
 
-        private static string ToBase64String(Stream stream)
+        private static string ToBase64String<T>(ItemBase<T> item)
+                where T : ItemBase<T>
         {
-            using (var targetStream = new RangeStream(stream, true))
-            {
-                byte[] buffer = null;
-
-                try
-                {
-                    buffer = _bufferManager.TakeBuffer((int)targetStream.Length);
-                    targetStream.Seek(0, SeekOrigin.Begin);
-                    targetStream.Read(buffer, 0, (int)targetStream.Length);
+            var segment = OutoposConverter.ToBuffer<T>(item);
 
-                    return NetworkConverter.ToBase64UrlString(buffer, 0, (int)targetStream.Length);
-                }
-                finally
-                {
-                    if (buffer != null)
-                    {
-                        _bufferManager.ReturnBuffer(buffer);
-                    }
-                }
+            try
+            {
+                return NetworkConverter.ToBase64UrlString(segment.Array, segment.Offset, segment.Count);
+            }
+            finally
+            {
+                _bufferManager.ReturnBuffer(segment.Array);
             }
         }
 
-        private static Stream FromBase64String(string value)
+        private static T FromBase64String<T>(string value)
+            where T : ItemBase<T>
         {
             var match = _base64Regex.Match(value);
             if (!match.Success) throw new ArgumentException();
 
-            value = match.Groups[1].Value;
+            var buffer = NetworkConverter.FromBase64UrlString(match.Groups[1].Value);
 
-            return new MemoryStream(NetworkConverter.FromBase64UrlString(value));
+            return OutoposConverter.FromBuffer<T>(buffer, 0, buffer.Length);
         }
 
         public static string ToNodeString(Node item)
@@ -251,10 +222,7 @@ namespace Library.Net.Outopos
 
             try
             {
-                using (Stream stream = OutoposConverter.ToStream<Node>(item))
-                {
-                    return "Node:" + OutoposConverter.ToBase64String(stream);
-                }
+                return "Node:" + OutoposConverter.ToBase64String<Node>(item);
             }
             catch (Exception)
             {
@@ -269,10 +237,7 @@ namespace Library.Net.Outopos
 
             try
             {
-                using (Stream stream = OutoposConverter.FromBase64String(item.Remove(0, "Node:".Length)))
-                {
-                    return OutoposConverter.FromStream<Node>(stream);
-                }
+                return OutoposConverter.FromBase64String<Node>(item.Remove(0, "Node:".Length));
             }
             catch (Exception)
             {
@@ -286,10 +251,7 @@ namespace Library.Net.Outopos
 
             try
             {
-                using (Stream stream = OutoposConverter.ToStream<Wiki>(item))
-                {
-                    return "Wiki:" + OutoposConverter.ToBase64String(stream);
-                }
+                return "Wiki:" + OutoposConverter.ToBase64String<Wiki>(item);
             }
             catch (Exception)
             {
@@ -304,10 +266,7 @@ namespace Library.Net.Outopos
 
             try
             {
-                using (Stream stream = OutoposConverter.FromBase64String(item.Remove(0, "Wiki:".Length)))
-                {
-                    return OutoposConverter.FromStream<Wiki>(stream);
-                }
+                return OutoposConverter.FromBase64String<Wiki>(item.Remove(0, "Wiki:".Length));
             }
             catch (Exception)
             {
@@ -321,10 +280,7 @@ namespace Library.Net.Outopos
 
             try
             {
-                using (Stream stream = OutoposConverter.ToStream<Chat>(item))
-                {
-                    return "Chat:" + OutoposConverter.ToBase64String(stream);
-                }
+                return "Chat:" + OutoposConverter.ToBase64String<Chat>(item);
             }
             catch (Exception)
             {
@@ -339,10 +295,7 @@ namespace Library.Net.Outopos
 
             try
             {
-                using (Stream stream = OutoposConverter.FromBase64String(item.Remove(0, "Chat:".Length)))
-                {
-                    return OutoposConverter.FromStream<Chat>(stream);
-                }
+                return OutoposConverter.FromBase64String<Chat>(item.Remove(0, "Chat:".Length));
             }
             catch (Exception)
             {
@@ -18,6 +18,9 @@ namespace Library.Net
 
         private LinkedList<T>[] _nodesList;
 
+        // バケット内の ID の照合に使い回す。ThisLock の中でだけ使う。
+        private UnsafeBatch _batch;
+
         private static byte[] _distanceHashtable = new byte[256];
 
         private readonly object _thisLock = new object();
@@ -74,9 +77,31 @@ namespace Library.Net
 
                     _baseNode = value;
 
+                    // BaseNodeと同じ長さのIDはまとめて距離を求める。
+                    var baseId = (_baseNode != null) ? _baseNode.Id : null;
+                    Func<T, bool> isSameLength = (n) => baseId != null && baseId.Length > 0 && n.Id != null && n.Id.Length == baseId.Length;
+                    var sameLengthList = tempList.Where(isSameLength).ToList();
+
+                    var distances = new int[sameLengthList.Count];
+
+                    if (sameLengthList.Count > 0)
+                    {
+                        var ids = Kademlia<T>.Pack(baseId.Length, null, sameLengthList);
+                        XorDistance.Buckets(baseId, ids, sameLengthList.Count, baseId.Length, distances);
+                    }
+
+                    int index = 0;
+
                     foreach (var item in tempList)
                     {
-                        this.Add(item);
+                        if (isSameLength(item))
+                        {
+                            this.Add(item, distances[index++]);
+                        }
+                        else
+                        {
+                            this.Add(item);
+                        }
                     }
                 }
             }
@@ -174,230 +199,88 @@ namespace Library.Net
             }
         }
 
-        private static readonly ThreadLocal<InfoManager> _threadLocalInfoManager = new ThreadLocal<InfoManager>(() => new InfoManager());
+        private static readonly ThreadLocal<byte[]> _threadLocalBuffer = new ThreadLocal<byte[]>(() => new byte[0]);
 
-        public static IEnumerable<T> Search(byte[] targetId, byte[] baseId, IEnumerable<T> nodeList, int count)
+        // targetIdの長さに揃えたIDを詰めて並べる。短いIDは0埋め、長いIDは切り詰める（Unsafe.Xorと同じ扱い）。
+        private static byte[] Pack(int idLength, byte[] baseId, IList<T> nodes)
         {
-            if (targetId == null) throw new ArgumentNullException("targetId");
-            if (baseId == null) throw new ArgumentNullException("baseId");
-            if (nodeList == null) throw new ArgumentNullException("nodeList");
-
-            if (count == 0) yield break;
+            int count = nodes.Count + ((baseId != null) ? 1 : 0);
+            var buffer = _threadLocalBuffer.Value;
 
-            int InfoIndex = 0;
-
-            var infoManager = _threadLocalInfoManager.Value;
-            infoManager.SetBufferSize(targetId.Length);
-
-            int linkIndex = 0;
-
-            Info firstItem = null;
-            Info lastItem = null;
+            if (buffer.Length < count * idLength)
+            {
+                buffer = new byte[count * idLength];
+                _threadLocalBuffer.Value = buffer;
+            }
 
-            var baseItem = infoManager.GetInfo(InfoIndex++);
-            Unsafe.Xor(targetId, baseId, baseItem.Xor);
-            baseItem.Node = default(T);
+            int offset = 0;
 
-            // 初期化。
+            if (baseId != null)
             {
-                firstItem = baseItem;
-                lastItem = baseItem;
-
-                linkIndex++;
+                Kademlia<T>.Pack(baseId, idLength, buffer, offset);
+                offset += idLength;
             }
 
-            // 挿入ソート（countが小さい場合、countで比較範囲を狭めた挿入ソートが高速。）
-            foreach (var node in nodeList)
+            foreach (var node in nodes)
             {
-                var targetItem = infoManager.GetInfo(InfoIndex++);
-                Unsafe.Xor(targetId, node.Id, targetItem.Xor);
-                targetItem.Node = node;
-
-                var currentItem = lastItem;
-
-                while (currentItem != null)
-                {
-                    if (Unsafe.Compare(currentItem.Xor, targetItem.Xor) <= 0) break;
-
-                    currentItem = currentItem.Previous;
-                }
-
-                //　最前列に挿入。
-                if (currentItem == null)
-                {
-                    firstItem.Previous = targetItem;
-                    targetItem.Next = firstItem;
-                    firstItem = targetItem;
-                }
-                // 最後尾に挿入。
-                else if (lastItem == currentItem)
-                {
-                    currentItem.Next = targetItem;
-                    targetItem.Previous = currentItem;
-                    lastItem = targetItem;
-                }
-                // 中間に挿入。
-                else
-                {
-                    var swapItem = currentItem.Next;
-
-                    currentItem.Next = targetItem;
-                    targetItem.Previous = currentItem;
-
-                    targetItem.Next = swapItem;
-                    swapItem.Previous = targetItem;
-                }
-
-                linkIndex++;
-
-                // count数を超えている場合はlastItemを削除する。
-                if (linkIndex > count)
-                {
-                    var previousItem = lastItem.Previous;
+                Kademlia<T>.Pack(node.Id, idLength, buffer, offset);
+                offset += idLength;
+            }
 
-                    previousItem.Next = null;
-                    lastItem = previousItem;
+            return buffer;
+        }
 
-                    linkIndex--;
-                }
-            }
+        private static void Pack(byte[] id, int idLength, byte[] buffer, int offset)
+        {
+            if (id == null) throw new ArgumentNullException("id");
 
-            for (var currentItem = firstItem; currentItem != null; currentItem = currentItem.Next)
-            {
-                // baseItem以上に距離が近いノードのみ許可する。
-                if (currentItem == baseItem) yield break;
+            int length = Math.Min(id.Length, idLength);
 
-                yield return currentItem.Node;
-            }
+            Unsafe.Copy(id, 0, buffer, offset, length);
+            if (length < idLength) Unsafe.Zero(buffer, offset + length, idLength - length);
         }
 
-        public static IEnumerable<T> Search(byte[] targetId, IEnumerable<T> nodeList, int count)
+        public static IEnumerable<T> Search(byte[] targetId, byte[] baseId, IEnumerable<T> nodeList, int count)
         {
             if (targetId == null) throw new ArgumentNullException("targetId");
+            if (baseId == null) throw new ArgumentNullException("baseId");
             if (nodeList == null) throw new ArgumentNullException("nodeList");
 
-            if (count == 0) yield break;
+            if (count <= 0) yield break;
 
-            int InfoIndex = 0;
+            var nodes = nodeList.ToList();
 
-            var infoManager = _threadLocalInfoManager.Value;
-            infoManager.SetBufferSize(targetId.Length);
+            // baseIdを先頭に置く。距離が等しい場合はインデックスの小さい順なので、baseIdと等距離のノードは除外される。
+            var ids = Kademlia<T>.Pack(targetId.Length, baseId, nodes);
+            var result = new int[Math.Min(count, nodes.Count + 1)];
+            int resultCount = XorDistance.TopK(targetId, ids, nodes.Count + 1, targetId.Length, count, result);
 
-            int linkIndex = 0;
-
-            Info firstItem = null;
-            Info lastItem = null;
-
-            // 挿入ソート（countが小さい場合、countで比較範囲を狭めた挿入ソートが高速。）
-            foreach (var node in nodeList)
+            for (int i = 0; i < resultCount; i++)
             {
-                var targetItem = infoManager.GetInfo(InfoIndex++);
-                Unsafe.Xor(targetId, node.Id, targetItem.Xor);
-                targetItem.Node = node;
+                // baseIdより距離が近いノードのみ許可する。
+                if (result[i] == 0) yield break;
 
-                var currentItem = lastItem;
-
-                while (currentItem != null)
-                {
-                    if (Unsafe.Compare(currentItem.Xor, targetItem.Xor) <= 0) break;
-
-                    currentItem = currentItem.Previous;
-                }
-
-                // 初期化。
-                if (firstItem == null && lastItem == null)
-                {
-                    firstItem = targetItem;
-                    lastItem = targetItem;
-                }
-                //　最前列に挿入。
-                else if (currentItem == null)
-                {
-                    firstItem.Previous = targetItem;
-                    targetItem.Next = firstItem;
-                    firstItem = targetItem;
-                }
-                // 最後尾に挿入。
-                else if (lastItem == currentItem)
-                {
-                    currentItem.Next = targetItem;
-                    targetItem.Previous = currentItem;
-                    lastItem = targetItem;
-                }
-                // 中間に挿入。
-                else
-                {
-                    var swapItem = currentItem.Next;
-
-                    currentItem.Next = targetItem;
-                    targetItem.Previous = currentItem;
-
-                    targetItem.Next = swapItem;
-                    swapItem.Previous = targetItem;
-                }
-
-                linkIndex++;
-
-                // count数を超えている場合はlastItemを削除する。
-                if (linkIndex > count)
-                {
-                    var previousItem = lastItem.Previous;
-
-                    previousItem.Next = null;
-                    lastItem = previousItem;
-
-                    linkIndex--;
-                }
-            }
-
-            for (var currentItem = firstItem; currentItem != null; currentItem = currentItem.Next)
-            {
-                yield return currentItem.Node;
+                yield return nodes[result[i] - 1];
             }
         }
 
-        // 自前のLinkedListのためのアイテムを用意。
-        private sealed class Info
+        public static IEnumerable<T> Search(byte[] targetId, IEnumerable<T> nodeList, int count)
         {
-            public T Node { get; set; }
-            public byte[] Xor { get; set; }
+            if (targetId == null) throw new ArgumentNullException("targetId");
+            if (nodeList == null) throw new ArgumentNullException("nodeList");
 
-            public Info Previous { get; set; }
-            public Info Next { get; set; }
-        }
+            if (count <= 0) yield break;
 
-        // Infoのプールを用意し、高速化を図る。
-        private class InfoManager
-        {
-            private List<Info> _infos = new List<Info>();
-            private int _bufferSize;
+            var nodes = nodeList.ToList();
+            if (nodes.Count == 0) yield break;
 
-            public void SetBufferSize(int bufferSize)
-            {
-                if (bufferSize <= 0) throw new ArgumentOutOfRangeException("bufferSize");
+            var ids = Kademlia<T>.Pack(targetId.Length, null, nodes);
+            var result = new int[Math.Min(count, nodes.Count)];
+            int resultCount = XorDistance.TopK(targetId, ids, nodes.Count, targetId.Length, count, result);
 
-                if (_bufferSize != bufferSize)
-                {
-                    _infos.Clear();
-                }
-
-                _bufferSize = bufferSize;
-            }
-
-            public Info GetInfo(int index)
+            for (int i = 0; i < resultCount; i++)
             {
-                if (index > 1024) return new Info() { Xor = new byte[_bufferSize] };
-
-                for (int i = ((index + 1) - _infos.Count) - 1; i >= 0; i--)
-                {
-                    _infos.Add(new Info() { Xor = new byte[_bufferSize] });
-                }
-
-                var info = _infos[index];
-                info.Previous = null;
-                info.Next = null;
-
-                return info;
+                yield return nodes[result[i]];
             }
         }
 
@@ -419,7 +302,7 @@ namespace Library.Net
                 // 生存率の高いNodeはFirstに、そうでないNodeはLastに
                 if (targetList != null)
                 {
-                    var orignal = targetList.FirstOrDefault(n => Unsafe.Equals(n.Id, item.Id));
+                    var orignal = this.Find(targetList, item.Id);
 
                     if (orignal != null)
                     {
@@ -454,7 +337,15 @@ namespace Library.Net
 
             lock (this.ThisLock)
             {
-                int i = Kademlia<T>.Distance(this.BaseNode.Id, item.Id) - 1;
+                this.Add(item, Kademlia<T>.Distance(this.BaseNode.Id, item.Id));
+            }
+        }
+
+        private void Add(T item, int distance)
+        {
+            lock (this.ThisLock)
+            {
+                int i = distance - 1;
                 if (i == -1) return;
 
                 var targetList = _nodesList[i];
@@ -462,7 +353,7 @@ namespace Library.Net
                 // 生存率の高いNodeはFirstに、そうでないNodeはLastに
                 if (targetList != null)
                 {
-                    var orignal = targetList.FirstOrDefault(n => Unsafe.Equals(n.Id, item.Id));
+                    var orignal = this.Find(targetList, item.Id);
 
                     if (orignal == null)
                     {
@@ -481,6 +372,42 @@ namespace Library.Net
             }
         }
 
+        // バケットの中から id と同じ ID の Node を探す。バケットの ID を詰めて、1 回のネイティブ呼び出しでまとめて比べる。
+        private T Find(LinkedList<T> targetList, byte[] id)
+        {
+            lock (this.ThisLock)
+            {
+                if (id.Length == 0) return targetList.FirstOrDefault(n => n.Id.Length == 0);
+
+                if (_batch == null || _batch.OperandLength != id.Length) _batch = new UnsafeBatch(id.Length, _column + 1);
+                _batch.Clear();
+
+                int target = _batch.AddOperand(id);
+
+                foreach (var node in targetList)
+                {
+                    if (node.Id.Length != id.Length) continue;
+
+                    _batch.AddEquals(target, _batch.AddOperand(node.Id));
+                }
+
+                if (_batch.Count == 0) return default(T);
+
+                _batch.Execute();
+
+                int index = 0;
+
+                foreach (var node in targetList)
+                {
+                    if (node.Id.Length != id.Length) continue;
+
+                    if (_batch.GetEquals(index++)) return node;
+                }
+
+                return default(T);
+            }
+        }
+
         public IEnumerable<T> Search(byte[] targetId, int count)
         {
             if (_baseNode == null) throw new ArgumentNullException("BaseNode");
@@ -0,0 +1,187 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Library.Net
+{
+    // 詰めて並べた ID 群に対する XOR 距離の計算。
+    // ids は idLength バイトの ID を count 個、隙間なく並べたもの。長さの異なる ID は呼び出し側で 0 埋め、または切り詰めておく。
+    internal unsafe static class XorDistance
+    {
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int TopKDelegate(byte* target, byte* ids, int count, int idLength, int k, int* result);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void BucketsDelegate(byte* target, byte* ids, int count, int idLength, int* result);
+
+        private static TopKDelegate _topK;
+        private static BucketsDelegate _buckets;
+#endif
+
+        private static byte[] _distanceHashtable = new byte[256];
+
+        static XorDistance()
+        {
+            for (int i = 1; i < 256; i++)
+            {
+                _distanceHashtable[i] = (byte)(_distanceHashtable[i >> 1] + 1);
+            }
+
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x86.dll");
+                }
+
+                _topK = _nativeLibraryManager.GetMethod<TopKDelegate>("xor_distance_topk");
+                _buckets = _nativeLibraryManager.GetMethod<BucketsDelegate>("xor_distance_buckets");
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// target に近い順に k 個の ID のインデックスを result に書き込み、その数を返します。距離が等しい場合はインデックスの小さい順です
+        /// </summary>
+        public static int TopK(byte[] target, byte[] ids, int count, int idLength, int k, int[] result)
+        {
+            if (target == null) throw new ArgumentNullException("target");
+            if (ids == null) throw new ArgumentNullException("ids");
+            if (result == null) throw new ArgumentNullException("result");
+            if (idLength <= 0 || target.Length < idLength) throw new ArgumentOutOfRangeException("idLength");
+            if (count < 0 || ids.Length < (long)count * idLength) throw new ArgumentOutOfRangeException("count");
+            if (result.Length < Math.Min(k, count)) throw new ArgumentOutOfRangeException("result");
+
+            if (count == 0 || k <= 0) return 0;
+
+#if Mono
+            return XorDistance.TopKManaged(target, ids, count, idLength, k, result);
+#else
+            if (_topK == null) return XorDistance.TopKManaged(target, ids, count, idLength, k, result);
+
+            fixed (byte* p_target = target, p_ids = ids)
+            fixed (int* p_result = result)
+            {
+                return _topK(p_target, p_ids, count, idLength, k, p_result);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// target と各 ID の XOR のビット長 (Kademlia のバケット番号 + 1、同じ ID なら 0) を result に書き込みます
+        /// </summary>
+        public static void Buckets(byte[] target, byte[] ids, int count, int idLength, int[] result)
+        {
+            if (target == null) throw new ArgumentNullException("target");
+            if (ids == null) throw new ArgumentNullException("ids");
+            if (result == null) throw new ArgumentNullException("result");
+            if (idLength <= 0 || target.Length < idLength) throw new ArgumentOutOfRangeException("idLength");
+            if (count < 0 || ids.Length < (long)count * idLength) throw new ArgumentOutOfRangeException("count");
+            if (result.Length < count) throw new ArgumentOutOfRangeException("result");
+
+            if (count == 0) return;
+
+#if Mono
+            XorDistance.BucketsManaged(target, ids, count, idLength, result);
+#else
+            if (_buckets == null)
+            {
+                XorDistance.BucketsManaged(target, ids, count, idLength, result);
+
+                return;
+            }
+
+            fixed (byte* p_target = target, p_ids = ids)
+            fixed (int* p_result = result)
+            {
+                _buckets(p_target, p_ids, count, idLength, p_result);
+            }
+#endif
+        }
+
+        private static int Compare(byte[] target, byte[] ids, int idLength, int x, int y)
+        {
+            int xOffset = x * idLength;
+            int yOffset = y * idLength;
+
+            for (int i = 0; i < idLength; i++)
+            {
+                int dx = target[i] ^ ids[xOffset + i];
+                int dy = target[i] ^ ids[yOffset + i];
+
+                if (dx != dy) return dx - dy;
+            }
+
+            return x - y;
+        }
+
+        private static int TopKManaged(byte[] target, byte[] ids, int count, int idLength, int k, int[] result)
+        {
+            if (k > count) k = count;
+
+            int size = 0;
+
+            // 挿入ソート。埋まった後は末尾より遠い ID を比較一回で捨てる。
+            for (int i = 0; i < count; i++)
+            {
+                if (size == k)
+                {
+                    if (XorDistance.Compare(target, ids, idLength, i, result[k - 1]) > 0) continue;
+
+                    size--;
+                }
+
+                int position = size;
+
+                while (position > 0 && XorDistance.Compare(target, ids, idLength, i, result[position - 1]) < 0)
+                {
+                    result[position] = result[position - 1];
+                    position--;
+                }
+
+                result[position] = i;
+                size++;
+            }
+
+            return size;
+        }
+
+        private static void BucketsManaged(byte[] target, byte[] ids, int count, int idLength, int[] result)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                int offset = i * idLength;
+                int digit = 0;
+
+                for (int j = 0; j < idLength; j++)
+                {
+                    digit = _distanceHashtable[target[j] ^ ids[offset + j]];
+
+                    if (digit != 0)
+                    {
+                        digit += (idLength - (j + 1)) * 8;
+
+                        break;
+                    }
+                }
+
+                result[i] = digit;
+            }
+        }
+    }
+}
@@ -0,0 +1,388 @@
+using System;
+using System.IO;
+using System.Runtime.InteropServices;
+using System.Security;
+using System.Security.Cryptography;
+
+namespace Library.Security
+{
+    // AES-256 の in-place 暗号化。AES-NI が使えない環境では System.Security.Cryptography.Aes にフォールバックする。
+    public unsafe sealed class Aes256 : ManagerBase
+    {
+        private byte[] _key;
+        private IntPtr _context;
+
+        private volatile bool _disposed;
+
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate IntPtr CreateDelegate(byte* key);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void FreeDelegate(IntPtr context);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void CbcEncryptDelegate(IntPtr context, byte* iv, byte* buffer, int length);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void CbcDecryptDelegate(IntPtr context, byte* iv, byte* buffer, int length, int threads);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void CtrDelegate(IntPtr context, byte* counter, byte* buffer, int length, int threads);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int CbcHmacSha256Delegate(IntPtr context, byte* iv, byte* hmacKey, int hmacKeyLength, byte* buffer, int headerLength, int length);
+
+        private static CreateDelegate _create;
+        private static FreeDelegate _free;
+        private static CbcEncryptDelegate _cbcEncrypt;
+        private static CbcDecryptDelegate _cbcDecrypt;
+        private static CtrDelegate _ctr;
+        private static CbcHmacSha256Delegate _cbcHmacSha256Encrypt;
+        private static CbcHmacSha256Delegate _cbcHmacSha256Decrypt;
+#endif
+
+        static Aes256()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x86.dll");
+                }
+
+                // 古い DLL では一部の関数が見つからない。途中まで設定されて IsNative が true になることがないよう、
+                // 全て揃ってから設定する。
+                var create = _nativeLibraryManager.GetMethod<CreateDelegate>("aes256_create");
+                var free = _nativeLibraryManager.GetMethod<FreeDelegate>("aes256_free");
+                var cbcEncrypt = _nativeLibraryManager.GetMethod<CbcEncryptDelegate>("aes256_cbc_encrypt");
+                var cbcDecrypt = _nativeLibraryManager.GetMethod<CbcDecryptDelegate>("aes256_cbc_decrypt");
+                var ctr = _nativeLibraryManager.GetMethod<CtrDelegate>("aes256_ctr");
+                var cbcHmacSha256Encrypt = _nativeLibraryManager.GetMethod<CbcHmacSha256Delegate>("aes256_cbc_hmac_sha256_encrypt");
+                var cbcHmacSha256Decrypt = _nativeLibraryManager.GetMethod<CbcHmacSha256Delegate>("aes256_cbc_hmac_sha256_decrypt");
+
+                _free = free;
+                _cbcEncrypt = cbcEncrypt;
+                _cbcDecrypt = cbcDecrypt;
+                _ctr = ctr;
+                _cbcHmacSha256Encrypt = cbcHmacSha256Encrypt;
+                _cbcHmacSha256Decrypt = cbcHmacSha256Decrypt;
+                _create = create;
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        public Aes256(byte[] key)
+        {
+            if (key == null) throw new ArgumentNullException("key");
+            if (key.Length != 32) throw new ArgumentOutOfRangeException("key");
+
+            _key = key.Clone() as byte[];
+
+#if Mono
+
+#else
+            if (_create != null)
+            {
+                fixed (byte* p_key = _key)
+                {
+                    _context = _create(p_key);
+                }
+            }
+#endif
+        }
+
+        public bool IsNative
+        {
+            get
+            {
+                return _context != IntPtr.Zero;
+            }
+        }
+
+        private static void Check(byte[] buffer, int offset, int length)
+        {
+            if (buffer == null) throw new ArgumentNullException("buffer");
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (length < 0 || (buffer.Length - offset) < length) throw new ArgumentOutOfRangeException("length");
+        }
+
+        /// <summary>
+        /// CBC で buffer を in-place に暗号化する。length は 16 の倍数、iv は最後の暗号ブロックに更新される。
+        /// </summary>
+        public void CbcEncrypt(byte[] iv, byte[] buffer, int offset, int length)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (iv == null) throw new ArgumentNullException("iv");
+            if (iv.Length != 16) throw new ArgumentOutOfRangeException("iv");
+            Aes256.Check(buffer, offset, length);
+            if (length % 16 != 0) throw new ArgumentOutOfRangeException("length");
+
+            if (length == 0) return;
+
+#if Mono
+
+#else
+            if (_context != IntPtr.Zero)
+            {
+                fixed (byte* p_iv = iv)
+                fixed (byte* p_buffer = buffer)
+                {
+                    _cbcEncrypt(_context, p_iv, p_buffer + offset, length);
+                }
+
+                return;
+            }
+#endif
+
+            using (var aes = Aes256.CreateAes(CipherMode.CBC))
+            using (var transform = aes.CreateEncryptor(_key, iv))
+            {
+                var result = new byte[length];
+                transform.TransformBlock(buffer, offset, length, result, 0);
+
+                Array.Copy(result, 0, buffer, offset, length);
+                Array.Copy(result, length - 16, iv, 0, 16);
+            }
+        }
+
+        /// <summary>
+        /// CBC で buffer を in-place に復号する。length は 16 の倍数、iv は最後の暗号ブロックに更新される。
+        /// threads が 0 の場合はコア数分並列に復号する。
+        /// </summary>
+        public void CbcDecrypt(byte[] iv, byte[] buffer, int offset, int length, int threads)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (iv == null) throw new ArgumentNullException("iv");
+            if (iv.Length != 16) throw new ArgumentOutOfRangeException("iv");
+            Aes256.Check(buffer, offset, length);
+            if (length % 16 != 0) throw new ArgumentOutOfRangeException("length");
+
+            if (length == 0) return;
+
+#if Mono
+
+#else
+            if (_context != IntPtr.Zero)
+            {
+                fixed (byte* p_iv = iv)
+                fixed (byte* p_buffer = buffer)
+                {
+                    _cbcDecrypt(_context, p_iv, p_buffer + offset, length, threads);
+                }
+
+                return;
+            }
+#endif
+
+            using (var aes = Aes256.CreateAes(CipherMode.CBC))
+            using (var transform = aes.CreateDecryptor(_key, iv))
+            {
+                var result = new byte[length];
+                transform.TransformBlock(buffer, offset, length, result, 0);
+
+                Array.Copy(buffer, offset + length - 16, iv, 0, 16);
+                Array.Copy(result, 0, buffer, offset, length);
+            }
+        }
+
+        /// <summary>
+        /// CTR で buffer を in-place に暗号化/復号する。counter は 128bit のビッグエンディアンで、使用したブロック数だけ進む。
+        /// 16 の倍数でない length を渡せるのはストリームの最後の呼び出しのみ。
+        /// </summary>
+        public void Ctr(byte[] counter, byte[] buffer, int offset, int length, int threads)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (counter == null) throw new ArgumentNullException("counter");
+            if (counter.Length != 16) throw new ArgumentOutOfRangeException("counter");
+            Aes256.Check(buffer, offset, length);
+
+            if (length == 0) return;
+
+#if Mono
+
+#else
+            if (_context != IntPtr.Zero)
+            {
+                fixed (byte* p_counter = counter)
+                fixed (byte* p_buffer = buffer)
+                {
+                    _ctr(_context, p_counter, p_buffer + offset, length, threads);
+                }
+
+                return;
+            }
+#endif
+
+            using (var aes = Aes256.CreateAes(CipherMode.ECB))
+            using (var transform = aes.CreateEncryptor(_key, null))
+            {
+                var keyStream = new byte[16];
+
+                for (int i = 0; i < length; i += 16)
+                {
+                    transform.TransformBlock(counter, 0, 16, keyStream, 0);
+
+                    for (int j = 0, count = Math.Min(16, length - i); j < count; j++)
+                    {
+                        buffer[offset + i + j] ^= keyStream[j];
+                    }
+
+                    for (int j = 15; j >= 0 && ++counter[j] == 0; j--) ;
+                }
+            }
+        }
+
+        /// <summary>
+        /// buffer[offset, offset + headerLength) を認証のみのヘッダ、その後の length バイトを平文として、
+        /// PKCS7 パディング付きの CBC で in-place に暗号化し、ヘッダと暗号文の HMAC-SHA256 を暗号文の後ろに書き込む。
+        /// buffer には headerLength + length + 16 + 32 バイトの領域が必要。暗号文の長さを返す。
+        /// </summary>
+        public int CbcEncryptHmacSha256(byte[] iv, byte[] hmacKey, byte[] buffer, int offset, int headerLength, int length)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (iv == null) throw new ArgumentNullException("iv");
+            if (iv.Length != 16) throw new ArgumentOutOfRangeException("iv");
+            if (hmacKey == null) throw new ArgumentNullException("hmacKey");
+            if (headerLength < 0) throw new ArgumentOutOfRangeException("headerLength");
+            if (length < 0) throw new ArgumentOutOfRangeException("length");
+            Aes256.Check(buffer, offset, headerLength + length + 16 + 32);
+
+#if Mono
+
+#else
+            if (_context != IntPtr.Zero)
+            {
+                fixed (byte* p_iv = iv)
+                fixed (byte* p_hmacKey = hmacKey)
+                fixed (byte* p_buffer = buffer)
+                {
+                    return _cbcHmacSha256Encrypt(_context, p_iv, p_hmacKey, hmacKey.Length, p_buffer + offset, headerLength, length);
+                }
+            }
+#endif
+
+            int padding = 16 - (length % 16);
+
+            for (int i = 0; i < padding; i++)
+            {
+                buffer[offset + headerLength + length + i] = (byte)padding;
+            }
+
+            length += padding;
+
+            this.CbcEncrypt(iv.Clone() as byte[], buffer, offset + headerLength, length);
+
+            byte[] hmac;
+
+            using (var stream = new MemoryStream(buffer, offset, headerLength + length))
+            {
+                hmac = HmacSha256.ComputeHash(stream, hmacKey);
+            }
+
+            Array.Copy(hmac, 0, buffer, offset + headerLength + length, hmac.Length);
+
+            return length;
+        }
+
+        /// <summary>
+        /// CbcEncryptHmacSha256 で作ったレコードの HMAC を検証してから平文を返す。length は暗号文の長さで、HMAC はその後ろにある。
+        /// 平文の長さを返し、HMAC かパディングが不正な場合は -1 を返す (その場合 buffer の内容は不定)。
+        /// </summary>
+        public int CbcDecryptHmacSha256(byte[] iv, byte[] hmacKey, byte[] buffer, int offset, int headerLength, int length)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (iv == null) throw new ArgumentNullException("iv");
+            if (iv.Length != 16) throw new ArgumentOutOfRangeException("iv");
+            if (hmacKey == null) throw new ArgumentNullException("hmacKey");
+            if (headerLength < 0) throw new ArgumentOutOfRangeException("headerLength");
+            if (length < 0) throw new ArgumentOutOfRangeException("length");
+            Aes256.Check(buffer, offset, headerLength + length + 32);
+
+#if Mono
+
+#else
+            if (_context != IntPtr.Zero)
+            {
+                fixed (byte* p_iv = iv)
+                fixed (byte* p_hmacKey = hmacKey)
+                fixed (byte* p_buffer = buffer)
+                {
+                    return _cbcHmacSha256Decrypt(_context, p_iv, p_hmacKey, hmacKey.Length, p_buffer + offset, headerLength, length);
+                }
+            }
+#endif
+
+            if (length == 0 || length % 16 != 0) return -1;
+
+            byte[] hmac;
+
+            using (var stream = new MemoryStream(buffer, offset, headerLength + length))
+            {
+                hmac = HmacSha256.ComputeHash(stream, hmacKey);
+            }
+
+            int difference = 0;
+
+            for (int i = 0; i < hmac.Length; i++)
+            {
+                difference |= hmac[i] ^ buffer[offset + headerLength + length + i];
+            }
+
+            if (difference != 0) return -1;
+
+            this.CbcDecrypt(iv.Clone() as byte[], buffer, offset + headerLength, length, 1);
+
+            int padding = buffer[offset + headerLength + length - 1];
+            if (padding < 1 || padding > 16) return -1;
+
+            for (int i = length - padding; i < length; i++)
+            {
+                if (buffer[offset + headerLength + i] != padding) return -1;
+            }
+
+            return length - padding;
+        }
+
+        private static Aes CreateAes(CipherMode mode)
+        {
+            var aes = Aes.Create();
+            aes.KeySize = 256;
+            aes.Mode = mode;
+            aes.Padding = PaddingMode.None;
+
+            return aes;
+        }
+
+        protected override void Dispose(bool disposing)
+        {
+            if (_disposed) return;
+            _disposed = true;
+
+#if Mono
+
+#else
+            if (_context != IntPtr.Zero)
+            {
+                _free(_context);
+                _context = IntPtr.Zero;
+            }
+#endif
+
+            if (disposing)
+            {
+                Array.Clear(_key, 0, _key.Length);
+            }
+        }
+    }
+}
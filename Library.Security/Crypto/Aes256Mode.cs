@@ -0,0 +1,8 @@
+namespace Library.Security
+{
+    public enum Aes256Mode
+    {
+        Cbc = 0,
+        Ctr = 1,
+    }
+}
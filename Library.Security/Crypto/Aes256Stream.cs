@@ -0,0 +1,335 @@
+using System;
+using System.IO;
+using System.Security.Cryptography;
+
+namespace Library.Security
+{
+    // CryptoStream の置き換え。1MB 単位でまとめて Aes256 に渡し、バッファ上で in-place に暗号化/復号する。
+    // Cbc は PKCS7 パディングで CryptoStream (Aes, CBC, PKCS7) と同じ暗号文になる。
+    public class Aes256Stream : Stream
+    {
+        // Xz と並んで動き、複数のファイルも同時に処理されるため、1 MB ごとにスレッドを立てず 1 スレッドで処理する。
+        private const int _bufferSize = 1024 * 1024;
+
+        private Stream _stream;
+        private Aes256 _aes;
+        private byte[] _iv;
+        private Aes256Mode _mode;
+        private CryptoStreamMode _streamMode;
+        private BufferManager _bufferManager;
+
+        private byte[] _buffer;
+        private int _bufferPosition;
+        private int _bufferLength;
+        private int _carryLength;
+        private bool _finished;
+
+        private long _position;
+
+        private bool _disposed;
+
+        public Aes256Stream(Stream stream, byte[] key, byte[] iv, Aes256Mode mode, CryptoStreamMode streamMode, BufferManager bufferManager)
+        {
+            if (stream == null) throw new ArgumentNullException("stream");
+            if (key == null) throw new ArgumentNullException("key");
+            if (iv == null) throw new ArgumentNullException("iv");
+            if (iv.Length != 16) throw new ArgumentOutOfRangeException("iv");
+            if (!Enum.IsDefined(typeof(Aes256Mode), mode)) throw new ArgumentException("Aes256Mode に存在しない列挙");
+            if (bufferManager == null) throw new ArgumentNullException("bufferManager");
+
+            _stream = stream;
+            _aes = new Aes256(key);
+            _iv = iv.Clone() as byte[];
+            _mode = mode;
+            _streamMode = streamMode;
+            _bufferManager = bufferManager;
+
+            // Cbc のパディング分の余裕を持たせる。
+            _buffer = _bufferManager.TakeBuffer(_bufferSize + 16);
+        }
+
+        public override bool CanRead
+        {
+            get
+            {
+                if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+                return _streamMode == CryptoStreamMode.Read;
+            }
+        }
+
+        public override bool CanWrite
+        {
+            get
+            {
+                if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+                return _streamMode == CryptoStreamMode.Write;
+            }
+        }
+
+        public override bool CanSeek
+        {
+            get
+            {
+                if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+                return false;
+            }
+        }
+
+        public override long Position
+        {
+            get
+            {
+                if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+                return _position;
+            }
+            set
+            {
+                throw new NotSupportedException();
+            }
+        }
+
+        public override long Length
+        {
+            get
+            {
+                throw new NotSupportedException();
+            }
+        }
+
+        public override long Seek(long offset, SeekOrigin origin)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override void SetLength(long value)
+        {
+            throw new NotSupportedException();
+        }
+
+        public override int Read(byte[] buffer, int offset, int count)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (_streamMode != CryptoStreamMode.Read) throw new NotSupportedException();
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (count < 0 || (buffer.Length - offset) < count) throw new ArgumentOutOfRangeException("count");
+            if (count == 0) return 0;
+
+            int readSumLength = 0;
+
+            while (count > 0)
+            {
+                if (_bufferPosition == _bufferLength)
+                {
+                    if (_finished) break;
+
+                    this.Fill();
+                    continue;
+                }
+
+                int length = Math.Min(_bufferLength - _bufferPosition, count);
+                Unsafe.Copy(_buffer, _bufferPosition, buffer, offset, length);
+                _bufferPosition += length;
+                offset += length;
+                count -= length;
+                readSumLength += length;
+            }
+
+            _position += readSumLength;
+            return readSumLength;
+        }
+
+        // 暗号文を読み込んで復号する。
+        // Cbc ではパディングを取り除くため、終端に達するまで最後のブロックを次回に持ち越す。
+        private void Fill()
+        {
+            // 前回持ち越した暗号文をバッファの先頭に移す。
+            if (_carryLength > 0)
+            {
+                Unsafe.Copy(_buffer, _bufferLength, _buffer, 0, _carryLength);
+            }
+
+            int total = _carryLength;
+            int readLength = 0;
+
+            while (total < _bufferSize && (readLength = _stream.Read(_buffer, total, _bufferSize - total)) > 0)
+            {
+                total += readLength;
+            }
+
+            _bufferPosition = 0;
+
+            if (total < _bufferSize)
+            {
+                _finished = true;
+                _carryLength = 0;
+
+                if (_mode == Aes256Mode.Cbc)
+                {
+                    if (total == 0 || total % 16 != 0) throw new CryptographicException("Length of the data to decrypt is invalid.");
+
+                    _aes.CbcDecrypt(_iv, _buffer, 0, total, 1);
+
+                    int padding = _buffer[total - 1];
+                    if (padding < 1 || padding > 16) throw new CryptographicException("Padding is invalid.");
+
+                    for (int i = total - padding; i < total; i++)
+                    {
+                        if (_buffer[i] != padding) throw new CryptographicException("Padding is invalid.");
+                    }
+
+                    _bufferLength = total - padding;
+                }
+                else
+                {
+                    _aes.Ctr(_iv, _buffer, 0, total, 1);
+
+                    _bufferLength = total;
+                }
+            }
+            else
+            {
+                int length = (_mode == Aes256Mode.Cbc) ? total - 16 : total;
+
+                if (_mode == Aes256Mode.Cbc) _aes.CbcDecrypt(_iv, _buffer, 0, length, 1);
+                else _aes.Ctr(_iv, _buffer, 0, length, 1);
+
+                _bufferLength = length;
+                _carryLength = total - length;
+            }
+        }
+
+        public override void Write(byte[] buffer, int offset, int count)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (_streamMode != CryptoStreamMode.Write) throw new NotSupportedException();
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (count < 0 || (buffer.Length - offset) < count) throw new ArgumentOutOfRangeException("count");
+            if (count == 0) return;
+
+            _position += count;
+
+            while (count > 0)
+            {
+                int length = Math.Min(_bufferSize - _bufferLength, count);
+                Unsafe.Copy(buffer, offset, _buffer, _bufferLength, length);
+                _bufferLength += length;
+                offset += length;
+                count -= length;
+
+                if (_bufferLength == _bufferSize)
+                {
+                    if (_mode == Aes256Mode.Cbc) _aes.CbcEncrypt(_iv, _buffer, 0, _bufferLength);
+                    else _aes.Ctr(_iv, _buffer, 0, _bufferLength, 1);
+
+                    _stream.Write(_buffer, 0, _bufferLength);
+                    _bufferLength = 0;
+                }
+            }
+        }
+
+        // 残りのデータを暗号化して書き出す。Cbc では PKCS7 パディングを付ける。
+        private void FlushFinalBlock()
+        {
+            if (_finished) return;
+            _finished = true;
+
+            if (_mode == Aes256Mode.Cbc)
+            {
+                int padding = 16 - (_bufferLength % 16);
+
+                for (int i = 0; i < padding; i++)
+                {
+                    _buffer[_bufferLength++] = (byte)padding;
+                }
+
+                _aes.CbcEncrypt(_iv, _buffer, 0, _bufferLength);
+            }
+            else
+            {
+                _aes.Ctr(_iv, _buffer, 0, _bufferLength, 1);
+            }
+
+            _stream.Write(_buffer, 0, _bufferLength);
+            _bufferLength = 0;
+
+            _stream.Flush();
+        }
+
+        public override void Flush()
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+            if (_streamMode == CryptoStreamMode.Write)
+            {
+                _stream.Flush();
+            }
+        }
+
+        protected override void Dispose(bool disposing)
+        {
+            try
+            {
+                if (_disposed) return;
+
+                if (disposing)
+                {
+                    try
+                    {
+                        if (_streamMode == CryptoStreamMode.Write)
+                        {
+                            this.FlushFinalBlock();
+                        }
+                    }
+                    finally
+                    {
+                        _disposed = true;
+
+                        if (_stream != null)
+                        {
+                            try
+                            {
+                                _stream.Dispose();
+                            }
+                            catch (Exception)
+                            {
+
+                            }
+
+                            _stream = null;
+                        }
+
+                        if (_aes != null)
+                        {
+                            _aes.Dispose();
+                            _aes = null;
+                        }
+
+                        if (_buffer != null)
+                        {
+                            try
+                            {
+                                _bufferManager.ReturnBuffer(_buffer);
+                            }
+                            catch (Exception)
+                            {
+
+                            }
+
+                            _buffer = null;
+                        }
+                    }
+                }
+
+                _disposed = true;
+            }
+            finally
+            {
+                base.Dispose(disposing);
+            }
+        }
+    }
+}
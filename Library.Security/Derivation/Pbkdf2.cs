@@ -3,6 +3,8 @@
 //2012-04-12: Initial version.
 
 using System;
+using System.Runtime.InteropServices;
+using System.Security;
 using System.Security.Cryptography;
 using System.Text;
 
@@ -29,6 +31,45 @@ namespace Library.Security
         private int _bufferStartIndex = 0;
         private int _bufferEndIndex = 0;
 
+        //HMAC-SHA256 runs natively, with the password kept for the native call.
+        private byte[] _password;
+
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void HmacSha256Delegate(byte* password, int passwordLength, byte* salt, int saltLength, int iterations, uint index, int blocks, byte* result);
+
+        private static HmacSha256Delegate _hmacSha256;
+#endif
+
+        static Pbkdf2()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x86.dll");
+                }
+
+                _hmacSha256 = _nativeLibraryManager.GetMethod<HmacSha256Delegate>("pbkdf2_hmac_sha256");
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
         /// <summary>
         /// Creates new instance.
         /// </summary>
@@ -49,6 +90,15 @@ namespace Library.Security
             this.IterationCount = iterations;
 
             _blockSize = this.Algorithm.HashSize / 8;
+
+#if Mono
+
+#else
+            if (_hmacSha256 != null && algorithm is HMACSHA256)
+            {
+                _password = password.Clone() as byte[];
+            }
+#endif
         }
 
         /// <summary>
@@ -93,25 +143,48 @@ namespace Library.Security
                 resultOffset += bufferCount;
             }
 
-            while (resultOffset < count)
-            {
+            if (resultOffset < count)
+            { //all remaining blocks at once, so the native path can run them side by side
                 int needCount = count - resultOffset;
-                _bufferBytes = this.Function();
+                _bufferBytes = this.Function((needCount + _blockSize - 1) / _blockSize);
 
-                if (needCount > _blockSize)
-                { //we one (or more) additional passes
-                    Unsafe.Copy(_bufferBytes, 0, result, resultOffset, _blockSize);
-                    resultOffset += _blockSize;
-                }
-                else
-                {
-                    Unsafe.Copy(_bufferBytes, 0, result, resultOffset, needCount);
-                    _bufferStartIndex = needCount;
-                    _bufferEndIndex = _blockSize;
+                Unsafe.Copy(_bufferBytes, 0, result, resultOffset, needCount);
+                _bufferStartIndex = needCount;
+                _bufferEndIndex = _bufferBytes.Length;
+            }
 
-                    return result;
+            return result;
+        }
+
+        private byte[] Function(int blocks)
+        {
+            if ((ulong)_blockIndex + (ulong)blocks > uint.MaxValue) { throw new InvalidOperationException("Derived key too long."); }
+
+            byte[] result = new byte[blocks * _blockSize];
+
+#if Mono
+
+#else
+            if (_password != null)
+            {
+                fixed (byte* p_password = _password)
+                fixed (byte* p_salt = this.Salt)
+                fixed (byte* p_result = result)
+                {
+                    _hmacSha256(p_password, _password.Length, p_salt, this.Salt.Length, this.IterationCount, _blockIndex, blocks, p_result);
                 }
+
+                _blockIndex += (uint)blocks;
+
+                return result;
             }
+#endif
+
+            for (int i = 0; i < blocks; i++)
+            {
+                Unsafe.Copy(this.Function(), 0, result, i * _blockSize, _blockSize);
+            }
+
             return result;
         }
 
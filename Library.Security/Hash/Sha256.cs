@@ -1,17 +1,63 @@
 using System;
 using System.Collections.Generic;
 using System.IO;
+using System.Runtime.InteropServices;
+using System.Security;
 using System.Security.Cryptography;
 using System.Text;
 using System.Threading;
 
 namespace Library.Security
 {
-    public static class Sha256
+    public unsafe static class Sha256
     {
         private static readonly ThreadLocal<SHA256> _threadLocalSha256 = new ThreadLocal<SHA256>(() => SHA256.Create());
         private static readonly ThreadLocal<Encoding> _threadLocalEncoding = new ThreadLocal<Encoding>(() => new UTF8Encoding(false));
 
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void ManyDelegate(byte** sources, int* lengths, int count, byte* digests, int threads);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int VerifyManyDelegate(byte** sources, int* lengths, int count, byte* hashes, byte* results, int threads);
+
+        private static ManyDelegate _many;
+        private static VerifyManyDelegate _verifyMany;
+#endif
+
+        static Sha256()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x86.dll");
+                }
+
+                // 古い DLL で片方だけ読み込まれることがないよう、両方揃ってから設定する。
+                var many = _nativeLibraryManager.GetMethod<ManyDelegate>("sha256_many");
+                var verifyMany = _nativeLibraryManager.GetMethod<VerifyManyDelegate>("sha256_verify_many");
+
+                _many = many;
+                _verifyMany = verifyMany;
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
         public static byte[] ComputeHash(byte[] buffer, int offset, int length)
         {
             if (buffer == null) throw new ArgumentNullException("buffer");
@@ -67,5 +113,150 @@ namespace Library.Security
                 return Sha256.Hash;
             }
         }
+
+        /// <summary>
+        /// 各要素のハッシュをまとめて計算する
+        /// </summary>
+        public static byte[][] ComputeHashes(IList<ArraySegment<byte>> values)
+        {
+            if (values == null) throw new ArgumentNullException("values");
+
+            var hashes = new byte[values.Count][];
+
+#if Mono
+            for (int i = 0; i < values.Count; i++)
+            {
+                hashes[i] = Sha256.ComputeHash(values[i]);
+            }
+#else
+            if (values.Count == 0) return hashes;
+
+            // DLL が読み込めなかった場合は、1 つずつマネージドで計算する。
+            if (_many == null)
+            {
+                for (int i = 0; i < values.Count; i++)
+                {
+                    hashes[i] = Sha256.ComputeHash(values[i]);
+                }
+
+                return hashes;
+            }
+
+            byte[] digests = new byte[values.Count * 32];
+
+            Sha256.Pin(values, (sources, lengths) =>
+            {
+                fixed (byte* p_digests = digests)
+                {
+                    _many(sources, lengths, values.Count, p_digests, 0);
+                }
+            });
+
+            for (int i = 0; i < values.Count; i++)
+            {
+                hashes[i] = new byte[32];
+                Unsafe.Copy(digests, i * 32, hashes[i], 0, 32);
+            }
+#endif
+
+            return hashes;
+        }
+
+        /// <summary>
+        /// 各要素のハッシュを計算し、期待するハッシュと一致するかを返す
+        /// </summary>
+        public static bool[] VerifyHashes(IList<ArraySegment<byte>> values, IList<byte[]> hashes)
+        {
+            if (values == null) throw new ArgumentNullException("values");
+            if (hashes == null) throw new ArgumentNullException("hashes");
+            if (values.Count != hashes.Count) throw new ArgumentException("values and hashes must have the same count.");
+
+            var flags = new bool[values.Count];
+
+#if Mono
+            for (int i = 0; i < values.Count; i++)
+            {
+                flags[i] = (hashes[i] != null && Unsafe.Equals(Sha256.ComputeHash(values[i]), hashes[i]));
+            }
+#else
+            if (values.Count == 0) return flags;
+
+            if (_verifyMany == null)
+            {
+                for (int i = 0; i < values.Count; i++)
+                {
+                    flags[i] = (hashes[i] != null && Unsafe.Equals(Sha256.ComputeHash(values[i]), hashes[i]));
+                }
+
+                return flags;
+            }
+
+            byte[] expected = new byte[values.Count * 32];
+
+            for (int i = 0; i < hashes.Count; i++)
+            {
+                if (hashes[i] == null || hashes[i].Length != 32) continue;
+
+                Unsafe.Copy(hashes[i], 0, expected, i * 32, 32);
+            }
+
+            byte[] results = new byte[(values.Count + 7) / 8];
+
+            Sha256.Pin(values, (sources, lengths) =>
+            {
+                fixed (byte* p_expected = expected, p_results = results)
+                {
+                    _verifyMany(sources, lengths, values.Count, p_expected, p_results, 0);
+                }
+            });
+
+            for (int i = 0; i < values.Count; i++)
+            {
+                if (hashes[i] == null || hashes[i].Length != 32) continue;
+
+                flags[i] = ((results[i / 8] >> (i % 8)) & 1) != 0;
+            }
+#endif
+
+            return flags;
+        }
+
+#if Mono
+
+#else
+        private delegate void PinnedCallback(byte** sources, int* lengths);
+
+        private static void Pin(IList<ArraySegment<byte>> values, PinnedCallback callback)
+        {
+            var handles = new GCHandle[values.Count];
+            var sources = new IntPtr[values.Count];
+            var lengths = new int[values.Count];
+
+            try
+            {
+                for (int i = 0; i < values.Count; i++)
+                {
+                    if (values[i].Array == null) throw new ArgumentNullException("values");
+
+                    handles[i] = GCHandle.Alloc(values[i].Array, GCHandleType.Pinned);
+                    sources[i] = new IntPtr((byte*)handles[i].AddrOfPinnedObject() + values[i].Offset);
+                    lengths[i] = values[i].Count;
+                }
+
+                fixed (IntPtr* p_sources = sources)
+                fixed (int* p_lengths = lengths)
+                {
+                    callback((byte**)p_sources, p_lengths);
+                }
+            }
+            finally
+            {
+                for (int i = 0; i < handles.Length; i++)
+                {
+                    if (handles[i].IsAllocated) handles[i].Free();
+                }
+            }
+        }
+#endif
     }
 }
@@ -0,0 +1,150 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Library.Security
+{
+    // SipHash-1-3。鍵付きのハッシュで、鍵を知らない相手には衝突する入力を作れない。
+    // 鍵はコンストラクタで一度だけ展開し、以降の計算はその状態から始める。
+    public unsafe sealed class SipHash
+    {
+        private readonly ulong[] _state = new ulong[4];
+
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate ulong ComputeDelegate(ulong* state, byte* source, int length);
+
+        private static ComputeDelegate _compute;
+#endif
+
+        static SipHash()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_Security_x86.dll");
+                }
+
+                _compute = _nativeLibraryManager.GetMethod<ComputeDelegate>("siphash13");
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// 16 バイトの鍵で初期化します
+        /// </summary>
+        public SipHash(byte[] key)
+        {
+            if (key == null) throw new ArgumentNullException("key");
+            if (key.Length != 16) throw new ArgumentOutOfRangeException("key");
+
+            ulong k0 = BitConverter.ToUInt64(key, 0);
+            ulong k1 = BitConverter.ToUInt64(key, 8);
+
+            _state[0] = k0 ^ 0x736f6d6570736575UL;
+            _state[1] = k1 ^ 0x646f72616e646f6dUL;
+            _state[2] = k0 ^ 0x6c7967656e657261UL;
+            _state[3] = k1 ^ 0x7465646279746573UL;
+        }
+
+        public long ComputeHash(byte[] buffer, int offset, int length)
+        {
+            if (buffer == null) throw new ArgumentNullException("buffer");
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (length < 0 || (buffer.Length - offset) < length) throw new ArgumentOutOfRangeException("length");
+
+            fixed (ulong* p_state = _state)
+            fixed (byte* p_buffer = buffer)
+            {
+#if Mono
+
+#else
+                if (_compute != null) return (long)_compute(p_state, p_buffer + offset, length);
+#endif
+
+                return (long)SipHash.Compute(p_state, p_buffer + offset, length);
+            }
+        }
+
+        public long ComputeHash(byte[] buffer)
+        {
+            if (buffer == null) throw new ArgumentNullException("buffer");
+
+            return this.ComputeHash(buffer, 0, buffer.Length);
+        }
+
+        private static ulong RotateLeft(ulong x, int n)
+        {
+            return (x << n) | (x >> (64 - n));
+        }
+
+        private static ulong Compute(ulong* state, byte* source, int length)
+        {
+            ulong v0 = state[0];
+            ulong v1 = state[1];
+            ulong v2 = state[2];
+            ulong v3 = state[3];
+
+            int blocks = length / 8;
+
+            // 最後のブロックは残りのバイトと、最上位バイトに長さを持つ。
+            ulong b = (ulong)length << 56;
+
+            for (int i = 0; i <= blocks; i++)
+            {
+                ulong m;
+
+                if (i < blocks)
+                {
+                    m = *(ulong*)(source + (i * 8));
+                }
+                else
+                {
+                    m = b;
+
+                    for (int j = 0; j < (length & 7); j++)
+                    {
+                        m |= (ulong)source[(blocks * 8) + j] << (j * 8);
+                    }
+                }
+
+                v3 ^= m;
+
+                v0 += v1; v1 = RotateLeft(v1, 13); v1 ^= v0; v0 = RotateLeft(v0, 32);
+                v2 += v3; v3 = RotateLeft(v3, 16); v3 ^= v2;
+                v0 += v3; v3 = RotateLeft(v3, 21); v3 ^= v0;
+                v2 += v1; v1 = RotateLeft(v1, 17); v1 ^= v2; v2 = RotateLeft(v2, 32);
+
+                v0 ^= m;
+            }
+
+            v2 ^= 0xff;
+
+            for (int i = 0; i < 3; i++)
+            {
+                v0 += v1; v1 = RotateLeft(v1, 13); v1 ^= v0; v0 = RotateLeft(v0, 32);
+                v2 += v3; v3 = RotateLeft(v3, 16); v3 ^= v2;
+                v0 += v3; v3 = RotateLeft(v3, 21); v3 ^= v0;
+                v2 += v1; v1 = RotateLeft(v1, 17); v1 ^= v2; v2 = RotateLeft(v2, 32);
+            }
+
+            return v0 ^ v1 ^ v2 ^ v3;
+        }
+    }
+}
@@ -3,6 +3,8 @@ using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
 using System.Linq;
+using System.Runtime.InteropServices;
+using System.Security;
 using System.Text;
 using System.Threading;
 using System.Threading.Tasks;
@@ -16,14 +18,22 @@ namespace Library.Security
         private readonly CashAlgorithm _cashAlgorithm;
         private readonly int _limit;
         private readonly TimeSpan _computationTime;
+        private readonly int _threadCount;
 
         private volatile bool _isCanceled;
 
         public Miner(CashAlgorithm cashAlgorithm, int limit, TimeSpan computationTime)
+            : this(cashAlgorithm, limit, computationTime, 1)
+        {
+
+        }
+
+        public Miner(CashAlgorithm cashAlgorithm, int limit, TimeSpan computationTime, int threadCount)
         {
             _cashAlgorithm = cashAlgorithm;
             _limit = limit;
             _computationTime = computationTime;
+            _threadCount = threadCount;
         }
 
         public CashAlgorithm CashAlgorithm
@@ -50,6 +60,14 @@ namespace Library.Security
             }
         }
 
+        public int ThreadCount
+        {
+            get
+            {
+                return _threadCount;
+            }
+        }
+
         public void Cancel()
         {
             _isCanceled = true;
@@ -71,7 +89,7 @@ namespace Library.Security
                 {
                     var task = Task.Factory.StartNew(() =>
                     {
-                        var key = minerUtilities.Create_1(Sha256.ComputeHash(stream), this.Limit, this.ComputationTime);
+                        var key = minerUtilities.Create_1(Sha256.ComputeHash(stream), this.Limit, this.ComputationTime, this.ThreadCount);
                         return new Cash(CashAlgorithm.Version1, key);
                     });
 
@@ -82,6 +100,9 @@ namespace Library.Security
                         Thread.Sleep(1000);
                     }
 
+                    // キャンセルされた場合は、時間切れで見つかった鍵も返さない。
+                    if (_isCanceled) throw new MinerException();
+
                     return task.Result;
                 }
                 catch (AggregateException e)
@@ -109,6 +130,43 @@ namespace Library.Security
             return 0;
         }
 
+        public static int[] Verify(IList<Cash> cashes, IList<Stream> streams)
+        {
+            if (cashes == null) throw new ArgumentNullException("cashes");
+            if (streams == null) throw new ArgumentNullException("streams");
+            if (cashes.Count != streams.Count) throw new ArgumentException("cashes");
+
+            var results = new int[cashes.Count];
+
+            var indexes = new List<int>();
+            var keys = new List<byte[]>();
+            var values = new List<byte[]>();
+
+            for (int i = 0; i < cashes.Count; i++)
+            {
+                if (streams[i] == null) throw new ArgumentNullException("streams");
+
+                var cash = cashes[i];
+                if (cash == null || cash.CashAlgorithm != CashAlgorithm.Version1) continue;
+
+                indexes.Add(i);
+                keys.Add(cash.Key);
+                values.Add(Sha256.ComputeHash(streams[i]));
+            }
+
+            if (indexes.Count == 0) return results;
+
+            var minerUtilities = new MinerUtilities();
+            var counts = minerUtilities.Verify_1(keys, values);
+
+            for (int i = 0; i < indexes.Count; i++)
+            {
+                results[indexes[i]] = counts[i];
+            }
+
+            return results;
+        }
+
         public static int Sample(TimeSpan computationTime)
         {
             var miner = new Miner(CashAlgorithm.Version1, -1, computationTime);
@@ -128,84 +186,98 @@ namespace Library.Security
             }
         }
 
-        private class MinerUtilities
+        private unsafe class MinerUtilities
         {
-            private static string _path;
+#if Mono
+
+#else
+            private static NativeLibraryManager _nativeLibraryManager;
+
+            [SuppressUnmanagedCodeSecurity]
+            private delegate IntPtr CreateDelegate(byte* value, int limit, int timeout, int threads, int* cancel, IntPtr progress);
+            [SuppressUnmanagedCodeSecurity]
+            private delegate int VerifyDelegate(byte* key, byte* value);
+            [SuppressUnmanagedCodeSecurity]
+            private delegate void VerifyBatchDelegate(byte* keys, byte* values, int count, int* counts, int threads);
+            [SuppressUnmanagedCodeSecurity]
+            private delegate void FreeDelegate(IntPtr key);
+
+            private static CreateDelegate _create;
+            private static VerifyDelegate _verify;
+            private static VerifyBatchDelegate _verifyBatch;
+            private static FreeDelegate _free;
+#endif
 
             static MinerUtilities()
             {
-                OperatingSystem osInfo = Environment.OSVersion;
+#if Mono
 
-                if (osInfo.Platform == PlatformID.Win32NT)
+#else
+                try
                 {
                     if (System.Environment.Is64BitProcess)
                     {
-                        _path = "Assemblies/Hashcash_x64.exe";
+                        _nativeLibraryManager = new NativeLibraryManager("Assemblies/Hashcash_x64.dll");
                     }
                     else
                     {
-                        _path = "Assemblies/Hashcash_x86.exe";
+                        _nativeLibraryManager = new NativeLibraryManager("Assemblies/Hashcash_x86.dll");
                     }
+
+                    _create = _nativeLibraryManager.GetMethod<CreateDelegate>("hashcash1_create");
+                    _verify = _nativeLibraryManager.GetMethod<VerifyDelegate>("hashcash1_verify");
+                    _verifyBatch = _nativeLibraryManager.GetMethod<VerifyBatchDelegate>("hashcash1_verify_batch");
+                    _free = _nativeLibraryManager.GetMethod<FreeDelegate>("hashcash1_free");
+                }
+                catch (Exception e)
+                {
+                    Log.Warning(e);
                 }
+#endif
             }
 
-            private LockedList<Process> _processes = new LockedList<Process>();
+            private int[] _cancel = new int[1];
 
-            public byte[] Create_1(byte[] value, int limit, TimeSpan computationTime)
+            public byte[] Create_1(byte[] value, int limit, TimeSpan computationTime, int threadCount)
             {
                 if (value == null) throw new ArgumentNullException("value");
                 if (value.Length != 32) throw new ArgumentOutOfRangeException("value");
 
-                var info = new ProcessStartInfo(_path);
-                info.CreateNoWindow = true;
-                info.UseShellExecute = false;
-                info.RedirectStandardOutput = true;
-
-                {
-                    if (limit < 0) limit = -1;
+                if (limit < 0) limit = -1;
 
-                    int timeout;
+                int timeout;
 
-                    if (computationTime < TimeSpan.Zero) timeout = -1;
-                    else timeout = (int)computationTime.TotalSeconds;
+                if (computationTime < TimeSpan.Zero) timeout = -1;
+                else timeout = (int)Math.Min(computationTime.TotalMilliseconds, int.MaxValue);
 
-                    info.Arguments = string.Format(
-                        "hashcash1 create {0} {1} {2}",
-                        NetworkConverter.ToHexString(value),
-                        limit,
-                        timeout);
-                }
-
-                using (var process = Process.Start(info))
+                try
                 {
-                    _processes.Add(process);
-
-                    try
+                    fixed (byte* p_value = value)
+                    fixed (int* p_cancel = _cancel)
                     {
-                        process.PriorityClass = ProcessPriorityClass.Idle;
+                        var p_key = _create(p_value, limit, timeout, threadCount, p_cancel, IntPtr.Zero);
+                        if (p_key == IntPtr.Zero) throw new MinerException();
 
                         try
                         {
-                            var result = process.StandardOutput.ReadLine();
-
-                            process.WaitForExit();
-                            if (process.ExitCode != 0) throw new MinerException();
+                            var key = new byte[32];
+                            Marshal.Copy(p_key, key, 0, key.Length);
 
-                            return NetworkConverter.FromHexString(result);
+                            return key;
                         }
-                        catch (MinerException)
+                        finally
                         {
-                            throw;
-                        }
-                        catch (Exception e)
-                        {
-                            throw new MinerException(e.Message, e);
+                            _free(p_key);
                         }
                     }
-                    finally
-                    {
-                        _processes.Remove(process);
-                    }
+                }
+                catch (MinerException)
+                {
+                    throw;
+                }
+                catch (Exception e)
+                {
+                    throw new MinerException(e.Message, e);
                 }
             }
 
@@ -216,11 +288,33 @@ namespace Library.Security
                 if (value == null) throw new ArgumentNullException("value");
                 if (value.Length != 32) throw new ArgumentOutOfRangeException("value");
 
-                var bufferManager = BufferManager.Instance;
+#if Mono
+                return MinerUtilities.Verify_1_Managed(key, value);
+#else
+                // DLL が読み込めなかった場合は、マネージドの実装で検証する。
+                if (_verify == null) return MinerUtilities.Verify_1_Managed(key, value);
 
                 try
                 {
+                    fixed (byte* p_key = key)
+                    fixed (byte* p_value = value)
+                    {
+                        return _verify(p_key, p_value);
+                    }
+                }
+                catch (Exception)
+                {
+                    return 0;
+                }
+#endif
+            }
+
+            private static int Verify_1_Managed(byte[] key, byte[] value)
+            {
+                var bufferManager = BufferManager.Instance;
 
+                try
+                {
                     byte[] result;
 
                     {
@@ -253,19 +347,76 @@ namespace Library.Security
                 }
             }
 
-            public void Cancel()
+            public int[] Verify_1(IList<byte[]> keys, IList<byte[]> values)
             {
-                foreach (var process in _processes.ToArray())
+                if (keys == null) throw new ArgumentNullException("keys");
+                if (values == null) throw new ArgumentNullException("values");
+                if (keys.Count != values.Count) throw new ArgumentException("keys");
+
+                int count = keys.Count;
+                var counts = new int[count];
+
+                if (count == 0) return counts;
+
+#if Mono
+                for (int i = 0; i < count; i++)
                 {
-                    try
+                    counts[i] = this.Verify_1(keys[i], values[i]);
+                }
+
+                return counts;
+#else
+                if (_verifyBatch == null)
+                {
+                    for (int i = 0; i < count; i++)
                     {
-                        process.Kill();
+                        counts[i] = this.Verify_1(keys[i], values[i]);
                     }
-                    catch (Exception)
+
+                    return counts;
+                }
+
+                var bufferManager = BufferManager.Instance;
+
+                byte[] keysBuffer = null;
+                byte[] valuesBuffer = null;
+
+                try
+                {
+                    keysBuffer = bufferManager.TakeBuffer(count * 32);
+                    valuesBuffer = bufferManager.TakeBuffer(count * 32);
+
+                    for (int i = 0; i < count; i++)
                     {
+                        if (keys[i] == null) throw new ArgumentNullException("keys");
+                        if (keys[i].Length != 32) throw new ArgumentOutOfRangeException("keys");
+                        if (values[i] == null) throw new ArgumentNullException("values");
+                        if (values[i].Length != 32) throw new ArgumentOutOfRangeException("values");
 
+                        Unsafe.Copy(keys[i], 0, keysBuffer, i * 32, 32);
+                        Unsafe.Copy(values[i], 0, valuesBuffer, i * 32, 32);
                     }
+
+                    fixed (byte* p_keys = keysBuffer)
+                    fixed (byte* p_values = valuesBuffer)
+                    fixed (int* p_counts = counts)
+                    {
+                        _verifyBatch(p_keys, p_values, count, p_counts, 0);
+                    }
+
+                    return counts;
+                }
+                finally
+                {
+                    if (keysBuffer != null) bufferManager.ReturnBuffer(keysBuffer);
+                    if (valuesBuffer != null) bufferManager.ReturnBuffer(valuesBuffer);
                 }
+#endif
+            }
+
+            public void Cancel()
+            {
+                Thread.VolatileWrite(ref _cancel[0], 1);
             }
         }
     }
@@ -151,6 +151,22 @@ namespace Library.UnitTest
                 Assert.IsTrue(CollectionUtilities.Equals(buffer, NetworkConverter.FromBase64UrlString(s)));
             }
 
+            Assert.IsTrue(CollectionUtilities.Equals(new byte[] { 0x41 }, NetworkConverter.FromBase64UrlString("QQ==")));
+            Assert.IsTrue(CollectionUtilities.Equals(new byte[] { 0x41, 0x42 }, NetworkConverter.FromBase64UrlString("QUI=")));
+
+            foreach (var s in new string[] { "QQ===", "QUI==", "Q===", "====" })
+            {
+                try
+                {
+                    NetworkConverter.FromBase64UrlString(s);
+                    Assert.Fail(s);
+                }
+                catch (FormatException)
+                {
+
+                }
+            }
+
             for (int i = 0; i < 1024; i++)
             {
                 byte[] buffer = new byte[_random.Next(0, 128)];
@@ -195,6 +211,94 @@ namespace Library.UnitTest
             Assert.IsTrue(rt.Count == 0);
         }
 
+        [Test]
+        public void Test_Chunker()
+        {
+            byte[] value = new byte[1024 * 1024 * 4];
+            _random.NextBytes(value);
+
+            Func<Chunker, byte[], int, List<int>> split = (chunker, buffer, step) =>
+            {
+                var list = new List<int>();
+                int[] cuts = new int[chunker.GetCutsLength(step)];
+
+                chunker.Reset();
+
+                for (int position = 0; position < buffer.Length; position += step)
+                {
+                    int count = chunker.Feed(buffer, position, Math.Min(step, buffer.Length - position), cuts);
+
+                    for (int i = 0; i < count; i++)
+                    {
+                        list.Add(cuts[i]);
+                    }
+                }
+
+                return list;
+            };
+
+            using (var chunker = new Chunker(1024 * 16, 1024 * 32, 1024 * 64))
+            {
+                var list1 = split(chunker, value, value.Length);
+                var list2 = split(chunker, value, 1000);
+
+                Assert.IsTrue(list1.Count > 0);
+                Assert.IsTrue(CollectionUtilities.Equals(list1, list2));
+
+                for (int i = 0, previous = 0; i < list1.Count; previous = list1[i], i++)
+                {
+                    Assert.IsTrue(list1[i] - previous >= chunker.MinLength);
+                    Assert.IsTrue(list1[i] - previous <= chunker.MaxLength);
+                }
+
+                byte[] value2 = new byte[value.Length + 1];
+                Array.Copy(value, 0, value2, 0, value.Length / 2);
+                value2[value.Length / 2] = 0xff;
+                Array.Copy(value, value.Length / 2, value2, (value.Length / 2) + 1, value.Length - (value.Length / 2));
+
+                var list3 = split(chunker, value2, 1024 * 100);
+                var after1 = list1.Where(n => n > value.Length / 2 + chunker.MaxLength).Select(n => n + 1).ToList();
+
+                Assert.IsTrue(after1.Count > 0);
+                Assert.IsTrue(after1.Count(n => list3.Contains(n)) >= after1.Count * 9 / 10);
+            }
+        }
+
+        [Test]
+        public void Test_BloomFilter()
+        {
+            int count = 10000;
+
+            byte[] keys = new byte[count * BloomFilter.KeyLength];
+            _random.NextBytes(keys);
+
+            byte[] otherKeys = new byte[count * BloomFilter.KeyLength];
+            _random.NextBytes(otherKeys);
+
+            var filter = new BloomFilter(count, 16);
+            filter.AddRange(keys, 0, count);
+
+            bool[] result = new bool[count];
+
+            Assert.AreEqual(filter.Contains(keys, 0, count, result), count);
+            Assert.IsTrue(result.All(n => n));
+
+            // 16 bits per key should give about 0.1% false positives.
+            Assert.IsTrue(filter.Contains(otherKeys, 0, count, result) < count / 100);
+
+            var filter2 = new BloomFilter(filter.ToArray());
+
+            for (int i = 0; i < 100; i++)
+            {
+                byte[] key = new byte[BloomFilter.KeyLength];
+                Array.Copy(keys, i * BloomFilter.KeyLength, key, 0, key.Length);
+
+                Assert.IsTrue(filter2.Contains(key));
+            }
+
+            Assert.IsTrue(Unsafe.Equals(filter.ToArray(), filter2.ToArray()));
+        }
+
         [Test]
         public void Test_Xor()
         {
@@ -259,6 +363,57 @@ namespace Library.UnitTest
             }
         }
 
+        [Test]
+        public void Test_UnsafeBatch()
+        {
+            foreach (int length in new int[] { 1, 20, 32, 33, 64 })
+            {
+                var batch = new UnsafeBatch(length, 1);
+
+                for (int i = 0; i < 16; i++)
+                {
+                    batch.Clear();
+
+                    var values = new List<byte[]>();
+
+                    for (int j = 0; j < 64; j++)
+                    {
+                        byte[] value = new byte[length];
+
+                        // Small byte values make equal pairs and differences in the last byte likely.
+                        if (j > 0 && _random.Next(0, 2) == 0) Unsafe.Copy(values[_random.Next(0, j)], 0, value, 0, length);
+                        else for (int k = 0; k < length; k++) value[k] = (byte)_random.Next(0, 3);
+
+                        values.Add(value);
+                        Assert.AreEqual(j, batch.AddOperand(value));
+                    }
+
+                    var pairs = new List<Tuple<int, int>>();
+
+                    for (int j = 0; j < 128; j++)
+                    {
+                        pairs.Add(new Tuple<int, int>(_random.Next(0, values.Count), _random.Next(0, values.Count)));
+
+                        if ((j % 2) == 0) batch.AddEquals(pairs[j].Item1, pairs[j].Item2);
+                        else batch.AddCompare(pairs[j].Item1, pairs[j].Item2);
+                    }
+
+                    Assert.AreEqual(pairs.Count, batch.Count);
+
+                    batch.Execute();
+
+                    for (int j = 0; j < pairs.Count; j++)
+                    {
+                        byte[] x = values[pairs[j].Item1];
+                        byte[] y = values[pairs[j].Item2];
+
+                        if ((j % 2) == 0) Assert.AreEqual(Unsafe.Equals(x, y), batch.GetEquals(j));
+                        else Assert.AreEqual(Math.Sign(Unsafe.Compare(x, y)), Math.Sign(batch.GetCompare(j)));
+                    }
+                }
+            }
+        }
+
         [Test]
         public void Test_SimpleLinkedList()
         {
@@ -160,5 +160,238 @@ namespace Library.UnitTest
                 }
             }
         }
+
+        [Test]
+        public void Test_VolatileHashSet()
+        {
+            // 生存時間の 1/64 (10ms) が更新時刻の単位になる。
+            var survivalTime = TimeSpan.FromMilliseconds(640);
+            int halfTime = (int)(survivalTime.TotalMilliseconds / 2);
+            int threeQuarterTime = (int)(survivalTime.TotalMilliseconds * 3 / 4);
+
+            // 追加してから生存時間が経つまでは取り除かれず、その後は取り除かれる。
+            {
+                var set = new VolatileHashSet<int>(survivalTime);
+
+                var addTime = DateTime.UtcNow;
+
+                for (int i = 0; i < 16; i++)
+                {
+                    set.Add(i);
+                }
+
+                for (; ; )
+                {
+                    set.TrimExcess();
+                    int count = set.Count;
+                    var elapsed = DateTime.UtcNow - addTime;
+
+                    if (count < 16) Assert.IsTrue(elapsed >= survivalTime);
+                    if (count == 0) break;
+
+                    Assert.IsTrue(elapsed < survivalTime + survivalTime + survivalTime);
+
+                    Thread.Sleep(5);
+                }
+            }
+
+            // 同じ単位の中での再追加は何も変えず、後の単位での再追加は期限を延ばす。
+            {
+                var set = new VolatileHashSet<int>(survivalTime);
+
+                Assert.IsTrue(set.Add(0));
+                Assert.IsFalse(set.Add(0));
+                Assert.AreEqual(1, set.Count);
+
+                Thread.Sleep(halfTime);
+
+                var refreshTime = DateTime.UtcNow;
+                Assert.IsFalse(set.Add(0));
+
+                // 最初の追加の記録は期限を過ぎたが、再追加からはまだ生存時間が経っていない。
+                Thread.Sleep(threeQuarterTime);
+
+                set.TrimExcess();
+                bool contains = set.Contains(0);
+                if ((DateTime.UtcNow - refreshTime) < survivalTime) Assert.IsTrue(contains);
+
+                Thread.Sleep(survivalTime + survivalTime);
+
+                set.TrimExcess();
+                Assert.IsFalse(set.Contains(0));
+                Assert.AreEqual(0, set.Count);
+            }
+
+            // 削除してから追加し直したものは、削除前の古い記録では取り除かれない。
+            {
+                var set = new VolatileHashSet<int>(survivalTime);
+
+                Assert.IsTrue(set.Add(0));
+                Assert.IsTrue(set.Remove(0));
+                Assert.IsTrue(set.Add(0));
+                Assert.IsTrue(set.Contains(0));
+
+                Thread.Sleep(halfTime);
+
+                Assert.IsTrue(set.Remove(0));
+                Assert.IsFalse(set.Contains(0));
+
+                var addTime = DateTime.UtcNow;
+                Assert.IsTrue(set.Add(0));
+
+                Thread.Sleep(threeQuarterTime);
+
+                set.TrimExcess();
+                bool contains = set.Contains(0);
+                if ((DateTime.UtcNow - addTime) < survivalTime) Assert.IsTrue(contains);
+            }
+
+            // Clear の後は空で、TrimExcess も Clear の前に追加したものの記録で後から追加したものを取り除かない。
+            {
+                var set = new VolatileHashSet<int>(survivalTime);
+
+                for (int i = 0; i < 16; i++)
+                {
+                    set.Add(i);
+                }
+
+                set.Clear();
+                Assert.AreEqual(0, set.Count);
+
+                set.TrimExcess();
+                Assert.AreEqual(0, set.Count);
+
+                Thread.Sleep(halfTime);
+
+                var addTime = DateTime.UtcNow;
+                Assert.IsTrue(set.Add(0));
+
+                Thread.Sleep(threeQuarterTime);
+
+                set.TrimExcess();
+                bool contains = set.Contains(0);
+                if ((DateTime.UtcNow - addTime) < survivalTime) Assert.IsTrue(contains);
+                Assert.AreEqual(contains ? 1 : 0, set.Count);
+            }
+        }
+
+        [Test]
+        public void Test_VolatileHashDictionary()
+        {
+            // 生存時間の 1/64 (10ms) が更新時刻の単位になる。
+            var survivalTime = TimeSpan.FromMilliseconds(640);
+            int halfTime = (int)(survivalTime.TotalMilliseconds / 2);
+            int threeQuarterTime = (int)(survivalTime.TotalMilliseconds * 3 / 4);
+
+            // 追加してから生存時間が経つまでは取り除かれず、その後は取り除かれる。
+            {
+                var dic = new VolatileHashDictionary<int, string>(survivalTime);
+
+                var addTime = DateTime.UtcNow;
+
+                for (int i = 0; i < 16; i++)
+                {
+                    dic.Add(i, i.ToString());
+                }
+
+                for (; ; )
+                {
+                    dic.TrimExcess();
+                    int count = dic.Count;
+                    var elapsed = DateTime.UtcNow - addTime;
+
+                    if (count < 16) Assert.IsTrue(elapsed >= survivalTime);
+                    if (count == 0) break;
+
+                    Assert.IsTrue(elapsed < survivalTime + survivalTime + survivalTime);
+
+                    Thread.Sleep(5);
+                }
+            }
+
+            // 同じ単位の中での再設定は値だけを変え、後の単位での再設定は期限も延ばす。
+            {
+                var dic = new VolatileHashDictionary<int, string>(survivalTime);
+
+                Assert.IsTrue(dic.Add(0, "a"));
+                dic[0] = "b";
+                Assert.AreEqual(1, dic.Count);
+                Assert.AreEqual("b", dic[0]);
+
+                Thread.Sleep(halfTime);
+
+                var refreshTime = DateTime.UtcNow;
+                dic[0] = "c";
+
+                // 最初の追加の記録は期限を過ぎたが、再設定からはまだ生存時間が経っていない。
+                Thread.Sleep(threeQuarterTime);
+
+                dic.TrimExcess();
+                string value;
+                bool contains = dic.TryGetValue(0, out value);
+                if ((DateTime.UtcNow - refreshTime) < survivalTime) Assert.IsTrue(contains);
+                if (contains) Assert.AreEqual("c", value);
+
+                Thread.Sleep(survivalTime + survivalTime);
+
+                dic.TrimExcess();
+                Assert.IsFalse(dic.ContainsKey(0));
+                Assert.AreEqual(0, dic.Count);
+            }
+
+            // 削除してから追加し直したものは、削除前の古い記録では取り除かれない。
+            {
+                var dic = new VolatileHashDictionary<int, string>(survivalTime);
+
+                Assert.IsTrue(dic.Add(0, "a"));
+                Assert.IsTrue(dic.Remove(0));
+                Assert.IsTrue(dic.Add(0, "b"));
+                Assert.AreEqual("b", dic[0]);
+
+                Thread.Sleep(halfTime);
+
+                Assert.IsTrue(dic.Remove(0));
+                Assert.IsFalse(dic.ContainsKey(0));
+
+                var addTime = DateTime.UtcNow;
+                Assert.IsTrue(dic.Add(0, "c"));
+
+                Thread.Sleep(threeQuarterTime);
+
+                dic.TrimExcess();
+                string value;
+                bool contains = dic.TryGetValue(0, out value);
+                if ((DateTime.UtcNow - addTime) < survivalTime) Assert.IsTrue(contains);
+                if (contains) Assert.AreEqual("c", value);
+            }
+
+            // Clear の後は空で、TrimExcess も Clear の前に追加したものの記録で後から追加したものを取り除かない。
+            {
+                var dic = new VolatileHashDictionary<int, string>(survivalTime);
+
+                for (int i = 0; i < 16; i++)
+                {
+                    dic.Add(i, i.ToString());
+                }
+
+                dic.Clear();
+                Assert.AreEqual(0, dic.Count);
+
+                dic.TrimExcess();
+                Assert.AreEqual(0, dic.Count);
+
+                Thread.Sleep(halfTime);
+
+                var addTime = DateTime.UtcNow;
+                Assert.IsTrue(dic.Add(0, "a"));
+
+                Thread.Sleep(threeQuarterTime);
+
+                dic.TrimExcess();
+                bool contains = dic.ContainsKey(0);
+                if ((DateTime.UtcNow - addTime) < survivalTime) Assert.IsTrue(contains);
+                Assert.AreEqual(contains ? 1 : 0, dic.Count);
+            }
+        }
     }
 }
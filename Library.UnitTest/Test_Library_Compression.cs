@@ -105,5 +105,36 @@ namespace Library.UnitTest
                 }
             }
         }
+
+        [Test]
+        public void Test_Lz4()
+        {
+            {
+                byte[] buffer1 = new byte[1024 * 1024];
+
+                for (int i = 0; i < buffer1.Length; i += 64)
+                {
+                    buffer1[i] = (byte)_random.Next(0, 256);
+                }
+
+                byte[] buffer2 = new byte[buffer1.Length];
+                byte[] buffer3 = new byte[buffer1.Length];
+
+                int length = Lz4.Compress(buffer1, 0, buffer1.Length, buffer2, 0, buffer2.Length);
+                Assert.IsTrue(length > 0 && length < buffer1.Length);
+
+                Assert.AreEqual(buffer1.Length, Lz4.Decompress(buffer2, 0, length, buffer3, 0, buffer3.Length));
+                Assert.IsTrue(CollectionUtilities.Equals(buffer1, buffer3));
+            }
+
+            {
+                byte[] buffer1 = new byte[1024 * 64];
+                _random.NextBytes(buffer1);
+
+                byte[] buffer2 = new byte[buffer1.Length];
+
+                Assert.AreEqual(0, Lz4.Compress(buffer1, 0, buffer1.Length, buffer2, 0, buffer2.Length));
+            }
+        }
     }
 }
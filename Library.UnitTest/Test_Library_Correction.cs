@@ -203,5 +203,50 @@ namespace Library.UnitTest
                 }
             }
         }
+
+        [Test]
+        public void Test_ReedSolomon8_EncodeSha256()
+        {
+            int blockLength = 1024 * 64 + 13;
+
+            ReedSolomon8 reedSolomon8 = new ReedSolomon8(16, 32, 4, _bufferManager);
+
+            var buffList = new ArraySegment<byte>[16];
+            for (int i = 0; i < 16; i++)
+            {
+                var buffer = new byte[blockLength + 7];
+                _random.NextBytes(buffer);
+
+                buffList[i] = new ArraySegment<byte>(buffer, 7, blockLength);
+            }
+
+            var buffList2 = new ArraySegment<byte>[24];
+            var buffList3 = new ArraySegment<byte>[24];
+            for (int i = 0; i < 24; i++)
+            {
+                buffList2[i] = new ArraySegment<byte>(new byte[blockLength], 0, blockLength);
+                buffList3[i] = new ArraySegment<byte>(new byte[blockLength], 0, blockLength);
+            }
+
+            var intList = new int[24];
+            for (int i = 0; i < 24; i++)
+            {
+                intList[i] = i + 8;
+            }
+
+            var hashes = new byte[24][];
+
+            reedSolomon8.Encode(buffList, buffList2, intList, blockLength);
+            reedSolomon8.Encode(buffList, buffList3, intList, blockLength, hashes);
+
+            using (var sha256 = System.Security.Cryptography.SHA256.Create())
+            {
+                for (int i = 0; i < 24; i++)
+                {
+                    Assert.IsTrue(CollectionUtilities.Equals(buffList2[i].Array, buffList3[i].Array), "ReedSolomon #1");
+                    Assert.IsTrue(CollectionUtilities.Equals(sha256.ComputeHash(buffList2[i].Array), hashes[i]), "ReedSolomon #2");
+                }
+            }
+        }
     }
 }
@@ -1,5 +1,6 @@
 using System;
 using System.Collections.Generic;
+using System.IO;
 using System.Net;
 using System.Net.Sockets;
 using System.Threading;
@@ -396,6 +397,97 @@ namespace Library.UnitTest
             }
         }
 
+        private LockedHashDictionary<Key, CacheManager.ClusterInfo> CreateClusterIndex(int count)
+        {
+            var clusterIndex = new LockedHashDictionary<Key, CacheManager.ClusterInfo>();
+
+            for (int i = 0; i < count; i++)
+            {
+                var hash = new byte[32];
+                _random.NextBytes(hash);
+
+                var clusterInfo = new CacheManager.ClusterInfo();
+                clusterInfo.Length = _random.Next(1, CacheManager.SectorSize * 4);
+                clusterInfo.UpdateTime = DateTime.UtcNow.AddSeconds(-_random.Next(0, 60 * 60 * 24));
+                clusterInfo.Indexes = new long[(clusterInfo.Length + (CacheManager.SectorSize - 1)) / CacheManager.SectorSize];
+
+                for (int j = 0; j < clusterInfo.Indexes.Length; j++)
+                {
+                    clusterInfo.Indexes[j] = ((long)_random.Next() << 8) | (long)_random.Next(0, 256);
+                }
+
+                clusterIndex[new Key(hash, HashAlgorithm.Sha256)] = clusterInfo;
+            }
+
+            return clusterIndex;
+        }
+
+        private void AssertClusterIndex(LockedHashDictionary<Key, CacheManager.ClusterInfo> expected, LockedHashDictionary<Key, CacheManager.ClusterInfo> actual)
+        {
+            Assert.AreEqual(expected.Count, actual.Count);
+
+            foreach (var pair in expected)
+            {
+                CacheManager.ClusterInfo clusterInfo;
+                Assert.IsTrue(actual.TryGetValue(pair.Key, out clusterInfo));
+
+                Assert.AreEqual(pair.Value.Length, clusterInfo.Length);
+                Assert.AreEqual(pair.Value.UpdateTime, clusterInfo.UpdateTime);
+                Assert.AreEqual(pair.Value.Indexes, clusterInfo.Indexes);
+            }
+        }
+
+        [Test]
+        public void Test_CacheManager_ClusterIndex()
+        {
+            var clusterIndex1 = this.CreateClusterIndex(256);
+            var clusterIndex2 = this.CreateClusterIndex(16);
+
+            this.AssertClusterIndex(clusterIndex1, CacheManager.ClusterIndexSnapshot.Decode(CacheManager.ClusterIndexSnapshot.Encode(clusterIndex1)));
+            this.AssertClusterIndex(clusterIndex2, CacheManager.ClusterIndexSnapshot.Decode(CacheManager.ClusterIndexSnapshot.Encode(clusterIndex2)));
+
+            {
+                var buffer = CacheManager.ClusterIndexSnapshot.Encode(clusterIndex1);
+                buffer[buffer.Length - 1] ^= 0x01;
+
+                try
+                {
+                    CacheManager.ClusterIndexSnapshot.Decode(buffer);
+                    Assert.Fail("ClusterIndex crc");
+                }
+                catch (FormatException)
+                {
+
+                }
+            }
+
+            string directoryPath = Path.Combine(Path.GetTempPath(), "Test_CacheManager_ClusterIndex_" + Guid.NewGuid().ToString("N"));
+            Directory.CreateDirectory(directoryPath);
+
+            try
+            {
+                // The second Save moves the first snapshot to .bak.
+                CacheManager.ClusterIndexSnapshot.Save(directoryPath, clusterIndex1);
+                CacheManager.ClusterIndexSnapshot.Save(directoryPath, clusterIndex2);
+
+                this.AssertClusterIndex(clusterIndex2, CacheManager.ClusterIndexSnapshot.Load(directoryPath));
+
+                // A snapshot with a bad CRC is skipped in favour of .bak.
+                {
+                    var path = Path.Combine(directoryPath, "ClustersIndex.snapshot");
+                    var buffer = File.ReadAllBytes(path);
+                    buffer[buffer.Length - 1] ^= 0x01;
+                    File.WriteAllBytes(path, buffer);
+                }
+
+                this.AssertClusterIndex(clusterIndex1, CacheManager.ClusterIndexSnapshot.Load(directoryPath));
+            }
+            finally
+            {
+                Directory.Delete(directoryPath, true);
+            }
+        }
+
         [Test]
         public void Test_ConnectionManager()
         {
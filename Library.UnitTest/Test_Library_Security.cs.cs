@@ -3,6 +3,7 @@ using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
 using System.Security.Cryptography;
+using System.Text;
 using System.Threading;
 using System.Threading.Tasks;
 using Library.Security;
@@ -103,6 +104,28 @@ namespace Library.UnitTest
                 Assert.IsTrue(CollectionUtilities.Equals(pbkdf2.GetBytes(1024), rfc2898DeriveBytes.GetBytes(1024)), "Pbkdf2 #1");
             }
 
+            // RFC 7914 test vectors for PBKDF2-HMAC-SHA256.
+            using (var hmac = new System.Security.Cryptography.HMACSHA256())
+            {
+                Pbkdf2 pbkdf2 = new Pbkdf2(hmac, Encoding.ASCII.GetBytes("passwd"), Encoding.ASCII.GetBytes("salt"), 1);
+
+                Assert.IsTrue(CollectionUtilities.Equals(pbkdf2.GetBytes(64),
+                    NetworkConverter.FromHexString("55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783")), "Pbkdf2 #2");
+            }
+
+            using (var hmac = new System.Security.Cryptography.HMACSHA256())
+            {
+                Pbkdf2 pbkdf2 = new Pbkdf2(hmac, Encoding.ASCII.GetBytes("Password"), Encoding.ASCII.GetBytes("NaCl"), 80000);
+
+                // Split reads continue the same key stream.
+                var result = new byte[64];
+                Array.Copy(pbkdf2.GetBytes(10), 0, result, 0, 10);
+                Array.Copy(pbkdf2.GetBytes(54), 0, result, 10, 54);
+
+                Assert.IsTrue(CollectionUtilities.Equals(result,
+                    NetworkConverter.FromHexString("4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d")), "Pbkdf2 #3");
+            }
+
             //_random.NextBytes(password);
             //_random.NextBytes(salt);
 
@@ -144,6 +167,33 @@ namespace Library.UnitTest
             Assert.IsTrue(CollectionUtilities.Equals(T_Crc32_Castagnoli.ComputeHash(list), Crc32_Castagnoli.ComputeHash(list)));
         }
 
+        [Test]
+        public void Test_SipHash()
+        {
+            // SipHash-1-3, key 00..0f, message 00..(length - 1).
+            byte[] key = new byte[16];
+            for (int i = 0; i < key.Length; i++) key[i] = (byte)i;
+
+            byte[] message = new byte[64];
+            for (int i = 0; i < message.Length; i++) message[i] = (byte)i;
+
+            var sipHash = new SipHash(key);
+
+            Assert.AreEqual(unchecked((long)0xabac0158050fc4dcUL), sipHash.ComputeHash(message, 0, 0));
+            Assert.AreEqual(unchecked((long)0xd3927d989bb11140UL), sipHash.ComputeHash(message, 0, 7));
+            Assert.AreEqual(unchecked((long)0x369095118d299a8eUL), sipHash.ComputeHash(message, 0, 8));
+            Assert.AreEqual(unchecked((long)0xd320d86d2a519956UL), sipHash.ComputeHash(message, 0, 15));
+            Assert.AreEqual(unchecked((long)0x81157b6c16a7b60dUL), sipHash.ComputeHash(message, 0, 32));
+            Assert.AreEqual(unchecked((long)0xf17997ec4b4a6065UL), sipHash.ComputeHash(message, 0, 64));
+
+            byte[] buffer = new byte[32];
+            _random.NextBytes(buffer);
+
+            var sipHash2 = new SipHash(new byte[16]);
+
+            Assert.AreNotEqual(sipHash.ComputeHash(buffer), sipHash2.ComputeHash(buffer));
+        }
+
         [Test]
         public void Test_HmacSha256()
         {
@@ -187,6 +237,164 @@ namespace Library.UnitTest
             }
         }
 
+        [Test]
+        public void Test_Sha256_Batch()
+        {
+            var values = new List<ArraySegment<byte>>();
+            var hashes = new List<byte[]>();
+
+            byte[] buffer = new byte[1024 * 1024 * 4];
+            _random.NextBytes(buffer);
+
+            for (int i = 0, offset = 0; i < 64; i++)
+            {
+                int length = (i < 16) ? i * 9 : _random.Next(0, 1024 * 64);
+
+                values.Add(new ArraySegment<byte>(buffer, offset, length));
+                offset += length;
+            }
+
+            using (var sha256 = SHA256.Create())
+            {
+                foreach (var value in values)
+                {
+                    hashes.Add(sha256.ComputeHash(value.Array, value.Offset, value.Count));
+                }
+            }
+
+            var results = Sha256.ComputeHashes(values);
+
+            for (int i = 0; i < values.Count; i++)
+            {
+                Assert.IsTrue(Unsafe.Equals(hashes[i], results[i]), "Sha256 #1");
+            }
+
+            hashes[3] = new byte[32];
+            hashes[40][0] ^= 0x01;
+
+            var flags = Sha256.VerifyHashes(values, hashes);
+
+            for (int i = 0; i < values.Count; i++)
+            {
+                Assert.AreEqual(i != 3 && i != 40, flags[i], "Sha256 #2");
+            }
+        }
+
+        [Test]
+        public void Test_Aes256Stream()
+        {
+            byte[] key = new byte[32];
+            byte[] iv = new byte[16];
+            _random.NextBytes(key);
+            _random.NextBytes(iv);
+
+            foreach (var length in new int[] { 0, 1, 15, 16, 17, 1024 * 1024 - 1, 1024 * 1024, 1024 * 1024 * 3 + 5 })
+            {
+                byte[] value = new byte[length];
+                _random.NextBytes(value);
+
+                byte[] expected;
+
+                using (var aes = Aes.Create())
+                {
+                    aes.KeySize = 256;
+                    aes.Mode = CipherMode.CBC;
+                    aes.Padding = PaddingMode.PKCS7;
+
+                    expected = aes.CreateEncryptor(key, iv).TransformFinalBlock(value, 0, value.Length);
+                }
+
+                foreach (var mode in new Aes256Mode[] { Aes256Mode.Cbc, Aes256Mode.Ctr })
+                {
+                    var encryptStream = new MemoryStream();
+
+                    using (var stream = new Aes256Stream(encryptStream, key, iv, mode, CryptoStreamMode.Write, _bufferManager))
+                    {
+                        for (int offset = 0; offset < value.Length; )
+                        {
+                            int count = Math.Min(_random.Next(1, 1024 * 64), value.Length - offset);
+                            stream.Write(value, offset, count);
+                            offset += count;
+                        }
+                    }
+
+                    byte[] encrypted = encryptStream.ToArray();
+
+                    if (mode == Aes256Mode.Cbc)
+                    {
+                        Assert.IsTrue(Unsafe.Equals(expected, encrypted), "Aes256Stream #1");
+                    }
+                    else
+                    {
+                        Assert.AreEqual(value.Length, encrypted.Length, "Aes256Stream #2");
+                    }
+
+                    var decryptStream = new MemoryStream();
+
+                    using (var stream = new Aes256Stream(new MemoryStream(encrypted), key, iv, mode, CryptoStreamMode.Read, _bufferManager))
+                    {
+                        stream.CopyTo(decryptStream);
+                    }
+
+                    Assert.IsTrue(Unsafe.Equals(value, decryptStream.ToArray()), "Aes256Stream #3");
+                }
+            }
+        }
+
+        [Test]
+        public void Test_Aes256_HmacSha256()
+        {
+            byte[] key = new byte[32];
+            byte[] hmacKey = new byte[32];
+            byte[] iv = new byte[16];
+            _random.NextBytes(key);
+            _random.NextBytes(hmacKey);
+            _random.NextBytes(iv);
+
+            using (var aes256 = new Aes256(key))
+            {
+                foreach (var length in new int[] { 0, 1, 16, 1024 * 8 - 1, 1024 * 8 + 1, 1024 * 256 })
+                {
+                    const int headerLength = 24;
+
+                    byte[] value = new byte[headerLength + length];
+                    _random.NextBytes(value);
+
+                    byte[] buffer = new byte[headerLength + length + 16 + 32];
+                    Array.Copy(value, buffer, value.Length);
+
+                    int cryptoLength = aes256.CbcEncryptHmacSha256(iv, hmacKey, buffer, 0, headerLength, length);
+
+                    byte[] expected;
+
+                    using (var aes = Aes.Create())
+                    {
+                        aes.KeySize = 256;
+                        aes.Mode = CipherMode.CBC;
+                        aes.Padding = PaddingMode.PKCS7;
+
+                        expected = aes.CreateEncryptor(key, iv).TransformFinalBlock(value, headerLength, length);
+                    }
+
+                    Assert.AreEqual(expected.Length, cryptoLength, "Aes256_HmacSha256 #1");
+                    Assert.IsTrue(Unsafe.Equals(expected, 0, buffer, headerLength, cryptoLength), "Aes256_HmacSha256 #2");
+
+                    using (var hmac = new HMACSHA256(hmacKey))
+                    {
+                        Assert.IsTrue(Unsafe.Equals(hmac.ComputeHash(buffer, 0, headerLength + cryptoLength), 0, buffer, headerLength + cryptoLength, 32), "Aes256_HmacSha256 #3");
+                    }
+
+                    byte[] tampered = buffer.Clone() as byte[];
+                    tampered[_random.Next(0, headerLength + cryptoLength + 32)] ^= 0x01;
+
+                    Assert.AreEqual(-1, aes256.CbcDecryptHmacSha256(iv, hmacKey, tampered, 0, headerLength, cryptoLength), "Aes256_HmacSha256 #4");
+
+                    Assert.AreEqual(length, aes256.CbcDecryptHmacSha256(iv, hmacKey, buffer, 0, headerLength, cryptoLength), "Aes256_HmacSha256 #5");
+                    Assert.IsTrue(Unsafe.Equals(value, 0, buffer, 0, value.Length), "Aes256_HmacSha256 #6");
+                }
+            }
+        }
+
         [Test]
         public void Test_Miner()
         {
@@ -228,6 +436,20 @@ namespace Library.UnitTest
                 }
             }
 
+            {
+                Miner miner = new Miner(CashAlgorithm.Version1, 20, new TimeSpan(1, 0, 0), Environment.ProcessorCount);
+
+                Cash cash = null;
+
+                using (MemoryStream stream = new MemoryStream(NetworkConverter.FromHexString("0101010101010101")))
+                {
+                    cash = miner.Create(stream);
+
+                    stream.Seek(0, SeekOrigin.Begin);
+                    Assert.IsTrue(Miner.Verify(cash, stream) >= 20);
+                }
+            }
+
             {
                 Miner miner = new Miner(CashAlgorithm.Version1, 0, TimeSpan.Zero);
 
@@ -270,5 +492,40 @@ namespace Library.UnitTest
                 Assert.IsTrue(sw.ElapsedMilliseconds < 1000 * 30);
             }
         }
+
+        [Test]
+        public void Test_Miner_VerifyBatch()
+        {
+            var cashes = new List<Cash>();
+            var streams = new List<Stream>();
+            var expected = new List<int>();
+
+            for (int i = 0; i < 32; i++)
+            {
+                var buffer = new byte[_random.Next(0, 1024)];
+                _random.NextBytes(buffer);
+
+                var miner = new Miner(CashAlgorithm.Version1, 4, new TimeSpan(0, 1, 0));
+
+                using (var stream = new MemoryStream(buffer))
+                {
+                    var cash = (i % 5 == 0) ? null : miner.Create(stream);
+                    cashes.Add(cash);
+
+                    stream.Seek(0, SeekOrigin.Begin);
+                    expected.Add(Miner.Verify(cash, stream));
+                }
+
+                streams.Add(new MemoryStream(buffer));
+            }
+
+            var results = Miner.Verify(cashes, streams);
+
+            for (int i = 0; i < results.Length; i++)
+            {
+                Assert.AreEqual(expected[i], results[i]);
+                if (cashes[i] != null) Assert.IsTrue(results[i] >= 4);
+            }
+        }
     }
 }
@@ -0,0 +1,241 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Library
+{
+    // 32 バイトのキー (SHA-256 のハッシュ) のための分割ブロック型 Bloom フィルタ。
+    // 32 バイトのブロックを並べたもので、キーはブロックを一つ選び、その中の 8 つの 32 ビット語に 1 ビットずつ立てる。
+    // キーそのものが一様なハッシュなので、位置はキーのバイト列から直接決め、改めてハッシュは計算しない。
+    // ブロックの並びがそのまま直列化した形式になるため、位置の決め方はネイティブ側と同じものを変えずに使うこと。
+    public unsafe sealed class BloomFilter
+    {
+        public const int KeyLength = 32;
+        private const int BlockLength = 32;
+
+        private static readonly uint[] _salts = new uint[]
+        {
+            0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+            0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+        };
+
+        private byte[] _blocks;
+        private int _blockCount;
+
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void InsertDelegate(byte* blocks, int blockCount, byte* keys, int count);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int QueryDelegate(byte* blocks, int blockCount, byte* keys, int count, bool* result);
+
+        private static InsertDelegate _insert;
+        private static QueryDelegate _query;
+#endif
+
+        static BloomFilter()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x86.dll");
+                }
+
+                _insert = _nativeLibraryManager.GetMethod<InsertDelegate>("bloom_filter_insert");
+                _query = _nativeLibraryManager.GetMethod<QueryDelegate>("bloom_filter_query");
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// capacity 個のキーを、1 キーあたり bitsPerKey ビットで保持するフィルタを作ります
+        /// 誤検出率の目安は 8 ビットで約 3%、10 ビットで約 1.3%、16 ビットで約 0.1% です
+        /// </summary>
+        public BloomFilter(int capacity, int bitsPerKey)
+        {
+            if (capacity < 0) throw new ArgumentOutOfRangeException("capacity");
+            if (bitsPerKey <= 0 || bitsPerKey > 256) throw new ArgumentOutOfRangeException("bitsPerKey");
+
+            long blockCount = Math.Max(1, (((long)capacity * bitsPerKey) + (BlockLength * 8 - 1)) / (BlockLength * 8));
+            if (blockCount > int.MaxValue / BlockLength) throw new ArgumentOutOfRangeException("capacity");
+
+            _blockCount = (int)blockCount;
+            _blocks = new byte[_blockCount * BlockLength];
+        }
+
+        /// <summary>
+        /// ToArray で書き出したフィルタを読み込みます
+        /// </summary>
+        public BloomFilter(byte[] buffer, int offset, int length)
+        {
+            if (buffer == null) throw new ArgumentNullException("buffer");
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (length < 0 || (buffer.Length - offset) < length) throw new ArgumentOutOfRangeException("length");
+            if (length == 0 || (length % BlockLength) != 0) throw new ArgumentException("length");
+
+            _blockCount = length / BlockLength;
+            _blocks = new byte[length];
+            Array.Copy(buffer, offset, _blocks, 0, length);
+        }
+
+        public BloomFilter(byte[] buffer)
+            : this(buffer, 0, (buffer != null) ? buffer.Length : 0)
+        {
+
+        }
+
+        public int Length
+        {
+            get
+            {
+                return _blocks.Length;
+            }
+        }
+
+        public byte[] ToArray()
+        {
+            var buffer = new byte[_blocks.Length];
+            Array.Copy(_blocks, buffer, _blocks.Length);
+
+            return buffer;
+        }
+
+        public void Add(byte[] key)
+        {
+            if (key == null) throw new ArgumentNullException("key");
+            if (key.Length != KeyLength) throw new ArgumentOutOfRangeException("key");
+
+            this.AddRange(key, 0, 1);
+        }
+
+        /// <summary>
+        /// keys の offset から隙間なく並べた count 個のキーを加えます
+        /// </summary>
+        public void AddRange(byte[] keys, int offset, int count)
+        {
+            if (keys == null) throw new ArgumentNullException("keys");
+            if (offset < 0 || keys.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (count < 0 || (keys.Length - offset) / KeyLength < count) throw new ArgumentOutOfRangeException("count");
+
+            if (count == 0) return;
+
+            fixed (byte* p_blocks = _blocks)
+            fixed (byte* p_keys = keys)
+            {
+#if Mono
+
+#else
+                if (_insert != null)
+                {
+                    _insert(p_blocks, _blockCount, p_keys + offset, count);
+
+                    return;
+                }
+#endif
+
+                for (int i = 0; i < count; i++)
+                {
+                    var t_key = p_keys + offset + (i * KeyLength);
+                    var t_block = (uint*)(p_blocks + (BloomFilter.GetBlockIndex(t_key, _blockCount) * BlockLength));
+
+                    for (int j = 0; j < 8; j++)
+                    {
+                        t_block[j] |= BloomFilter.GetBit(t_key, j);
+                    }
+                }
+            }
+        }
+
+        public bool Contains(byte[] key)
+        {
+            if (key == null) throw new ArgumentNullException("key");
+            if (key.Length != KeyLength) throw new ArgumentOutOfRangeException("key");
+
+            var result = new bool[1];
+            this.Contains(key, 0, 1, result);
+
+            return result[0];
+        }
+
+        /// <summary>
+        /// keys の offset から隙間なく並べた count 個のキーを調べ、含まれる可能性があるものを result に true で書き込みます
+        /// </summary>
+        /// <returns>true の数</returns>
+        public int Contains(byte[] keys, int offset, int count, bool[] result)
+        {
+            if (keys == null) throw new ArgumentNullException("keys");
+            if (offset < 0 || keys.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (count < 0 || (keys.Length - offset) / KeyLength < count) throw new ArgumentOutOfRangeException("count");
+            if (result == null) throw new ArgumentNullException("result");
+            if (result.Length < count) throw new ArgumentOutOfRangeException("result");
+
+            if (count == 0) return 0;
+
+            fixed (byte* p_blocks = _blocks)
+            fixed (byte* p_keys = keys)
+            fixed (bool* p_result = result)
+            {
+#if Mono
+
+#else
+                if (_query != null) return _query(p_blocks, _blockCount, p_keys + offset, count, p_result);
+#endif
+
+                int hits = 0;
+
+                for (int i = 0; i < count; i++)
+                {
+                    var t_key = p_keys + offset + (i * KeyLength);
+                    var t_block = (uint*)(p_blocks + (BloomFilter.GetBlockIndex(t_key, _blockCount) * BlockLength));
+
+                    bool hit = true;
+
+                    for (int j = 0; j < 8; j++)
+                    {
+                        if ((t_block[j] & BloomFilter.GetBit(t_key, j)) == 0)
+                        {
+                            hit = false;
+
+                            break;
+                        }
+                    }
+
+                    result[i] = hit;
+                    if (hit) hits++;
+                }
+
+                return hits;
+            }
+        }
+
+        private static int GetBlockIndex(byte* key, int blockCount)
+        {
+            return (int)(((ulong)BloomFilter.Load32(key) * (uint)blockCount) >> 32);
+        }
+
+        private static uint GetBit(byte* key, int word)
+        {
+            return 1U << (int)((BloomFilter.Load32(key + (word * 4)) * _salts[word]) >> 27);
+        }
+
+        private static uint Load32(byte* p)
+        {
+            return (uint)(p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24));
+        }
+    }
+}
@@ -0,0 +1,282 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Library
+{
+    // Gear ハッシュによる内容依存の分割 (FastCDC 方式)。
+    // minLength 未満では切らず、averageLength までは厳しいマスク、それ以降は緩いマスクで切り、maxLength で必ず切る。
+    // ハッシュは直前の 64 バイトだけで決まるため、途中にバイトが挿入されても、その後の切れ目は元の位置に戻る。
+    // ギアテーブルとマスクは切れ目、すなわち各チャンクのキーを決めるため、ネイティブ側と同じものを変えずに使うこと。
+    public unsafe sealed class Chunker : ManagerBase
+    {
+        private IntPtr _handle;
+
+        private int _minLength;
+        private int _averageLength;
+        private int _maxLength;
+
+        private ulong[] _gear;
+        private ulong _strictMask;
+        private ulong _looseMask;
+        private ulong _hash;
+        private int _length;
+
+        private volatile bool _disposed;
+
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate IntPtr CreateDelegate(int minLength, int averageLength, int maxLength);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void DeleteDelegate(IntPtr chunker);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void ResetDelegate(IntPtr chunker);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int FeedDelegate(IntPtr chunker, byte* buffer, int length, int* cuts, int cutsLength);
+
+        private static CreateDelegate _create;
+        private static DeleteDelegate _delete;
+        private static ResetDelegate _reset;
+        private static FeedDelegate _feed;
+#endif
+
+        static Chunker()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x86.dll");
+                }
+
+                _create = _nativeLibraryManager.GetMethod<CreateDelegate>("chunker_create");
+                _delete = _nativeLibraryManager.GetMethod<DeleteDelegate>("chunker_delete");
+                _reset = _nativeLibraryManager.GetMethod<ResetDelegate>("chunker_reset");
+                _feed = _nativeLibraryManager.GetMethod<FeedDelegate>("chunker_feed");
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        public Chunker(int minLength, int averageLength, int maxLength)
+        {
+            if (minLength <= 0) throw new ArgumentOutOfRangeException("minLength");
+            if (averageLength < minLength || averageLength < 16) throw new ArgumentOutOfRangeException("averageLength");
+            if (maxLength < averageLength || maxLength > (1 << 29)) throw new ArgumentOutOfRangeException("maxLength");
+
+            _minLength = minLength;
+            _averageLength = averageLength;
+            _maxLength = maxLength;
+
+#if Mono
+
+#else
+            if (_create != null)
+            {
+                _handle = _create(minLength, averageLength, maxLength);
+                if (_handle == IntPtr.Zero) throw new ArgumentException();
+
+                return;
+            }
+#endif
+
+            _gear = Chunker.CreateGear();
+
+            // マスクは log2(averageLength) ビット。平均より短い間は 2 ビット多く、長くなったら 2 ビット少なくする。
+            int bits = 0;
+            while ((2 << bits) <= averageLength) bits++;
+
+            _strictMask = ulong.MaxValue << (64 - (bits + 2));
+            _looseMask = ulong.MaxValue << (64 - (bits - 2));
+        }
+
+        // splitmix64、種は固定。
+        private static ulong[] CreateGear()
+        {
+            var gear = new ulong[256];
+            ulong x = 0x4368756e6b657221UL;
+
+            for (int i = 0; i < gear.Length; i++)
+            {
+                x += 0x9e3779b97f4a7c15UL;
+
+                ulong z = x;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+
+                gear[i] = z ^ (z >> 31);
+            }
+
+            return gear;
+        }
+
+        public bool IsNative
+        {
+            get
+            {
+                return _handle != IntPtr.Zero;
+            }
+        }
+
+        public int MinLength
+        {
+            get
+            {
+                return _minLength;
+            }
+        }
+
+        public int AverageLength
+        {
+            get
+            {
+                return _averageLength;
+            }
+        }
+
+        public int MaxLength
+        {
+            get
+            {
+                return _maxLength;
+            }
+        }
+
+        /// <summary>
+        /// Feed に渡す cuts に必要な長さを返します
+        /// </summary>
+        public int GetCutsLength(int count)
+        {
+            return (count / _minLength) + 1;
+        }
+
+        /// <summary>
+        /// 新しいストリームの分割を始めます
+        /// </summary>
+        public void Reset()
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                _reset(_handle);
+
+                return;
+            }
+#endif
+
+            _hash = 0;
+            _length = 0;
+        }
+
+        /// <summary>
+        /// ストリームの続き count バイトを渡し、その中にある切れ目 (各チャンクの末尾の直後を指す buffer 内の位置) を cuts に書き込みます
+        /// 最後の切れ目より後ろのバイトは次のチャンクの先頭になります
+        /// </summary>
+        /// <returns>切れ目の数</returns>
+        public int Feed(byte[] buffer, int offset, int count, int[] cuts)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (buffer == null) throw new ArgumentNullException("buffer");
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (count < 0 || (buffer.Length - offset) < count) throw new ArgumentOutOfRangeException("count");
+            if (cuts == null) throw new ArgumentNullException("cuts");
+            if (cuts.Length < this.GetCutsLength(count)) throw new ArgumentOutOfRangeException("cuts");
+
+            if (count == 0) return 0;
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                int result;
+
+                fixed (byte* p_buffer = buffer)
+                fixed (int* p_cuts = cuts)
+                {
+                    result = _feed(_handle, p_buffer + offset, count, p_cuts, cuts.Length);
+                }
+
+                if (result < 0) throw new ArgumentOutOfRangeException("cuts");
+
+                if (offset != 0)
+                {
+                    for (int i = 0; i < result; i++)
+                    {
+                        cuts[i] += offset;
+                    }
+                }
+
+                return result;
+            }
+#endif
+
+            int cutCount = 0;
+
+            ulong hash = _hash;
+            int length = _length;
+
+            for (int i = offset, end = offset + count; i < end; i++)
+            {
+                hash = (hash << 1) + _gear[buffer[i]];
+                length++;
+
+                if (length < _minLength) continue;
+
+                if (length >= _maxLength
+                    || (hash & ((length < _averageLength) ? _strictMask : _looseMask)) == 0)
+                {
+                    cuts[cutCount++] = i + 1;
+                    length = 0;
+                }
+            }
+
+            _hash = hash;
+            _length = length;
+
+            return cutCount;
+        }
+
+        protected override void Dispose(bool disposing)
+        {
+            if (_disposed) return;
+            _disposed = true;
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                try
+                {
+                    _delete(_handle);
+                }
+                catch (Exception)
+                {
+
+                }
+
+                _handle = IntPtr.Zero;
+            }
+#endif
+        }
+    }
+}
@@ -0,0 +1,526 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Runtime.InteropServices;
+using System.Security;
+using System.Threading;
+
+namespace Library
+{
+    // ファイルをウィンドウ単位でメモリマップし、FileStream の Seek/Read/Write を経由せずに直接コピーする。
+    // 読み出しは呼び出し元のバッファへの memcpy 1 回で、マップされた領域そのものは外に渡さない。
+    // ネイティブライブラリが使えない環境では FileStream にフォールバックする。
+    public unsafe sealed class MappedFile : ManagerBase
+    {
+        private IntPtr _handle;
+        private FileStream _fileStream;
+
+        private readonly object _thisLock = new object();
+        private volatile bool _disposed;
+
+        // ネイティブ呼び出しの実行数。Dispose は 0 になるまで待ってから閉じる。
+        private int _activeCount;
+
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate IntPtr OpenDelegate([MarshalAs(UnmanagedType.LPWStr)] string path);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void CloseDelegate(IntPtr file);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate long GetLengthDelegate(IntPtr file);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int SetLengthDelegate(IntPtr file, long length);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int TransferDelegate(IntPtr file, long position, byte* buffer, int length);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void ReadBatchDelegate(IntPtr file, int count, long* positions, byte** buffers, int* lengths, int* results, int threads);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void AdviseDelegate(IntPtr file, long position, long length, int advice);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int FlushDelegate(IntPtr file);
+
+        private static OpenDelegate _open;
+        private static CloseDelegate _close;
+        private static GetLengthDelegate _getLength;
+        private static SetLengthDelegate _setLength;
+        private static TransferDelegate _read;
+        private static ReadBatchDelegate _readBatch;
+        private static TransferDelegate _write;
+        private static AdviseDelegate _advise;
+        private static FlushDelegate _flush;
+#endif
+
+        static MappedFile()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x86.dll");
+                }
+
+                // 古い DLL では一部の関数が見つからない。ネイティブとして開いた後で null を呼ぶことがないよう、
+                // 全て揃ってから設定する。
+                var open = _nativeLibraryManager.GetMethod<OpenDelegate>("mapped_file_open");
+                var close = _nativeLibraryManager.GetMethod<CloseDelegate>("mapped_file_close");
+                var getLength = _nativeLibraryManager.GetMethod<GetLengthDelegate>("mapped_file_get_length");
+                var setLength = _nativeLibraryManager.GetMethod<SetLengthDelegate>("mapped_file_set_length");
+                var read = _nativeLibraryManager.GetMethod<TransferDelegate>("mapped_file_read");
+                var readBatch = _nativeLibraryManager.GetMethod<ReadBatchDelegate>("mapped_file_read_batch");
+                var write = _nativeLibraryManager.GetMethod<TransferDelegate>("mapped_file_write");
+                var advise = _nativeLibraryManager.GetMethod<AdviseDelegate>("mapped_file_advise");
+                var flush = _nativeLibraryManager.GetMethod<FlushDelegate>("mapped_file_flush");
+
+                _close = close;
+                _getLength = getLength;
+                _setLength = setLength;
+                _read = read;
+                _readBatch = readBatch;
+                _write = write;
+                _advise = advise;
+                _flush = flush;
+                _open = open;
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        public MappedFile(string path)
+        {
+            if (path == null) throw new ArgumentNullException("path");
+
+#if Mono
+
+#else
+            if (_open != null)
+            {
+                _handle = _open(Path.GetFullPath(path));
+                if (_handle == IntPtr.Zero) throw new IOException(string.Format("Could not map the file. ({0})", path));
+
+                return;
+            }
+#endif
+
+            _fileStream = new FileStream(path, FileMode.OpenOrCreate, FileAccess.ReadWrite, FileShare.None, 8192, FileOptions.None);
+        }
+
+        public bool IsNative
+        {
+            get
+            {
+                return _handle != IntPtr.Zero;
+            }
+        }
+
+        private void Enter()
+        {
+            Interlocked.Increment(ref _activeCount);
+
+            if (_disposed)
+            {
+                Interlocked.Decrement(ref _activeCount);
+
+                throw new ObjectDisposedException(this.GetType().FullName);
+            }
+        }
+
+        private void Exit()
+        {
+            Interlocked.Decrement(ref _activeCount);
+        }
+
+        // ネイティブの戻り値を例外にする。-2 はビューを割り当てられなかった一時的な失敗。
+        private static void CheckResult(int result, string message)
+        {
+            if (result == -2) throw new MappedFileUnavailableException("Could not map a view of the file.");
+            if (result != 0) throw new IOException(message);
+        }
+
+        public long Length
+        {
+            get
+            {
+                if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+#if Mono
+
+#else
+                if (_handle != IntPtr.Zero)
+                {
+                    this.Enter();
+
+                    try
+                    {
+                        return _getLength(_handle);
+                    }
+                    finally
+                    {
+                        this.Exit();
+                    }
+                }
+#endif
+
+                lock (_thisLock)
+                {
+                    return _fileStream.Length;
+                }
+            }
+        }
+
+        // 全てのビューを張り直すため、実行中の読み書きが終わるのを待ってから変更する。
+        public void SetLength(long value)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (value < 0) throw new ArgumentOutOfRangeException("value");
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                this.Enter();
+
+                try
+                {
+                    if (_setLength(_handle, value) != 0) throw new IOException("Could not change the length of the mapped file.");
+                }
+                finally
+                {
+                    this.Exit();
+                }
+
+                return;
+            }
+#endif
+
+            lock (_thisLock)
+            {
+                _fileStream.SetLength(value);
+            }
+        }
+
+        // ファイル長を超える範囲は読み書きできない。書き込む前に SetLength で伸ばしておく。
+        public void Read(long position, byte[] buffer, int offset, int length)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (buffer == null) throw new ArgumentNullException("buffer");
+            if (position < 0) throw new ArgumentOutOfRangeException("position");
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (length < 0 || (buffer.Length - offset) < length) throw new ArgumentOutOfRangeException("length");
+            if (length == 0) return;
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                this.Enter();
+
+                try
+                {
+                    fixed (byte* p_buffer = buffer)
+                    {
+                        MappedFile.CheckResult(_read(_handle, position, p_buffer + offset, length), "Could not read the mapped file.");
+                    }
+                }
+                finally
+                {
+                    this.Exit();
+                }
+
+                return;
+            }
+#endif
+
+            lock (_thisLock)
+            {
+                if (_fileStream.Position != position)
+                {
+                    _fileStream.Seek(position, SeekOrigin.Begin);
+                }
+
+                while (length > 0)
+                {
+                    int readLength = _fileStream.Read(buffer, offset, length);
+                    if (readLength == 0) throw new EndOfStreamException();
+
+                    offset += readLength;
+                    length -= readLength;
+                }
+            }
+        }
+
+        // 散らばった範囲を複数のスレッドでまとめて読み込み、同時に複数のページインを発行する。
+        // 読めなかった範囲は例外にせず、戻り値の該当要素が false になる。
+        public bool[] Read(IList<long> positions, IList<ArraySegment<byte>> buffers, int threads)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (positions == null) throw new ArgumentNullException("positions");
+            if (buffers == null) throw new ArgumentNullException("buffers");
+            if (positions.Count != buffers.Count) throw new ArgumentOutOfRangeException("buffers");
+
+            int count = positions.Count;
+            var results = new bool[count];
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                var handles = new List<GCHandle>();
+
+                try
+                {
+                    var positionArray = new long[count];
+                    var bufferArray = new IntPtr[count];
+                    var lengthArray = new int[count];
+                    var resultArray = new int[count];
+
+                    var pinnedArrays = new Dictionary<byte[], IntPtr>();
+
+                    for (int i = 0; i < count; i++)
+                    {
+                        var buffer = buffers[i];
+                        if (buffer.Array == null) throw new ArgumentNullException("buffers");
+
+                        IntPtr address;
+
+                        if (!pinnedArrays.TryGetValue(buffer.Array, out address))
+                        {
+                            var handle = GCHandle.Alloc(buffer.Array, GCHandleType.Pinned);
+                            handles.Add(handle);
+
+                            address = handle.AddrOfPinnedObject();
+                            pinnedArrays.Add(buffer.Array, address);
+                        }
+
+                        positionArray[i] = positions[i];
+                        bufferArray[i] = address + buffer.Offset;
+                        lengthArray[i] = buffer.Count;
+                    }
+
+                    this.Enter();
+
+                    try
+                    {
+                        fixed (long* p_positions = positionArray)
+                        fixed (IntPtr* p_buffers = bufferArray)
+                        fixed (int* p_lengths = lengthArray)
+                        fixed (int* p_results = resultArray)
+                        {
+                            _readBatch(_handle, count, p_positions, (byte**)p_buffers, p_lengths, p_results, threads);
+                        }
+                    }
+                    finally
+                    {
+                        this.Exit();
+                    }
+
+                    for (int i = 0; i < count; i++)
+                    {
+                        results[i] = (resultArray[i] == 0);
+                    }
+                }
+                finally
+                {
+                    foreach (var handle in handles)
+                    {
+                        handle.Free();
+                    }
+                }
+
+                return results;
+            }
+#endif
+
+            for (int i = 0; i < count; i++)
+            {
+                try
+                {
+                    this.Read(positions[i], buffers[i].Array, buffers[i].Offset, buffers[i].Count);
+                    results[i] = true;
+                }
+                catch (IOException)
+                {
+
+                }
+            }
+
+            return results;
+        }
+
+        public void Write(long position, byte[] buffer, int offset, int length)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+            if (buffer == null) throw new ArgumentNullException("buffer");
+            if (position < 0) throw new ArgumentOutOfRangeException("position");
+            if (offset < 0 || buffer.Length < offset) throw new ArgumentOutOfRangeException("offset");
+            if (length < 0 || (buffer.Length - offset) < length) throw new ArgumentOutOfRangeException("length");
+            if (length == 0) return;
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                this.Enter();
+
+                try
+                {
+                    fixed (byte* p_buffer = buffer)
+                    {
+                        MappedFile.CheckResult(_write(_handle, position, p_buffer + offset, length), "Could not write the mapped file.");
+                    }
+                }
+                finally
+                {
+                    this.Exit();
+                }
+
+                return;
+            }
+#endif
+
+            lock (_thisLock)
+            {
+                if (_fileStream.Length < position + length) throw new ArgumentOutOfRangeException("length");
+
+                if (_fileStream.Position != position)
+                {
+                    _fileStream.Seek(position, SeekOrigin.Begin);
+                }
+
+                _fileStream.Write(buffer, offset, length);
+            }
+        }
+
+        // Windows には範囲ごとの madvise が無いため、Sequential と WillNeed は先読み (PrefetchVirtualMemory) になり、
+        // Normal と Random は何もしない。
+        public void Advise(long position, long length, MappedFileAdvice advice)
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                this.Enter();
+
+                try
+                {
+                    _advise(_handle, position, length, (int)advice);
+                }
+                finally
+                {
+                    this.Exit();
+                }
+            }
+#endif
+        }
+
+        // msync 相当。マップ中の変更をファイルに書き戻す。
+        public void Flush()
+        {
+            if (_disposed) throw new ObjectDisposedException(this.GetType().FullName);
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                this.Enter();
+
+                try
+                {
+                    if (_flush(_handle) != 0) throw new IOException("Could not flush the mapped file.");
+                }
+                finally
+                {
+                    this.Exit();
+                }
+
+                return;
+            }
+#endif
+
+            lock (_thisLock)
+            {
+                _fileStream.Flush();
+            }
+        }
+
+        protected override void Dispose(bool disposing)
+        {
+            if (_disposed) return;
+            _disposed = true;
+
+#if Mono
+
+#else
+            if (_handle != IntPtr.Zero)
+            {
+                // _disposed を立てた後は新しい呼び出しが入らないので、実行中のものが抜けるのを待つ。
+                Thread.MemoryBarrier();
+
+                while (Thread.VolatileRead(ref _activeCount) != 0)
+                {
+                    Thread.Sleep(1);
+                }
+
+                try
+                {
+                    _close(_handle);
+                }
+                catch (Exception)
+                {
+
+                }
+
+                _handle = IntPtr.Zero;
+            }
+#endif
+
+            if (disposing)
+            {
+                if (_fileStream != null)
+                {
+                    try
+                    {
+                        _fileStream.Dispose();
+                    }
+                    catch (Exception)
+                    {
+
+                    }
+
+                    _fileStream = null;
+                }
+            }
+        }
+    }
+
+    // ビューを割り当てられなかった (ビューが使い切られている、アドレス空間が足りない) 一時的な失敗。
+    // ファイルの内容が壊れているわけではない。
+    [Serializable]
+    public class MappedFileUnavailableException : IOException
+    {
+        public MappedFileUnavailableException() : base() { }
+        public MappedFileUnavailableException(string message) : base(message) { }
+        public MappedFileUnavailableException(string message, Exception innerException) : base(message, innerException) { }
+    }
+}
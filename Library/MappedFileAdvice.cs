@@ -0,0 +1,11 @@
+namespace Library
+{
+    // madvise 相当のアクセスヒント。
+    public enum MappedFileAdvice
+    {
+        Normal = 0,
+        Sequential = 1,
+        Random = 2,
+        WillNeed = 3,
+    }
+}
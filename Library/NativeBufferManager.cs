@@ -0,0 +1,229 @@
+using System;
+using System.Collections.Generic;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Library
+{
+    // 64 バイト境界に揃ったネイティブメモリのプール。サイズクラスごとのスラブとスレッドごとのキャッシュを持ち、
+    // 1MB 以上のクラスは大きいページ (2MB) を使うことができる。
+    // 取得したメモリは GC に移動されないため、ピン留めせずにネイティブのカーネルへ渡せる。
+    // ネイティブライブラリが使えない環境では Marshal.AllocHGlobal にフォールバックし、境界は揃わない。
+    public unsafe static class NativeBufferManager
+    {
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate IntPtr TakeDelegate(int size);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void ReturnDelegate(IntPtr buffer, int size);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int SetLargePagesDelegate(int enabled);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void TrimDelegate();
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int GetStatisticsDelegate(long* values, int count);
+
+        private static TakeDelegate _take;
+        private static ReturnDelegate _return;
+        private static SetLargePagesDelegate _setLargePages;
+        private static TrimDelegate _trim;
+        private static GetStatisticsDelegate _getStatistics;
+#endif
+
+        // slab_get_statistics が返すクラスごとの値の数。
+        private const int _statisticsWidth = 5;
+
+        // 前回から使われていないサイズクラスのキャッシュを定期的に OS に返す。
+        private static System.Threading.Timer _watchTimer;
+
+        static NativeBufferManager()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x86.dll");
+                }
+
+                // 古い DLL では一部の関数が見つからない。slab_take で取ったメモリを FreeHGlobal で返すことがないよう、
+                // 全て揃ってから設定する。
+                var takeBuffer = _nativeLibraryManager.GetMethod<TakeDelegate>("slab_take");
+                var returnBuffer = _nativeLibraryManager.GetMethod<ReturnDelegate>("slab_return");
+                var setLargePages = _nativeLibraryManager.GetMethod<SetLargePagesDelegate>("slab_set_large_pages");
+                var trim = _nativeLibraryManager.GetMethod<TrimDelegate>("slab_trim");
+                var getStatistics = _nativeLibraryManager.GetMethod<GetStatisticsDelegate>("slab_get_statistics");
+
+                _return = returnBuffer;
+                _setLargePages = setLargePages;
+                _trim = trim;
+                _getStatistics = getStatistics;
+                _take = takeBuffer;
+
+                _watchTimer = new System.Threading.Timer(NativeBufferManager.WatchTimer, null, new TimeSpan(0, 0, 30), new TimeSpan(0, 0, 30));
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        private static void WatchTimer(object state)
+        {
+            NativeBufferManager.Trim();
+        }
+
+        public static bool IsNative
+        {
+            get
+            {
+#if Mono
+                return false;
+#else
+                return _take != null && _return != null;
+#endif
+            }
+        }
+
+        public static IntPtr TakeBuffer(int size)
+        {
+            if (size < 0) throw new ArgumentOutOfRangeException("size");
+
+#if Mono
+
+#else
+            if (NativeBufferManager.IsNative)
+            {
+                IntPtr buffer = _take(size);
+                if (buffer == IntPtr.Zero) throw new OutOfMemoryException();
+
+                return buffer;
+            }
+#endif
+
+            return Marshal.AllocHGlobal(size);
+        }
+
+        // size には TakeBuffer に渡した値をそのまま渡す。
+        public static void ReturnBuffer(IntPtr buffer, int size)
+        {
+            if (buffer == IntPtr.Zero) throw new ArgumentNullException("buffer");
+            if (size < 0) throw new ArgumentOutOfRangeException("size");
+
+#if Mono
+
+#else
+            if (NativeBufferManager.IsNative)
+            {
+                _return(buffer, size);
+
+                return;
+            }
+#endif
+
+            Marshal.FreeHGlobal(buffer);
+        }
+
+        public static void Zero(IntPtr buffer, int length)
+        {
+            if (buffer == IntPtr.Zero) throw new ArgumentNullException("buffer");
+            if (length < 0) throw new ArgumentOutOfRangeException("length");
+
+            byte* p = (byte*)buffer;
+            int i = 0;
+
+            for (; i + 8 <= length; i += 8)
+            {
+                *(ulong*)(p + i) = 0;
+            }
+
+            for (; i < length; i++)
+            {
+                p[i] = 0;
+            }
+        }
+
+        // 大きいページには SeLockMemoryPrivilege が必要。使えるようになった場合は true を返す。
+        public static bool SetLargePages(bool enabled)
+        {
+#if Mono
+
+#else
+            if (_setLargePages != null)
+            {
+                return _setLargePages(enabled ? 1 : 0) != 0;
+            }
+#endif
+
+            return false;
+        }
+
+        // 前回の Trim から一度も取得されていないサイズクラスについて、使われていない 64KB 以上のブロックを OS に返す。
+        // 30 秒ごとに自動で呼ばれる。
+        public static void Trim()
+        {
+#if Mono
+
+#else
+            if (_trim != null)
+            {
+                _trim();
+            }
+#endif
+        }
+
+        public static Information Information
+        {
+            get
+            {
+                var contexts = new List<InformationContext>();
+
+#if Mono
+
+#else
+                if (_getStatistics != null)
+                {
+                    int count = _getStatistics(null, 0);
+                    var values = new long[count * _statisticsWidth];
+
+                    fixed (long* p_values = values)
+                    {
+                        _getStatistics(p_values, values.Length);
+                    }
+
+                    long usingMemory = 0;
+                    long reservedMemory = 0;
+                    long takeCount = 0;
+                    long allocationCount = 0;
+
+                    for (int i = 0; i < count; i++)
+                    {
+                        usingMemory += values[i * _statisticsWidth] * values[i * _statisticsWidth + 1];
+                        reservedMemory += values[i * _statisticsWidth + 2];
+                        takeCount += values[i * _statisticsWidth + 3];
+                        allocationCount += values[i * _statisticsWidth + 4];
+                    }
+
+                    contexts.Add(new InformationContext("UsingMemory", usingMemory));
+                    contexts.Add(new InformationContext("ReservedMemory", reservedMemory));
+                    contexts.Add(new InformationContext("TakeCount", takeCount));
+                    contexts.Add(new InformationContext("AllocationCount", allocationCount));
+                }
+#endif
+
+                return new Information(contexts);
+            }
+        }
+    }
+}
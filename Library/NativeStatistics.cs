@@ -0,0 +1,138 @@
+using System;
+using System.Collections.Generic;
+using System.Security;
+using System.Text;
+
+namespace Library
+{
+    // ネイティブのカーネル (copy、xor、mul、CRC32C、SHA-256 など) の呼び出し回数、バイト数、サイズの分布、
+    // 通ったコードパス (scalar、sse2、avx2、sha) と、64 回に 1 回測ったバイトあたりのサイクル数。
+    // 既定では無効で、有効にしている間だけ各スレッドが自分のカウンタを数え、読み出す時に合算される。
+    public unsafe static class NativeStatistics
+    {
+#if Mono
+
+#else
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int GetDelegate(byte* buffer, int length);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate void SetDelegate(int enabled);
+
+        private class Entry
+        {
+            public string Name;
+            public NativeLibraryManager NativeLibraryManager;
+            public GetDelegate Get;
+            public SetDelegate Set;
+        }
+
+        private static readonly List<Entry> _entries = new List<Entry>();
+#endif
+
+        private static volatile bool _enabled;
+        private static readonly object _thisLock = new object();
+
+        static NativeStatistics()
+        {
+#if Mono
+
+#else
+            foreach (var name in new string[] { "Library", "Library_Correction", "Library_Security" })
+            {
+                try
+                {
+                    var entry = new Entry();
+                    entry.Name = name;
+
+                    if (System.Environment.Is64BitProcess)
+                    {
+                        entry.NativeLibraryManager = new NativeLibraryManager("Assemblies/" + name + "_x64.dll");
+                    }
+                    else
+                    {
+                        entry.NativeLibraryManager = new NativeLibraryManager("Assemblies/" + name + "_x86.dll");
+                    }
+
+                    entry.Get = entry.NativeLibraryManager.GetMethod<GetDelegate>("native_get_stats");
+                    entry.Set = entry.NativeLibraryManager.GetMethod<SetDelegate>("native_set_stats");
+
+                    _entries.Add(entry);
+                }
+                catch (Exception e)
+                {
+                    Log.Warning(e);
+                }
+            }
+#endif
+        }
+
+        public static bool Enabled
+        {
+            get
+            {
+                return _enabled;
+            }
+            set
+            {
+                lock (_thisLock)
+                {
+                    _enabled = value;
+
+#if Mono
+
+#else
+                    foreach (var entry in _entries)
+                    {
+                        entry.Set(value ? 1 : 0);
+                    }
+#endif
+                }
+            }
+        }
+
+        /// <summary>
+        /// ライブラリ名をキーとし、各ライブラリの統計を値とする JSON を返します
+        /// </summary>
+        public static string GetStatistics()
+        {
+            var sb = new StringBuilder();
+            sb.Append("{");
+
+#if Mono
+
+#else
+            lock (_thisLock)
+            {
+                byte[] buffer = new byte[1024 * 64];
+
+                for (int i = 0; i < _entries.Count; i++)
+                {
+                    var entry = _entries[i];
+                    int length;
+
+                    // 足りなければ返された長さで取り直す。
+                    for (; ; )
+                    {
+                        fixed (byte* p_buffer = buffer)
+                        {
+                            length = entry.Get(p_buffer, buffer.Length);
+                        }
+
+                        if (length < buffer.Length) break;
+
+                        buffer = new byte[length + 1];
+                    }
+
+                    if (i != 0) sb.Append(",");
+                    sb.Append("\"" + entry.Name + "\":");
+                    sb.Append(Encoding.ASCII.GetString(buffer, 0, length));
+                }
+            }
+#endif
+
+            sb.Append("}");
+
+            return sb.ToString();
+        }
+    }
+}
@@ -1,6 +1,7 @@
 using System;
 using System.Collections.Generic;
 using System.Runtime.InteropServices;
+using System.Security;
 using System.Text;
 using System.Text.RegularExpressions;
 using System.Threading;
@@ -9,6 +10,46 @@ namespace Library
 {
     public unsafe static class NetworkConverter
     {
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int Base64UrlEncodeDelegate(byte* source, int length, char* result);
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int Base64UrlDecodeDelegate(char* source, int length, byte* result);
+
+        private static Base64UrlEncodeDelegate _base64UrlEncode;
+        private static Base64UrlDecodeDelegate _base64UrlDecode;
+#endif
+
+        static NetworkConverter()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x86.dll");
+                }
+
+                _base64UrlEncode = _nativeLibraryManager.GetMethod<Base64UrlEncodeDelegate>("base64url_encode");
+                _base64UrlDecode = _nativeLibraryManager.GetMethod<Base64UrlDecodeDelegate>("base64url_decode");
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
         internal static byte[] GetReverse(byte[] value, int offset, int length)
         {
             var buffer = new byte[length];
@@ -54,6 +95,25 @@ namespace Library
             if (offset < 0 || value.Length < offset) throw new ArgumentOutOfRangeException("offset");
             if (length < 0 || (value.Length - offset) < length) throw new ArgumentOutOfRangeException("length");
 
+#if Mono
+
+#else
+            if (_base64UrlEncode != null)
+            {
+                // パディングなしの長さ。
+                var result = new char[((long)length * 4 + 2) / 3];
+                int resultLength;
+
+                fixed (byte* p_value = value)
+                fixed (char* p_result = result)
+                {
+                    resultLength = _base64UrlEncode(p_value + offset, length, p_result);
+                }
+
+                return new string(result, 0, resultLength);
+            }
+#endif
+
             var charArray = System.Convert.ToBase64String(value, offset, length).ToCharArray();
             var charLength = charArray.Length;
 
@@ -87,6 +147,34 @@ namespace Library
         {
             if (value == null) throw new ArgumentNullException("value");
 
+#if Mono
+
+#else
+            // ネイティブ側は URL セーフの文字だけを受け付ける。長さが 4 の倍数の時に限り末尾の '=' を 2 つまで取り除いて渡し、
+            // それ以外の '=' や文字 ('+', '/', 空白など) を含む場合は従来の Convert による処理に任せる。
+            int length = value.Length;
+
+            if (length % 4 == 0)
+            {
+                for (int i = 0; i < 2 && length > 0 && value[length - 1] == '='; i++) length--;
+            }
+
+            if (_base64UrlDecode != null && (length == 0 || value[length - 1] != '='))
+            {
+
+                var result = new byte[(long)length * 3 / 4];
+                int resultLength;
+
+                fixed (char* p_value = value)
+                fixed (byte* p_result = result)
+                {
+                    resultLength = _base64UrlDecode(p_value, length, p_result);
+                }
+
+                if (resultLength == result.Length) return result;
+            }
+#endif
+
             char[] charArray = null;
 
             switch (value.Length % 4)
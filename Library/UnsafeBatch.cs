@@ -0,0 +1,219 @@
+using System;
+using System.Runtime.InteropServices;
+using System.Security;
+
+namespace Library
+{
+    // 同じ長さのバイト列同士の equals、compare を溜めておき、Execute で 1 回のネイティブ呼び出しにまとめて実行する。
+    // オペランドは AddOperand で 1 つの配列に詰めて並べるため、Execute で固定する配列はオペランド、操作、結果の 3 つだけで済む。
+    // バケットの探索やキーの一覧の照合のように、32、64 バイトの ID を何十個も比べる処理で遷移のコストを省く。
+    public unsafe sealed class UnsafeBatch
+    {
+        private enum OperationType
+        {
+            Equals = 0,
+            Compare = 1,
+        }
+
+#if Mono
+
+#else
+        private static NativeLibraryManager _nativeLibraryManager;
+
+        [SuppressUnmanagedCodeSecurity]
+        private delegate int BatchDelegate(int* operations, int count, byte* operands, int length, int* results);
+
+        private static BatchDelegate _batch;
+#endif
+
+        // UnsafeBatch_Operation と同じ並び (type, x, y)。
+        private const int OperationSize = 3;
+
+        private readonly int _operandLength;
+
+        private byte[] _operands;
+        private int _operandCount;
+
+        private int[] _operations;
+        private int[] _results;
+        private int _count;
+
+        static UnsafeBatch()
+        {
+#if Mono
+
+#else
+            try
+            {
+                if (System.Environment.Is64BitProcess)
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x64.dll");
+                }
+                else
+                {
+                    _nativeLibraryManager = new NativeLibraryManager("Assemblies/Library_x86.dll");
+                }
+
+                _batch = _nativeLibraryManager.GetMethod<BatchDelegate>("unsafe_batch");
+            }
+            catch (Exception e)
+            {
+                Log.Warning(e);
+            }
+#endif
+        }
+
+        public UnsafeBatch(int operandLength)
+            : this(operandLength, 16)
+        {
+
+        }
+
+        public UnsafeBatch(int operandLength, int capacity)
+        {
+            if (operandLength <= 0) throw new ArgumentOutOfRangeException("operandLength");
+            if (capacity < 1) capacity = 1;
+
+            _operandLength = operandLength;
+
+            _operands = new byte[capacity * operandLength];
+            _operations = new int[capacity * OperationSize];
+            _results = new int[capacity];
+        }
+
+        public int OperandLength
+        {
+            get
+            {
+                return _operandLength;
+            }
+        }
+
+        public int Count
+        {
+            get
+            {
+                return _count;
+            }
+        }
+
+        /// <summary>
+        /// オペランドと操作を捨てます。確保した配列は次の操作のために残します
+        /// </summary>
+        public void Clear()
+        {
+            _operandCount = 0;
+            _count = 0;
+        }
+
+        public int AddOperand(byte[] source)
+        {
+            return this.AddOperand(source, 0);
+        }
+
+        /// <summary>
+        /// source の offset から OperandLength バイトを写し、オペランドの番号を返します
+        /// </summary>
+        public int AddOperand(byte[] source, int offset)
+        {
+            if (source == null) throw new ArgumentNullException("source");
+            if (offset < 0 || (source.Length - offset) < _operandLength) throw new ArgumentOutOfRangeException("offset");
+
+            if ((_operandCount + 1) * _operandLength > _operands.Length)
+            {
+                Array.Resize(ref _operands, _operands.Length * 2);
+            }
+
+            Buffer.BlockCopy(source, offset, _operands, _operandCount * _operandLength, _operandLength);
+
+            return _operandCount++;
+        }
+
+        public int AddEquals(int x, int y)
+        {
+            return this.AddOperation(OperationType.Equals, x, y);
+        }
+
+        public int AddCompare(int x, int y)
+        {
+            return this.AddOperation(OperationType.Compare, x, y);
+        }
+
+        private int AddOperation(OperationType type, int x, int y)
+        {
+            if (x < 0 || x >= _operandCount) throw new ArgumentOutOfRangeException("x");
+            if (y < 0 || y >= _operandCount) throw new ArgumentOutOfRangeException("y");
+
+            if (_count == _results.Length)
+            {
+                Array.Resize(ref _operations, _operations.Length * 2);
+                Array.Resize(ref _results, _results.Length * 2);
+            }
+
+            int offset = _count * OperationSize;
+            _operations[offset] = (int)type;
+            _operations[offset + 1] = x;
+            _operations[offset + 2] = y;
+
+            return _count++;
+        }
+
+        /// <summary>
+        /// 溜めた操作をまとめて実行します
+        /// </summary>
+        public void Execute()
+        {
+            if (_count == 0) return;
+
+#if Mono
+            this.ExecuteManaged();
+#else
+            if (_batch == null)
+            {
+                this.ExecuteManaged();
+
+                return;
+            }
+
+            fixed (int* p_operations = _operations, p_results = _results)
+            fixed (byte* p_operands = _operands)
+            {
+                if (_batch(p_operations, _count, p_operands, _operandLength, p_results) != -1) throw new InvalidOperationException();
+            }
+#endif
+        }
+
+        private void ExecuteManaged()
+        {
+            for (int i = 0; i < _count; i++)
+            {
+                int offset = i * OperationSize;
+                int x = _operations[offset + 1] * _operandLength;
+                int y = _operations[offset + 2] * _operandLength;
+                int c = 0;
+
+                for (int j = 0; j < _operandLength; j++)
+                {
+                    if ((c = _operands[x + j] - _operands[y + j]) != 0) break;
+                }
+
+                if (_operations[offset] == (int)OperationType.Equals) _results[i] = (c == 0) ? 1 : 0;
+                else _results[i] = c;
+            }
+        }
+
+        public bool GetEquals(int index)
+        {
+            if (index < 0 || index >= _count) throw new ArgumentOutOfRangeException("index");
+
+            return _results[index] != 0;
+        }
+
+        public int GetCompare(int index)
+        {
+            if (index < 0 || index >= _count) throw new ArgumentOutOfRangeException("index");
+
+            return _results[index];
+        }
+    }
+}